@@ -0,0 +1,251 @@
+#include <cstdio>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stb_image.h>
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+#include "AssetPack.h"
+#include "Lz4.h"
+
+static std::vector<AssetPack> packs;
+
+//everything the lookups later trust: header, TOC and entry ranges in bounds
+static bool ValidatePack(const MappedFile& f)
+{
+    if (f.size < sizeof(PackHeader)) return false;
+
+    const PackHeader* h = (const PackHeader*)f.data;
+    if (h->magic != PACK_MAGIC || h->version != PACK_VERSION) return false;
+    if (h->tocOffset > f.size || h->namesOffset > f.size) return false;
+    if ((f.size - h->tocOffset) / sizeof(PackEntry) < h->entryCount) return false;
+
+    const PackEntry* toc = (const PackEntry*)(f.data + h->tocOffset);
+    for (uint32_t i = 0; i < h->entryCount; ++i)
+    {
+        const PackEntry& e = toc[i];
+        if (e.offset > f.size || f.size - e.offset < e.packedSize) return false;
+        //stored entries are handed out as size bytes straight from the mapping
+        if (!(e.flags & PACK_ENTRY_LZ4) && e.size != e.packedSize) return false;
+        if (e.nameOffset >= f.size - h->namesOffset) return false;
+    }
+
+    //the names block has to end in a terminator for the lookups' strcmp
+    return h->entryCount == 0 || f.data[f.size - 1] == 0;
+}
+
+bool MountAssetPack(const char* path)
+{
+    AssetPack pack;
+    if (!MapFile(pack.file, path)) return false;
+
+    if (!ValidatePack(pack.file))
+    {
+        std::cout << "Not a valid asset pack: " << path << "\n";
+        UnmapFile(pack.file);
+        return false;
+    }
+
+    pack.header = (const PackHeader*)pack.file.data;
+    pack.toc = (const PackEntry*)(pack.file.data + pack.header->tocOffset);
+    pack.names = (const char*)(pack.file.data + pack.header->namesOffset);
+
+    packs.push_back(pack);
+    std::cout << "Mounted " << path << " (" << pack.header->entryCount << " assets)\n";
+    return true;
+}
+
+void UnmountAssetPacks()
+{
+    for (AssetPack& pack : packs)
+        UnmapFile(pack.file);
+    packs.clear();
+}
+
+static const PackEntry* FindInPack(const AssetPack& pack, const std::string& key, uint64_t hash)
+{
+    const PackEntry* first = pack.toc;
+    const PackEntry* last = pack.toc + pack.header->entryCount;
+
+    //lower bound on the hash, then walk the (rare) collisions comparing names
+    while (first < last)
+    {
+        const PackEntry* mid = first + (last - first) / 2;
+        if (mid->hash < hash)
+            first = mid + 1;
+        else
+            last = mid;
+    }
+
+    const PackEntry* end = pack.toc + pack.header->entryCount;
+    for (; first < end && first->hash == hash; ++first)
+    {
+        if (key == pack.names + first->nameOffset)
+            return first;
+    }
+    return nullptr;
+}
+
+static const PackEntry* FindAsset(const char* path, const AssetPack** owner)
+{
+    if (packs.empty()) return nullptr;
+
+    std::string key = NormalizeAssetPath(path);
+    uint64_t hash = HashAssetPath(key);
+
+    for (size_t i = packs.size(); i-- > 0;)
+    {
+        const PackEntry* e = FindInPack(packs[i], key, hash);
+        if (e)
+        {
+            *owner = &packs[i];
+            return e;
+        }
+    }
+    return nullptr;
+}
+
+bool AssetExists(const char* path)
+{
+    const AssetPack* pack;
+    if (FindAsset(path, &pack)) return true;
+
+    FILE* f = std::fopen(path, "rb");
+    if (!f) return false;
+    std::fclose(f);
+    return true;
+}
+
+bool OpenAsset(const char* path, AssetData& asset)
+{
+    CloseAsset(asset);
+
+    const AssetPack* pack;
+    const PackEntry* e = FindAsset(path, &pack);
+    if (!e)
+    {
+        if (!MapFile(asset.loose, path)) return false;
+        asset.data = asset.loose.data;
+        asset.size = asset.loose.size;
+        return true;
+    }
+
+    const unsigned char* stored = pack->file.data + e->offset;
+    if (!(e->flags & PACK_ENTRY_LZ4))
+    {
+        asset.data = stored;
+        asset.size = e->size;
+        return true;
+    }
+
+    asset.unpacked.resize(e->size);
+    int n = Lz4Decompress(stored, (int)e->packedSize, asset.unpacked.data(), (int)e->size);
+    if (n != (int)e->size)
+    {
+        std::cout << "Corrupt packed asset: " << path << "\n";
+        asset.unpacked.clear();
+        return false;
+    }
+    asset.data = asset.unpacked.data();
+    asset.size = asset.unpacked.size();
+    return true;
+}
+
+void CloseAsset(AssetData& asset)
+{
+    UnmapFile(asset.loose);
+    std::vector<unsigned char>().swap(asset.unpacked);
+    asset.data = nullptr;
+    asset.size = 0;
+}
+
+unsigned char* LoadImageAsset(const char* path, int* width, int* height, int* channels, int desiredChannels)
+{
+    AssetData asset;
+    if (!OpenAsset(path, asset)) return nullptr;
+
+    unsigned char* pixels = stbi_load_from_memory(asset.data, (int)asset.size, width, height, channels, desiredChannels);
+    CloseAsset(asset);
+    return pixels;
+}
+
+//Assimp reads the OBJ and its MTL through these, so both come out of the pack
+class AssetIOStream : public Assimp::IOStream
+{
+public:
+    ~AssetIOStream()
+    {
+        CloseAsset(asset);
+    }
+
+    size_t Read(void* buffer, size_t size, size_t count) override
+    {
+        if (size == 0) return 0;
+
+        size_t n = std::min(count, (asset.size - pos) / size);
+        std::memcpy(buffer, asset.data + pos, n * size);
+        pos += n * size;
+        return n;
+    }
+
+    size_t Write(const void*, size_t, size_t) override
+    {
+        return 0;
+    }
+
+    aiReturn Seek(size_t offset, aiOrigin origin) override
+    {
+        //like fseek, negative offsets from the end arrive wrapped around
+        size_t target = offset;
+        if (origin == aiOrigin_CUR) target = pos + offset;
+        else if (origin == aiOrigin_END) target = asset.size + offset;
+
+        if (target > asset.size) return aiReturn_FAILURE;
+        pos = target;
+        return aiReturn_SUCCESS;
+    }
+
+    size_t Tell() const override { return pos; }
+    size_t FileSize() const override { return asset.size; }
+    void Flush() override {}
+
+    AssetData asset;
+    size_t    pos = 0;
+};
+
+class AssetIOSystem : public Assimp::IOSystem
+{
+public:
+    bool Exists(const char* file) const override
+    {
+        return AssetExists(file);
+    }
+
+    char getOsSeparator() const override
+    {
+        return '/';
+    }
+
+    Assimp::IOStream* Open(const char* file, const char* mode) override
+    {
+        if (std::strchr(mode, 'w') || std::strchr(mode, 'a')) return nullptr;
+
+        AssetIOStream* stream = new AssetIOStream();
+        if (!OpenAsset(file, stream->asset))
+        {
+            delete stream;
+            return nullptr;
+        }
+        return stream;
+    }
+
+    void Close(Assimp::IOStream* stream) override
+    {
+        delete stream;
+    }
+};
+
+Assimp::IOSystem* CreateAssetIOSystem()
+{
+    return new AssetIOSystem();
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "MappedFiles.h"
+#include "PackFormat.h"
+
+namespace Assimp { class IOSystem; }
+
+//virtual filesystem over packed archives (tools/packassets), falling back to
+//loose files; packs are mounted once at startup, lookups after that only read
+//the mapped TOCs and are safe from any thread
+
+struct AssetPack
+{
+    MappedFile file;
+    const PackHeader* header = nullptr;
+    const PackEntry*  toc = nullptr;
+    const char*       names = nullptr;
+};
+
+//an opened asset: a slice of a pack or loose file mapping, or the
+//decompressed copy of an LZ4 entry
+struct AssetData
+{
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+    std::vector<unsigned char> unpacked;
+    MappedFile loose;
+};
+
+//later mounts take precedence; false if the file is missing or not a pack
+bool MountAssetPack(const char* path);
+void UnmountAssetPacks();
+
+bool AssetExists(const char* path);
+bool OpenAsset(const char* path, AssetData& asset);
+void CloseAsset(AssetData& asset);
+
+//stb_image over OpenAsset, free the result with stbi_image_free
+unsigned char* LoadImageAsset(const char* path, int* width, int* height, int* channels, int desiredChannels = 0);
+
+//for Assimp::Importer::SetIOHandler, the importer takes ownership
+Assimp::IOSystem* CreateAssetIOSystem();
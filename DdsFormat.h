@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+
+//the subset of DDS written by tools/texconvert and read by LoadTextureFile:
+//"DDS " magic, DdsHeader, DdsHeaderDx10 when fourCC is DX10, then every mip
+//level top down, each ceil(w/4) * ceil(h/4) blocks
+
+const uint32_t DDS_MAGIC = 0x20534444;     //"DDS "
+
+#define DDS_FOURCC(a, b, c, d) ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+const uint32_t DDS_FOURCC_DXT1 = DDS_FOURCC('D', 'X', 'T', '1');
+const uint32_t DDS_FOURCC_DXT5 = DDS_FOURCC('D', 'X', 'T', '5');
+const uint32_t DDS_FOURCC_DX10 = DDS_FOURCC('D', 'X', '1', '0');
+
+const uint32_t DDSD_CAPS = 0x1;
+const uint32_t DDSD_HEIGHT = 0x2;
+const uint32_t DDSD_WIDTH = 0x4;
+const uint32_t DDSD_PIXELFORMAT = 0x1000;
+const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+const uint32_t DDSD_LINEARSIZE = 0x80000;
+const uint32_t DDPF_FOURCC = 0x4;
+const uint32_t DDSCAPS_COMPLEX = 0x8;
+const uint32_t DDSCAPS_TEXTURE = 0x1000;
+const uint32_t DDSCAPS_MIPMAP = 0x400000;
+
+const uint32_t DXGI_FORMAT_BC1_UNORM = 71;
+const uint32_t DXGI_FORMAT_BC3_UNORM = 77;
+const uint32_t DXGI_FORMAT_BC7_UNORM = 98;
+const uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+
+struct DdsPixelFormat
+{
+    uint32_t size;
+    uint32_t flags;
+    uint32_t fourCC;
+    uint32_t rgbBitCount;
+    uint32_t rMask, gMask, bMask, aMask;
+};
+
+struct DdsHeader
+{
+    uint32_t size;
+    uint32_t flags;
+    uint32_t height;
+    uint32_t width;
+    uint32_t pitchOrLinearSize;
+    uint32_t depth;
+    uint32_t mipMapCount;
+    uint32_t reserved1[11];
+    DdsPixelFormat format;
+    uint32_t caps, caps2, caps3, caps4;
+    uint32_t reserved2;
+};
+
+struct DdsHeaderDx10
+{
+    uint32_t dxgiFormat;
+    uint32_t resourceDimension;
+    uint32_t miscFlag;
+    uint32_t arraySize;
+    uint32_t miscFlags2;
+};
+
+static_assert(sizeof(DdsHeader) == 124, "DdsHeader layout");
+static_assert(sizeof(DdsHeaderDx10) == 20, "DdsHeaderDx10 layout");
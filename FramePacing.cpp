@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <glad.h>
+#include <GLFW/glfw3.h>
+#include "FramePacing.h"
+#include "Simulation.h"
+
+double WaitForFrame(FramePacer& pacer)
+{
+    if (pacer.targetFps > 0.0f)
+    {
+        double wake = pacer.deadline - pacer.costEstimate - pacer.safety;
+
+        //block on events for the bulk of the wait, then poll the last
+        //millisecond so the OS timer slack does not push the sample late
+        for (double now = SimClock(); now < wake; now = SimClock())
+        {
+            double remaining = wake - now;
+            if (remaining > 0.002)
+                glfwWaitEventsTimeout(remaining - 0.001);
+            else
+            {
+                glfwPollEvents();
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    glfwPollEvents();
+    pacer.sampleTime = SimClock();
+    return pacer.sampleTime;
+}
+
+void EndFrame(FramePacer& pacer, const RenderSnapshot& snap)
+{
+    double present = SimClock();
+
+    double cost = present - pacer.sampleTime;
+    if (cost > pacer.costEstimate)
+        pacer.costEstimate = cost;
+    else
+        pacer.costEstimate += (cost - pacer.costEstimate) * 0.05;
+
+    if (pacer.targetFps > 0.0f)
+    {
+        //fell more than a frame behind, restart the cadence instead of bursting
+        double period = 1.0 / pacer.targetFps;
+        pacer.deadline += period;
+        if (pacer.deadline < present)
+            pacer.deadline = present + period;
+    }
+
+    if (pacer.frames > 0)
+        pacer.frameSum += present - pacer.lastPresent;
+    pacer.lastPresent = present;
+    pacer.frames++;
+
+    if (snap.inputTime > 0.0)
+    {
+        double latency = present - snap.inputTime;
+        pacer.inputLatencySum += latency;
+        pacer.inputLatencyMax = std::max(pacer.inputLatencyMax, latency);
+        pacer.inputLatencyCount++;
+    }
+
+    //first frame showing the result of a new press
+    if (snap.eventTime > pacer.lastEventTime)
+    {
+        double latency = present - snap.eventTime;
+        pacer.eventLatencySum += latency;
+        pacer.eventLatencyMax = std::max(pacer.eventLatencyMax, latency);
+        pacer.eventLatencyCount++;
+        pacer.lastEventTime = snap.eventTime;
+    }
+}
+
+void CycleFrameLimit(FramePacer& pacer)
+{
+    float& fps = pacer.targetFps;
+    fps = (fps <= 0.0f) ? 30.0f : (fps < 45.0f) ? 60.0f : (fps < 90.0f) ? 120.0f : 0.0f;
+    pacer.deadline = SimClock();
+
+    if (fps > 0.0f)
+        std::cout << "Frame limit: " << (int)fps << " fps\n";
+    else
+        std::cout << "Frame limit: off\n";
+}
+
+void PrintFramePacing(const FramePacer& pacer)
+{
+    double frameMs = pacer.frames > 1 ? pacer.frameSum / (double)(pacer.frames - 1) * 1000.0 : 0.0;
+    double inputMs = pacer.inputLatencyCount ? pacer.inputLatencySum / (double)pacer.inputLatencyCount * 1000.0 : 0.0;
+    double eventMs = pacer.eventLatencyCount ? pacer.eventLatencySum / (double)pacer.eventLatencyCount * 1000.0 : 0.0;
+
+    std::cout << "Frame pacing: " << pacer.frames << " frames, " << frameMs << " ms avg, limit ";
+    if (pacer.targetFps > 0.0f)
+        std::cout << (int)pacer.targetFps << " fps\n";
+    else
+        std::cout << "off\n";
+    std::cout << "Latency: input to present " << inputMs << " ms avg, " << pacer.inputLatencyMax * 1000.0 << " ms max; "
+        << "E press to present " << eventMs << " ms avg, " << pacer.eventLatencyMax * 1000.0 << " ms max ("
+        << pacer.eventLatencyCount << " presses)\n";
+}
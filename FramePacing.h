@@ -0,0 +1,36 @@
+#pragma once
+#include "World.h"
+
+//frame limiter that sleeps before the frame instead of after it: the wait
+//ends one predicted frame cost ahead of the next present, so input is
+//sampled as late as possible. While waiting it keeps pumping GLFW events,
+//which is what timestamps key callbacks close to the actual press
+struct FramePacer
+{
+    float  targetFps = 0.0f;        //0 leaves pacing to the swap, input is still sampled late
+    float  safety = 0.001f;         //seconds of slack on top of the predicted cost
+
+    double costEstimate = 0.0;      //sample to present, rises at once and decays slowly
+    double deadline = 0.0;          //next present
+    double sampleTime = 0.0;        //this frame's input sample
+    double lastPresent = 0.0;
+    double lastEventTime = 0.0;
+
+    //stats
+    unsigned long long frames = 0;
+    double frameSum = 0.0;
+    double inputLatencySum = 0.0, inputLatencyMax = 0.0;    //held keys sample to present
+    unsigned long long inputLatencyCount = 0;
+    double eventLatencySum = 0.0, eventLatencyMax = 0.0;    //E press to present
+    unsigned long long eventLatencyCount = 0;
+};
+
+//returns the input sample time, events are polled right before it
+double WaitForFrame(FramePacer& pacer);
+
+//call right after the swap with the snapshot that frame drew
+void EndFrame(FramePacer& pacer, const RenderSnapshot& snap);
+
+//off -> 30 -> 60 -> 120 -> off
+void CycleFrameLimit(FramePacer& pacer);
+void PrintFramePacing(const FramePacer& pacer);
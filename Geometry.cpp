@@ -0,0 +1,91 @@
+#include <cstddef>
+#include <glad.h>
+#include "Geometry.h"
+
+void InitGeometryArena(GeometryArena& arena, unsigned int stride, const std::vector<VertexAttrib>& attribs)
+{
+    arena.stride = stride;
+    arena.attribs = attribs;
+}
+
+void InitSceneGeometry(GeometryArena& arena)
+{
+    InitGeometryArena(arena, sizeof(SceneVertex), {
+        { 0, 3, (unsigned int)offsetof(SceneVertex, pos) },
+        { 1, 3, (unsigned int)offsetof(SceneVertex, normal) },
+        { 2, 2, (unsigned int)offsetof(SceneVertex, uv) } });
+}
+
+GeometryRange AddGeometry(GeometryArena& arena, const void* vertices, unsigned int vertexCount,
+    const unsigned int* indices, unsigned int indexCount)
+{
+    GeometryRange range;
+    range.firstIndex = arena.indexCount;
+    range.indexCount = indexCount;
+    range.baseVertex = (int)arena.vertexCount;
+
+    const unsigned char* bytes = (const unsigned char*)vertices;
+    arena.vertexData.insert(arena.vertexData.end(), bytes, bytes + (size_t)vertexCount * arena.stride);
+    arena.indices.insert(arena.indices.end(), indices, indices + indexCount);
+    arena.vertexCount += vertexCount;
+    arena.indexCount += indexCount;
+    return range;
+}
+
+void UploadGeometry(GeometryArena& arena)
+{
+    glGenVertexArrays(1, &arena.vao);
+    glGenBuffers(1, &arena.vbo);
+    glGenBuffers(1, &arena.ebo);
+
+    glBindVertexArray(arena.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, arena.vbo);
+    glBufferData(GL_ARRAY_BUFFER, arena.vertexData.size(), arena.vertexData.data(), GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, arena.indices.size() * sizeof(unsigned int), arena.indices.data(), GL_STATIC_DRAW);
+
+    for (const VertexAttrib& a : arena.attribs)
+    {
+        glVertexAttribPointer(a.location, a.components, GL_FLOAT, GL_FALSE, arena.stride, (void*)(size_t)a.offset);
+        glEnableVertexAttribArray(a.location);
+    }
+
+    glBindVertexArray(0);
+
+    //geometry lives on the GPU now
+    std::vector<unsigned char>().swap(arena.vertexData);
+    std::vector<unsigned int>().swap(arena.indices);
+}
+
+void BindGeometry(const GeometryArena& arena)
+{
+    glBindVertexArray(arena.vao);
+}
+
+void DrawGeometry(const GeometryRange& range)
+{
+    glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)range.indexCount, GL_UNSIGNED_INT,
+        (void*)((size_t)range.firstIndex * sizeof(unsigned int)), range.baseVertex);
+}
+
+void DrawGeometry(const GeometryRange* ranges, int count)
+{
+    //GL context thread only, reused so per frame draws don't allocate
+    static std::vector<GLsizei> counts;
+    static std::vector<const void*> offsets;
+    static std::vector<GLint> baseVertices;
+    counts.resize(count);
+    offsets.resize(count);
+    baseVertices.resize(count);
+
+    for (int i = 0; i < count; ++i)
+    {
+        counts[i] = (GLsizei)ranges[i].indexCount;
+        offsets[i] = (const void*)((size_t)ranges[i].firstIndex * sizeof(unsigned int));
+        baseVertices[i] = ranges[i].baseVertex;
+    }
+
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT,
+        (const void* const*)offsets.data(), count, baseVertices.data());
+}
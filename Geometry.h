@@ -0,0 +1,65 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+//shared geometry arenas: one vertex buffer, index buffer and VAO per vertex
+//layout, sub-allocated per mesh; meshes are addressed by index range and
+//base vertex, so any mix of them draws without switching vertex arrays
+
+//the layout of everything lit through model_loading/instanced.vert
+struct SceneVertex
+{
+    glm::vec3 pos;
+    glm::vec3 normal;
+    glm::vec2 uv;
+};
+
+struct VertexAttrib
+{
+    unsigned int location;
+    int          components;    //floats
+    unsigned int offset;
+};
+
+//where a mesh sits in its arena, the same fields a DrawCommand uses
+struct GeometryRange
+{
+    unsigned int firstIndex = 0;
+    unsigned int indexCount = 0;
+    int          baseVertex = 0;
+};
+
+struct GeometryArena
+{
+    unsigned int stride = 0;
+    std::vector<VertexAttrib> attribs;
+
+    //CPU staging, freed once uploaded
+    std::vector<unsigned char> vertexData;
+    std::vector<unsigned int>  indices;
+    unsigned int vertexCount = 0;
+    unsigned int indexCount = 0;
+
+    unsigned int vao = 0, vbo = 0, ebo = 0;
+};
+
+void InitGeometryArena(GeometryArena& arena, unsigned int stride, const std::vector<VertexAttrib>& attribs);
+void InitSceneGeometry(GeometryArena& arena);
+
+//indices stay relative to the mesh, the range's base vertex offsets them
+GeometryRange AddGeometry(GeometryArena& arena, const void* vertices, unsigned int vertexCount,
+    const unsigned int* indices, unsigned int indexCount);
+
+template <typename V>
+GeometryRange AddGeometry(GeometryArena& arena, const std::vector<V>& vertices, const std::vector<unsigned int>& indices)
+{
+    return AddGeometry(arena, vertices.data(), (unsigned int)vertices.size(), indices.data(), (unsigned int)indices.size());
+}
+
+//everything has to be added before this, the arena is immutable afterwards
+void UploadGeometry(GeometryArena& arena);
+
+void BindGeometry(const GeometryArena& arena);
+void DrawGeometry(const GeometryRange& range);
+//one glMultiDrawElementsBaseVertex for all ranges
+void DrawGeometry(const GeometryRange* ranges, int count);
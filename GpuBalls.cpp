@@ -0,0 +1,318 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <glad.h>
+#include "GpuBalls.h"
+
+static unsigned int MakeBuffer(size_t bytes, const void* data)
+{
+    unsigned int buf = 0;
+    glGenBuffers(1, &buf);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buf);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, bytes, data, GL_DYNAMIC_DRAW);
+    return buf;
+}
+
+static GLuint Groups(int count)
+{
+    return ((GLuint)count + 255) / 256;
+}
+
+void InitGpuBalls(GpuBalls& gb, const std::vector<Sphere>& balls, int golden, const AABBBatch& boxes)
+{
+    gb.count = (int)balls.size();
+    gb.golden = golden;
+
+    std::vector<GpuBall> data(balls.size());
+    float maxRadius = 0.0f;
+    for (size_t i = 0; i < balls.size(); ++i)
+    {
+        const Sphere& s = balls[i];
+        data[i].posRadius = glm::vec4(s.pos, s.radius);
+        data[i].velMass = glm::vec4(s.vel, s.mass);
+        maxRadius = std::max(maxRadius, s.radius);
+    }
+
+    //with cells two diameters wide a ball only reaches the 2x2x2 cells around its nearest corner
+    gb.cellSize = std::max(maxRadius * 4.0f, 0.01f);
+
+    //about two buckets per ball keeps unrelated cells sharing one rare
+    gb.tableSize = 1024;
+    while (gb.tableSize < gb.count * 2)
+        gb.tableSize *= 2;
+
+    gb.ballBuf[0] = MakeBuffer(data.size() * sizeof(GpuBall), data.data());
+    gb.ballBuf[1] = MakeBuffer(data.size() * sizeof(GpuBall), data.data());
+    gb.current = 0;
+    gb.cellBuf = MakeBuffer(2 * (size_t)gb.tableSize * sizeof(unsigned int), nullptr);
+    gb.sortedBuf = MakeBuffer(data.size() * sizeof(unsigned int), nullptr);
+    gb.ballCellBuf = MakeBuffer(data.size() * sizeof(glm::ivec4), nullptr);
+
+    //lanes in batch order, player first
+    std::vector<GpuBallBox> boxData(boxes.count);
+    for (int k = 0; k < boxes.count; ++k)
+    {
+        bool player = (boxes.ids[k] & ~0xFFFF) == CONTACT_PLAYER;
+        boxData[k].minPlayer = glm::vec4(boxes.minX[k], boxes.minY[k], boxes.minZ[k], player ? 1.0f : 0.0f);
+        boxData[k].maxPad = glm::vec4(boxes.maxX[k], boxes.maxY[k], boxes.maxZ[k], 0.0f);
+    }
+    gb.boxCount = boxes.count;
+    gb.hasPlayer = boxes.count > 0 && boxData[0].minPlayer.w > 0.0f;
+    if (gb.hasPlayer)
+        gb.playerHalf = (glm::vec3(boxData[0].maxPad) - glm::vec3(boxData[0].minPlayer)) * 0.5f;
+    gb.boxBuf = MakeBuffer(std::max<size_t>(boxData.size(), 1) * sizeof(GpuBallBox), boxData.data());
+
+    GpuBallReport report;
+    if (golden >= 0 && golden < gb.count)
+        report.golden = data[golden].posRadius;
+    gb.reportBuf = MakeBuffer(sizeof(GpuBallReport), &report);
+
+    //the CPU only ever reads these, coherent so a signalled fence is enough
+    GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &gb.readbackBuf);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, gb.readbackBuf);
+    glBufferStorage(GL_COPY_WRITE_BUFFER, GPU_BALLS_READBACK_SLOTS * sizeof(GpuBallReport), nullptr, flags);
+    gb.readback = (GpuBallReport*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0,
+        GPU_BALLS_READBACK_SLOTS * sizeof(GpuBallReport), flags);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    gb.reports.Push(report);
+
+    std::cout << "GPU balls: " << gb.count << " balls, " << gb.tableSize << " grid buckets of "
+        << gb.cellSize << " m, " << gb.boxCount << " boxes\n";
+}
+
+static void StepOnce(GpuBalls& gb, bool reportContacts)
+{
+    GLuint groups = Groups(gb.count);
+
+    //integrate in place
+    {
+        Shader& cs = *gb.passes[GPU_BALLS_INTEGRATE];
+        cs.use();
+        cs.setInt("ballCount", gb.count);
+        cs.setFloat("dt", gb.dt);
+        cs.setFloat("gravity", gravity);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, gb.ballBuf[gb.current]);
+        glDispatchCompute(groups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    //counting sort into the grid: count, scan, scatter
+    unsigned int zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, gb.cellBuf);
+    glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, (size_t)gb.tableSize * sizeof(unsigned int),
+        GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, gb.cellBuf);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, gb.sortedBuf);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, gb.ballCellBuf);
+
+    {
+        Shader& cs = *gb.passes[GPU_BALLS_COUNT];
+        cs.use();
+        cs.setInt("ballCount", gb.count);
+        cs.setInt("tableSize", gb.tableSize);
+        cs.setFloat("cellSize", gb.cellSize);
+        glDispatchCompute(groups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+    {
+        Shader& cs = *gb.passes[GPU_BALLS_SCAN];
+        cs.use();
+        cs.setInt("tableSize", gb.tableSize);
+        glDispatchCompute(1, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+    {
+        Shader& cs = *gb.passes[GPU_BALLS_SCATTER];
+        cs.use();
+        cs.setInt("ballCount", gb.count);
+        cs.setInt("tableSize", gb.tableSize);
+        glDispatchCompute(groups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    //Jacobi passes over the grid, contacts with the player counted on the first
+    Shader& cs = *gb.passes[GPU_BALLS_COLLIDE];
+    cs.use();
+    cs.setInt("ballCount", gb.count);
+    cs.setInt("tableSize", gb.tableSize);
+    cs.setFloat("cellSize", gb.cellSize);
+    cs.setInt("goldenIndex", gb.golden);
+    cs.setInt("boxCount", gb.boxCount);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, gb.boxBuf);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, gb.reportBuf);
+
+    for (int it = 0; it < gb.iterations; ++it)
+    {
+        cs.setInt("reportContacts", (reportContacts && it == 0) ? 1 : 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, gb.ballBuf[gb.current]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, gb.ballBuf[gb.current ^ 1]);
+        glDispatchCompute(groups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        gb.current ^= 1;
+    }
+
+    gb.steps++;
+}
+
+void StepGpuBalls(GpuBalls& gb, unsigned long long step, const glm::vec3& playerPos, const Terrain& terrain)
+{
+    if (gb.count == 0) return;
+
+    if (gb.lastStep == 0)
+        gb.lastStep = step - 1;
+    unsigned long long pending = step - gb.lastStep;
+    gb.lastStep = step;
+    if (pending == 0) return;
+    if (pending > (unsigned long long)gb.maxSteps)
+    {
+        gb.dropped += pending - gb.maxSteps;
+        pending = gb.maxSteps;
+    }
+
+    //the player's box follows the snapshot, the rest never move
+    if (gb.hasPlayer)
+    {
+        GpuBallBox player;
+        player.minPlayer = glm::vec4(playerPos - gb.playerHalf, 1.0f);
+        player.maxPad = glm::vec4(playerPos + gb.playerHalf, 0.0f);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, gb.boxBuf);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GpuBallBox), &player);
+    }
+
+    //heightfield for the ground contact
+    Shader& integrate = *gb.passes[GPU_BALLS_INTEGRATE];
+    integrate.use();
+    integrate.setInt("heightMap", 0);
+    integrate.setFloat("terrainSize", terrain.worldSize);
+    integrate.setFloat("heightRes", (float)terrain.heightRes);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, terrain.heightTex);
+
+    //when the ring is full the contacts keep counting until a slot frees up
+    bool queue = gb.inFlight < GPU_BALLS_READBACK_SLOTS;
+    for (unsigned long long s = 0; s < pending; ++s)
+        StepOnce(gb, true);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    if (!queue)
+    {
+        gb.readbackFull++;
+        return;
+    }
+
+    unsigned int stamp = (unsigned int)step;
+    glBindBuffer(GL_COPY_READ_BUFFER, gb.reportBuf);
+    glBufferSubData(GL_COPY_READ_BUFFER, offsetof(GpuBallReport, step), sizeof(stamp), &stamp);
+
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, gb.readbackBuf);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, gb.head * sizeof(GpuBallReport), sizeof(GpuBallReport));
+    gb.fences[gb.head] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    gb.head = (gb.head + 1) % GPU_BALLS_READBACK_SLOTS;
+    gb.inFlight++;
+
+    //contacts are per report
+    unsigned int zero = 0;
+    glClearBufferSubData(GL_COPY_READ_BUFFER, GL_R32UI, offsetof(GpuBallReport, playerContacts),
+        2 * sizeof(unsigned int), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void HideGpuBall(GpuBalls& gb, int index)
+{
+    if (index < 0 || index >= gb.count) return;
+
+    //collide copies removed balls through, one buffer is enough
+    float radius = 0.0f;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, gb.ballBuf[gb.current]);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, index * sizeof(GpuBall) + offsetof(GpuBall, posRadius) + 3 * sizeof(float),
+        sizeof(radius), &radius);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void WriteGpuBallInstances(GpuBalls& gb, GpuScene& scene, int ballGroup)
+{
+    if (gb.count == 0) return;
+
+    Shader& cs = *gb.passes[GPU_BALLS_INSTANCES];
+    cs.use();
+    cs.setInt("ballCount", gb.count);
+    cs.setInt("goldenIndex", gb.golden);
+    cs.setInt("instanceBase", SceneGpuInstanceBase(scene));
+    cs.setInt("ballGroup", ballGroup);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, scene.instanceSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, gb.ballBuf[gb.current]);
+    glDispatchCompute(Groups(gb.count), 1, 1);
+
+    //cull.comp reads them next
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+//newest golden ball, contacts add up and the impulse keeps the largest
+static void MergeReport(GpuBallReport& into, const GpuBallReport& from)
+{
+    float a, b;
+    std::memcpy(&a, &into.playerImpulse, sizeof(a));
+    std::memcpy(&b, &from.playerImpulse, sizeof(b));
+    unsigned int contacts = into.playerContacts + from.playerContacts;
+
+    into = from;
+    into.playerContacts = contacts;
+    a = std::max(a, b);
+    std::memcpy(&into.playerImpulse, &a, sizeof(a));
+}
+
+void PollGpuBallReports(GpuBalls& gb)
+{
+    while (gb.inFlight > 0)
+    {
+        int tail = (gb.head - gb.inFlight + GPU_BALLS_READBACK_SLOTS) % GPU_BALLS_READBACK_SLOTS;
+        GLenum r = glClientWaitSync(gb.fences[tail], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (r != GL_ALREADY_SIGNALED && r != GL_CONDITION_SATISFIED)
+            break;
+
+        glDeleteSync(gb.fences[tail]);
+        gb.fences[tail] = nullptr;
+        gb.inFlight--;
+
+        if (gb.hasPending)
+            MergeReport(gb.pending, gb.readback[tail]);
+        else
+            gb.pending = gb.readback[tail];
+        gb.hasPending = true;
+        gb.reportsRead++;
+    }
+
+    //a full ring keeps the report back and merges the next ones into it
+    if (gb.hasPending && gb.reports.Push(gb.pending))
+        gb.hasPending = false;
+}
+
+bool TakeGpuBallReports(GpuBalls& gb, GpuBallReport& out)
+{
+    GpuBallReport report;
+    if (!gb.reports.Pop(out))
+        return false;
+
+    while (gb.reports.Pop(report))
+        MergeReport(out, report);
+    return true;
+}
+
+void PrintGpuBallStats(const GpuBalls& gb)
+{
+    if (gb.count == 0) return;
+
+    std::cout << "GPU balls: " << gb.steps << " steps of " << gb.count << " balls, "
+        << gb.dropped << " dropped, " << gb.reportsRead << " reports read back, "
+        << gb.readbackFull << " frames with the readback ring full\n";
+}
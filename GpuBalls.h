@@ -0,0 +1,113 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "shader_m.h"
+#include "Physics.h"
+#include "GpuScene.h"
+#include "Terrain.h"
+#include "SpscRing.h"
+
+//optional ball pit on the GPU for 100k+ balls: positions live in SSBOs, a
+//compute pass integrates them, a hashed uniform grid built by counting sort
+//finds the neighbours and the same sphere-sphere and sphere-box responses as
+//ResolveSphereSphere / ResolveSphereAABB run as Jacobi passes. The result is
+//written straight into the scene's instance buffer; only the golden ball and
+//the player's contacts come back, through fenced copies read frames later
+enum GpuBallPass
+{
+    GPU_BALLS_INTEGRATE = 0,
+    GPU_BALLS_COUNT,
+    GPU_BALLS_SCAN,
+    GPU_BALLS_SCATTER,
+    GPU_BALLS_COLLIDE,
+    GPU_BALLS_INSTANCES,
+    GPU_BALLS_PASS_COUNT
+};
+
+//std430 layouts of balls.comp
+struct GpuBall
+{
+    glm::vec4 posRadius;    //radius 0 is a removed ball
+    glm::vec4 velMass;
+};
+
+struct GpuBallBox
+{
+    glm::vec4 minPlayer;    //w = 1 for the player's box
+    glm::vec4 maxPad;
+};
+
+struct GpuBallReport
+{
+    glm::vec4    golden = glm::vec4(0.0f);      //xyz, w = radius
+    unsigned int playerContacts = 0;            //closing ball-player contacts since the last report
+    unsigned int playerImpulse = 0;             //float bits of the largest
+    unsigned int step = 0;                      //snapshot step the report was taken at
+    unsigned int pad = 0;
+};
+
+enum { GPU_BALLS_READBACK_SLOTS = 4 };
+
+struct GpuBalls
+{
+    Shader* passes[GPU_BALLS_PASS_COUNT] = {};
+
+    int   count = 0;
+    int   tableSize = 0;        //grid buckets, power of two
+    float cellSize = 0.0f;      //twice the largest diameter
+    int   iterations = 4;       //collide passes per step
+    float dt = 1.0f / 120.0f;   //one simulation step
+    int   maxSteps = 4;         //per frame, a stalled frame drops the rest
+    int   golden = -1;
+
+    unsigned long long lastStep = 0;    //snapshot step the GPU is at
+
+    unsigned int ballBuf[2] = {};       //ping pong, collide reads one and writes the other
+    int          current = 0;
+    unsigned int cellBuf = 0;           //counts then offsets, 2 * tableSize
+    unsigned int sortedBuf = 0;
+    unsigned int ballCellBuf = 0;
+    unsigned int boxBuf = 0;
+    int          boxCount = 0;
+    bool         hasPlayer = false;     //lane 0 of the batch was the player's
+    glm::vec3    playerHalf = glm::vec3(0.0f);
+    unsigned int reportBuf = 0;
+
+    //persistently mapped copies of reportBuf, each behind a fence
+    unsigned int   readbackBuf = 0;
+    GpuBallReport* readback = nullptr;
+    GLsync         fences[GPU_BALLS_READBACK_SLOTS] = {};
+    int            head = 0;        //next slot to copy into
+    int            inFlight = 0;
+
+    //render thread pushes, simulation thread drains; while the ring is full
+    //finished reports are merged into pending so no contact is lost
+    SpscRing<GpuBallReport, 16> reports;
+    GpuBallReport pending;
+    bool          hasPending = false;
+
+    //stats, render thread
+    unsigned long long steps = 0;
+    unsigned long long dropped = 0;     //steps skipped by maxSteps
+    unsigned long long reportsRead = 0;
+    unsigned long long readbackFull = 0;
+};
+
+//uploads the balls and the boxes; a player lane must come first, it is moved
+//every step to the position StepGpuBalls is given
+void InitGpuBalls(GpuBalls& gb, const std::vector<Sphere>& balls, int golden, const AABBBatch& boxes);
+
+//runs the steps between the last call and snapshot step, then queues a report copy
+void StepGpuBalls(GpuBalls& gb, unsigned long long step, const glm::vec3& playerPos, const Terrain& terrain);
+void HideGpuBall(GpuBalls& gb, int index);
+
+//fills the range ReserveSceneGpuInstances set aside, after UploadSceneInstances
+void WriteGpuBallInstances(GpuBalls& gb, GpuScene& scene, int ballGroup);
+
+//render thread: queues every finished report without waiting on the GPU
+void PollGpuBallReports(GpuBalls& gb);
+
+//simulation thread: newest golden ball, contacts summed and the largest
+//impulse over every report since the last call; false when none arrived
+bool TakeGpuBallReports(GpuBalls& gb, GpuBallReport& out);
+void PrintGpuBallStats(const GpuBalls& gb);
@@ -0,0 +1,330 @@
+#include <algorithm>
+#include <cmath>
+#include <glad.h>
+#include "GpuScene.h"
+
+int AddSceneMesh(GpuScene& scene, const std::vector<SceneVertex>& verts, const std::vector<unsigned int>& idx)
+{
+    GeometryRange range = AddGeometry(*scene.geometry, verts, idx);
+
+    DrawCommand cmd;
+    cmd.count = range.indexCount;
+    cmd.instanceCount = 0;
+    cmd.firstIndex = range.firstIndex;
+    cmd.baseVertex = range.baseVertex;
+    cmd.baseInstance = 0;
+
+    //AABB of what the batch draws, the groups' culling spheres are built from it
+    BatchBounds bounds = { glm::vec3(1e9f), glm::vec3(-1e9f) };
+    for (unsigned int i : idx)
+    {
+        bounds.min = glm::min(bounds.min, verts[i].pos);
+        bounds.max = glm::max(bounds.max, verts[i].pos);
+    }
+
+    scene.batches.push_back(cmd);
+    scene.batchBounds.push_back(bounds);
+    return (int)scene.batches.size() - 1;
+}
+
+int AddSceneMeshes(GpuScene& scene, const std::vector<Mesh>& meshes, int meshCount)
+{
+    int count = (meshCount < 0) ? (int)meshes.size() : std::min(meshCount, (int)meshes.size());
+    int first = (int)scene.batches.size();
+
+    for (int m = 0; m < count; ++m)
+    {
+        const Mesh& mesh = meshes[m];
+
+        std::vector<SceneVertex> verts;
+        verts.reserve(mesh.vertices.size());
+        for (const auto& v : mesh.vertices)
+            verts.push_back({ v.Position, v.Normal, v.TexCoords });
+
+        AddSceneMesh(scene, verts, mesh.indices);
+    }
+
+    return AddSceneGroup(scene, first, count);
+}
+
+int AddSceneGroup(GpuScene& scene, int firstBatch, int batchCount)
+{
+    //bounding sphere around the AABB of every batch in the group
+    glm::vec3 minP(1e9f), maxP(-1e9f);
+    for (int b = firstBatch; b < firstBatch + batchCount; ++b)
+    {
+        minP = glm::min(minP, scene.batchBounds[b].min);
+        maxP = glm::max(maxP, scene.batchBounds[b].max);
+    }
+
+    SceneGroup g = {};
+    if (batchCount > 0)
+    {
+        glm::vec3 centre = (minP + maxP) * 0.5f;
+        g.bounds = glm::vec4(centre, glm::length(maxP - centre));
+    }
+    g.firstBatch = (unsigned int)firstBatch;
+    g.batchCount = (unsigned int)batchCount;
+
+    scene.groups.push_back(g);
+    return (int)scene.groups.size() - 1;
+}
+
+GeometryRange SceneBatchRange(const GpuScene& scene, int batch)
+{
+    const DrawCommand& cmd = scene.batches[batch];
+
+    GeometryRange range;
+    range.firstIndex = cmd.firstIndex;
+    range.indexCount = cmd.count;
+    range.baseVertex = cmd.baseVertex;
+    return range;
+}
+
+void BuildSceneBuffers(GpuScene& scene)
+{
+    //visible instance index, baseInstance offsets it per draw; the buffer is
+    //bound per pass in DrawScene, the classic shaders never read location 3
+    glBindVertexArray(scene.geometry->vao);
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+    glBindVertexArray(0);
+
+    glGenBuffers(1, &scene.groupSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, scene.groupSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, scene.groups.size() * sizeof(SceneGroup), scene.groups.data(), GL_STATIC_DRAW);
+
+    glGenBuffers(1, &scene.instanceSSBO);
+    glGenBuffers(SCENE_PASS_COUNT, scene.commandBuf);
+    glGenBuffers(SCENE_PASS_COUNT, scene.visibleBuf);
+    glGenBuffers(1, &scene.retestBuf);
+
+    for (int p = 0; p < SCENE_PASS_COUNT; ++p)
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, scene.commandBuf[p]);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, scene.batches.size() * sizeof(DrawCommand), nullptr, GL_DYNAMIC_DRAW);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    scene.staticCapacity.assign(scene.batches.size(), 0);
+}
+
+glm::mat3 NormalMatrix(const glm::mat4& model)
+{
+    glm::mat3 m(model);
+
+    //orthogonal columns of equal length, the shaders renormalise so the scale drops out
+    float sx = glm::dot(m[0], m[0]);
+    float eps = 1e-4f * sx;
+    if (std::abs(glm::dot(m[1], m[1]) - sx) <= eps &&
+        std::abs(glm::dot(m[2], m[2]) - sx) <= eps &&
+        std::abs(glm::dot(m[0], m[1])) <= eps &&
+        std::abs(glm::dot(m[0], m[2])) <= eps &&
+        std::abs(glm::dot(m[1], m[2])) <= eps)
+        return m;
+
+    return glm::transpose(glm::inverse(m));
+}
+
+int AddSceneInstance(GpuScene& scene, int group, const glm::mat4& model, const glm::vec4& color, int material)
+{
+    GpuInstance inst = {};
+    inst.model = model;
+
+    //once per instance here instead of a 4x4 inverse per vertex
+    glm::mat3 n = NormalMatrix(model);
+    for (int c = 0; c < 3; ++c)
+        inst.normalMatrix[c] = glm::vec4(n[c], 0.0f);
+
+    inst.color = color;
+    inst.group = (unsigned int)group;
+    inst.material = (unsigned int)material;
+    scene.instances.push_back(inst);
+    return (int)scene.instances.size() - 1;
+}
+
+void MarkSceneStatic(GpuScene& scene)
+{
+    scene.staticCount = (int)scene.instances.size();
+    scene.staticDirty = true;
+
+    std::fill(scene.staticCapacity.begin(), scene.staticCapacity.end(), 0u);
+    for (const auto& inst : scene.instances)
+    {
+        const SceneGroup& g = scene.groups[inst.group];
+        for (unsigned int b = 0; b < g.batchCount; ++b)
+            scene.staticCapacity[g.firstBatch + b]++;
+    }
+}
+
+void ReserveSceneGpuInstances(GpuScene& scene, int group, int count)
+{
+    scene.gpuGroup = group;
+    scene.gpuCount = count;
+}
+
+int SceneGpuInstanceBase(const GpuScene& scene)
+{
+    return (int)scene.instances.size();
+}
+
+int SceneInstanceCount(const GpuScene& scene)
+{
+    return (int)scene.instances.size() + scene.gpuCount;
+}
+
+void BeginSceneFrame(GpuScene& scene)
+{
+    scene.instances.resize(scene.staticCount);
+}
+
+void UploadSceneInstances(GpuScene& scene)
+{
+    //per batch capacity, only the dynamic instances are walked on the CPU
+    std::vector<unsigned int> capacity = scene.staticCapacity;
+    for (size_t i = scene.staticCount; i < scene.instances.size(); ++i)
+    {
+        const SceneGroup& g = scene.groups[scene.instances[i].group];
+        for (unsigned int b = 0; b < g.batchCount; ++b)
+            capacity[g.firstBatch + b]++;
+    }
+    if (scene.gpuCount > 0)
+    {
+        const SceneGroup& g = scene.groups[scene.gpuGroup];
+        for (unsigned int b = 0; b < g.batchCount; ++b)
+            capacity[g.firstBatch + b] += scene.gpuCount;
+    }
+
+    unsigned int offset = 0;
+    for (size_t b = 0; b < scene.batches.size(); ++b)
+    {
+        scene.batches[b].instanceCount = 0;
+        scene.batches[b].baseInstance = offset;
+        offset += capacity[b];
+    }
+
+    size_t total = (size_t)SceneInstanceCount(scene);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, scene.instanceSSBO);
+    if (total > scene.instanceCapacity)
+    {
+        scene.instanceCapacity = total * 2;
+        glBufferData(GL_SHADER_STORAGE_BUFFER, scene.instanceCapacity * sizeof(GpuInstance), nullptr, GL_DYNAMIC_DRAW);
+        scene.staticDirty = true;
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, scene.retestBuf);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, (scene.instanceCapacity + 1) * sizeof(unsigned int), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, scene.instanceSSBO);
+    }
+
+    size_t first = scene.staticDirty ? 0 : (size_t)scene.staticCount;
+    if (scene.instances.size() > first)
+    {
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, first * sizeof(GpuInstance),
+            (scene.instances.size() - first) * sizeof(GpuInstance), scene.instances.data() + first);
+    }
+    scene.staticDirty = false;
+
+    if (offset > scene.visibleCapacity)
+    {
+        scene.visibleCapacity = offset * 2;
+        for (int p = 0; p < SCENE_PASS_COUNT; ++p)
+        {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, scene.visibleBuf[p]);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, scene.visibleCapacity * sizeof(unsigned int), nullptr, GL_DYNAMIC_DRAW);
+        }
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+static void ExtractFrustumPlanes(const glm::mat4& m, glm::vec4 planes[6])
+{
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    planes[0] = row3 + row0;
+    planes[1] = row3 - row0;
+    planes[2] = row3 + row1;
+    planes[3] = row3 - row1;
+    planes[4] = row3 + row2;
+    planes[5] = row3 - row2;
+
+    for (int i = 0; i < 6; ++i)
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+void CullScene(GpuScene& scene, ScenePass pass, const glm::mat4& viewProj, const HiZPyramid* hiz)
+{
+    //reset the commands, the cull pass fills in instanceCount
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, scene.commandBuf[pass]);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, scene.batches.size() * sizeof(DrawCommand), scene.batches.data());
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    //0 = frustum only, 1 = early, 2 = late
+    bool useHiZ = (pass != SCENE_PASS_SHADOW) && hiz && hiz->valid;
+    int mode = 0;
+    if (pass == SCENE_PASS_CAMERA && useHiZ) mode = 1;
+    if (pass == SCENE_PASS_CAMERA_LATE) mode = useHiZ ? 2 : -1;
+
+    if (pass == SCENE_PASS_CAMERA)
+    {
+        const unsigned int zero = 0;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, scene.retestBuf);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(unsigned int), &zero);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    //nothing was deferred without a pyramid, leave the late commands empty
+    if (mode < 0)
+        return;
+
+    glm::vec4 planes[6];
+    ExtractFrustumPlanes(viewProj, planes);
+
+    Shader& cs = *scene.cullShader;
+    cs.use();
+    cs.setInt("instanceCount", SceneInstanceCount(scene));
+    cs.setInt("mode", mode);
+    for (int i = 0; i < 6; ++i)
+        cs.setVec4("frustumPlanes[" + std::to_string(i) + "]", planes[i]);
+
+    if (useHiZ)
+    {
+        cs.setInt("hizTex", 0);
+        cs.setMat4("hizViewProj", hiz->viewProj);
+        cs.setVec2("hizSize", glm::vec2((float)hiz->width, (float)hiz->height));
+        cs.setInt("hizLevels", hiz->levels);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, hiz->tex);
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, scene.instanceSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, scene.groupSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, scene.commandBuf[pass]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, scene.visibleBuf[pass]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, scene.retestBuf);
+
+    GLuint groupsX = ((GLuint)SceneInstanceCount(scene) + 63) / 64;
+    if (groupsX > 0)
+        glDispatchCompute(groupsX, 1, 1);
+
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void DrawScene(const GpuScene& scene, ScenePass pass)
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, scene.instanceSSBO);
+
+    BindGeometry(*scene.geometry);
+    glBindBuffer(GL_ARRAY_BUFFER, scene.visibleBuf[pass]);
+    glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(unsigned int), (void*)0);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, scene.commandBuf[pass]);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, (GLsizei)scene.batches.size(), 0);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "shader_m.h"
+#include "mesh.h"
+#include "HiZ.h"
+#include "Geometry.h"
+
+//GPU driven path: every instanced prop lives in the shared SceneVertex arena,
+//a compute pass culls the instances and writes the indirect draw commands
+
+//matches DrawElementsIndirectCommand
+struct DrawCommand
+{
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int firstIndex;
+    int          baseVertex;
+    unsigned int baseInstance;
+};
+
+//std430 layouts shared with cull.comp and instanced.vert
+struct GpuInstance
+{
+    glm::mat4    model;
+    glm::vec4    normalMatrix[3];   //mat3 columns, std430 pads each to a vec4
+    glm::vec4    color;     //used by material 0
+    unsigned int group;
+    unsigned int material;  //MaterialRegistry index
+    unsigned int pad[2];
+};
+
+struct SceneGroup
+{
+    glm::vec4    bounds;    //local centre + radius
+    unsigned int firstBatch;
+    unsigned int batchCount;
+    unsigned int pad[2];
+};
+
+//the camera is culled in two phases: early tests against last frame's Hi-Z,
+//late re-tests what early rejected against the pyramid of the early pass
+enum ScenePass
+{
+    SCENE_PASS_CAMERA = 0,
+    SCENE_PASS_CAMERA_LATE = 1,
+    SCENE_PASS_SHADOW = 2,
+    SCENE_PASS_COUNT
+};
+
+struct BatchBounds
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+struct GpuScene
+{
+    GeometryArena* geometry = nullptr;  //SceneVertex layout, shared with the classic draws
+
+    std::vector<DrawCommand> batches;   //templates, instanceCount is the capacity
+    std::vector<BatchBounds> batchBounds;
+    std::vector<SceneGroup>  groups;
+    std::vector<GpuInstance> instances;
+    std::vector<unsigned int> staticCapacity;   //per batch
+    int  staticCount = 0;
+    bool staticDirty = true;
+
+    //instances a compute pass writes into instanceSSBO, after the CPU ones
+    int  gpuGroup = -1;
+    int  gpuCount = 0;
+
+    unsigned int instanceSSBO = 0, groupSSBO = 0;
+    size_t       instanceCapacity = 0;
+    size_t       visibleCapacity = 0;
+
+    unsigned int commandBuf[SCENE_PASS_COUNT] = {};
+    unsigned int visibleBuf[SCENE_PASS_COUNT] = {};
+    unsigned int retestBuf = 0;     //count + instances the early pass found occluded
+
+    Shader* cullShader = nullptr;
+};
+
+//inverse transpose of the upper 3x3, rotation + uniform scale returns it as is
+glm::mat3 NormalMatrix(const glm::mat4& model);
+
+//geometry goes into scene.geometry, which has to be uploaded before BuildSceneBuffers
+int  AddSceneMesh(GpuScene& scene, const std::vector<SceneVertex>& verts, const std::vector<unsigned int>& idx);
+int  AddSceneMeshes(GpuScene& scene, const std::vector<Mesh>& meshes, int meshCount = -1);
+int  AddSceneGroup(GpuScene& scene, int firstBatch, int batchCount);
+GeometryRange SceneBatchRange(const GpuScene& scene, int batch);
+void BuildSceneBuffers(GpuScene& scene);
+
+//static instances go first and are uploaded once, dynamic ones are re-added every frame
+int  AddSceneInstance(GpuScene& scene, int group, const glm::mat4& model, const glm::vec4& color, int material = 0);
+void MarkSceneStatic(GpuScene& scene);
+void BeginSceneFrame(GpuScene& scene);
+void UploadSceneInstances(GpuScene& scene);
+
+//count instances of group are written on the GPU after UploadSceneInstances,
+//starting at SceneGpuInstanceBase; the CPU only reserves room and culls them
+void ReserveSceneGpuInstances(GpuScene& scene, int group, int count);
+int  SceneGpuInstanceBase(const GpuScene& scene);
+int  SceneInstanceCount(const GpuScene& scene);
+
+//hiz is only used by the camera passes, pass nullptr or an invalid pyramid for frustum only
+void CullScene(GpuScene& scene, ScenePass pass, const glm::mat4& viewProj, const HiZPyramid* hiz = nullptr);
+void DrawScene(const GpuScene& scene, ScenePass pass);
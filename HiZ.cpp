@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <glad.h>
+#include "HiZ.h"
+
+static int PrevPow2(int v)
+{
+    int p = 1;
+    while (p * 2 <= v) p *= 2;
+    return p;
+}
+
+void ResizeHiZ(HiZPyramid& hiz, int screenWidth, int screenHeight)
+{
+    int w = PrevPow2(std::max(screenWidth, 1));
+    int h = PrevPow2(std::max(screenHeight, 1));
+    if (hiz.tex && hiz.width == w && hiz.height == h)
+        return;
+
+    if (hiz.tex)
+        glDeleteTextures(1, &hiz.tex);
+
+    hiz.width = w;
+    hiz.height = h;
+    hiz.levels = 1;
+    while ((std::max(w, h) >> hiz.levels) > 0) hiz.levels++;
+
+    glGenTextures(1, &hiz.tex);
+    glBindTexture(GL_TEXTURE_2D, hiz.tex);
+    glTexStorage2D(GL_TEXTURE_2D, hiz.levels, GL_R32F, w, h);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    //old contents no longer match the screen
+    hiz.valid = false;
+}
+
+void BuildHiZ(HiZPyramid& hiz, unsigned int depthTex, int depthWidth, int depthHeight, const glm::mat4& viewProj)
+{
+    Shader& cs = *hiz.buildShader;
+    cs.use();
+    cs.setInt("srcTex", 0);
+
+    int srcW = depthWidth, srcH = depthHeight;
+    for (int level = 0; level < hiz.levels; ++level)
+    {
+        int dstW = std::max(hiz.width >> level, 1);
+        int dstH = std::max(hiz.height >> level, 1);
+
+        //level 0 reads the depth buffer, every other level the one above it
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, level == 0 ? depthTex : hiz.tex);
+        cs.setInt("srcLevel", level == 0 ? 0 : level - 1);
+        cs.setVec2("srcSize", glm::vec2((float)srcW, (float)srcH));
+        cs.setVec2("dstSize", glm::vec2((float)dstW, (float)dstH));
+
+        glBindImageTexture(0, hiz.tex, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute((dstW + 7) / 8, (dstH + 7) / 8, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        srcW = dstW;
+        srcH = dstH;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    hiz.viewProj = viewProj;
+    hiz.valid = true;
+}
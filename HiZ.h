@@ -0,0 +1,21 @@
+#pragma once
+#include <glm/glm.hpp>
+#include "shader_m.h"
+
+//max-depth mip pyramid of the main pass depth buffer, used for occlusion culling
+struct HiZPyramid
+{
+    unsigned int tex = 0;
+    int width = 0;
+    int height = 0;
+    int levels = 0;
+
+    glm::mat4 viewProj = glm::mat4(1.0f);   //matrix the stored depth was rendered with
+    bool      valid = false;
+
+    Shader* buildShader = nullptr;
+};
+
+//level 0 is the largest power of two that fits in the screen
+void ResizeHiZ(HiZPyramid& hiz, int screenWidth, int screenHeight);
+void BuildHiZ(HiZPyramid& hiz, unsigned int depthTex, int depthWidth, int depthHeight, const glm::mat4& viewProj);
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include "ImpactAudio.h"
+
+//one coalescing cell, fixed table so the thread never allocates
+struct ImpactCell
+{
+    uint64_t  key = 0;
+    bool      used = false;
+    bool      pending = false;
+    glm::vec3 pos = glm::vec3(0.0f);
+    float     impulse = 0.0f;
+    double    windowStart = 0.0;
+    double    lastPlayed = -1.0;
+};
+
+static const int CellSlots = 256;
+static const int CellProbe = 8;
+
+static uint64_t CellKey(const glm::vec3& pos, float cellSize)
+{
+    //21 bits per axis, offset so negative cells stay positive
+    uint64_t x = (uint64_t)((int64_t)std::floor(pos.x / cellSize) + (1 << 20)) & 0x1FFFFF;
+    uint64_t y = (uint64_t)((int64_t)std::floor(pos.y / cellSize) + (1 << 20)) & 0x1FFFFF;
+    uint64_t z = (uint64_t)((int64_t)std::floor(pos.z / cellSize) + (1 << 20)) & 0x1FFFFF;
+    return (x << 42) | (y << 21) | z;
+}
+
+static ImpactCell* FindCell(ImpactCell* cells, uint64_t key)
+{
+    int home = (int)((key * 0x9E3779B97F4A7C15ull) >> 56);   //top 8 bits
+    ImpactCell* victim = nullptr;
+
+    for (int i = 0; i < CellProbe; ++i)
+    {
+        ImpactCell& c = cells[(home + i) & (CellSlots - 1)];
+        if (c.used && c.key == key) return &c;
+        if (!c.used) return &c;
+
+        //reuse the idle cell that sounded longest ago
+        if (!c.pending && (!victim || c.lastPlayed < victim->lastPlayed))
+            victim = &c;
+    }
+    return victim;
+}
+
+static void ImpactThread(ImpactAudio* audio)
+{
+    ImpactCell cells[CellSlots];
+
+    const auto start = std::chrono::steady_clock::now();
+    double last = 0.0;
+    float  tokens = audio->burst;
+    uint32_t rng = 0x12345678u;
+
+    while (audio->running.load(std::memory_order_acquire))
+    {
+        double now = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        tokens = std::min(audio->burst, tokens + (float)(now - last) * audio->ratePerSecond);
+        last = now;
+
+        //gather, keeping the hardest hit per cell
+        ContactEvent ev;
+        while (audio->ring.Pop(ev))
+        {
+            uint64_t key = CellKey(ev.pos, audio->cellSize);
+            ImpactCell* c = FindCell(cells, key);
+            if (!c)
+            {
+                audio->limited++;
+                continue;
+            }
+
+            if (c->used && c->key == key && c->pending)
+            {
+                audio->coalesced++;
+                if (ev.impulse > c->impulse)
+                {
+                    c->impulse = ev.impulse;
+                    c->pos = ev.pos;
+                }
+                continue;
+            }
+
+            if (!c->used || c->key != key)
+            {
+                c->key = key;
+                c->used = true;
+                c->lastPlayed = -1.0;
+            }
+            c->pending = true;
+            c->impulse = ev.impulse;
+            c->pos = ev.pos;
+            c->windowStart = now;
+        }
+
+        glm::vec3 listener(audio->listenerX.load(std::memory_order_relaxed),
+            audio->listenerY.load(std::memory_order_relaxed),
+            audio->listenerZ.load(std::memory_order_relaxed));
+
+        //sound the cells whose window closed
+        for (auto& c : cells)
+        {
+            if (!c.pending || now - c.windowStart < audio->coalesceWindow) continue;
+            c.pending = false;
+
+            glm::vec3 d = c.pos - listener;
+            if (glm::dot(d, d) > audio->maxDistance * audio->maxDistance) continue;
+
+            if ((c.lastPlayed >= 0.0 && now - c.lastPlayed < audio->cellCooldown) || tokens < 1.0f)
+            {
+                audio->limited++;
+                continue;
+            }
+            tokens -= 1.0f;
+            c.lastPlayed = now;
+
+            //harder hits are louder and a little deeper, with some jitter so repeats differ
+            rng = rng * 1664525u + 1013904223u;
+            float jitter = 0.95f + 0.1f * (float)(rng >> 8) / 16777216.0f;
+
+            SfxEmitter e;
+            e.pos = c.pos;
+            e.sfx = audio->sfx;
+            e.volume = glm::clamp(c.impulse * 0.1f, 0.05f, 0.5f);
+            e.speed = glm::clamp(1.8f - c.impulse * 0.05f, 1.0f, 1.8f) * jitter;
+            e.minDistance = 1.5f;
+            PlaySfxAt(audio->bank, e);
+            audio->played++;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+}
+
+void StartImpactAudio(ImpactAudio& audio, irrklang::ISoundEngine* engine,
+    const std::vector<irrklang::ISoundSource*>& sources, SfxHandle sfx)
+{
+    InitSfx(audio.bank, engine);
+    audio.bank.sources = sources;
+    audio.sfx = sfx;
+
+    audio.running.store(true, std::memory_order_release);
+    audio.thread = std::thread(ImpactThread, &audio);
+}
+
+void SetImpactListener(ImpactAudio& audio, const glm::vec3& pos)
+{
+    //components may tear between frames, harmless for a distance cull
+    audio.listenerX.store(pos.x, std::memory_order_relaxed);
+    audio.listenerY.store(pos.y, std::memory_order_relaxed);
+    audio.listenerZ.store(pos.z, std::memory_order_relaxed);
+}
+
+void StopImpactAudio(ImpactAudio& audio)
+{
+    audio.running.store(false, std::memory_order_release);
+    if (audio.thread.joinable())
+        audio.thread.join();
+    ShutdownSfx(audio.bank);
+}
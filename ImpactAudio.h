@@ -0,0 +1,38 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Physics.h"
+#include "Sfx.h"
+
+//turns solver contact events into pitched impact sounds on its own thread;
+//contacts close in space and time are merged per grid cell and the overall
+//rate is capped so a settling ball pit does not flood the mixer
+struct ImpactAudio
+{
+    ContactRing ring;       //physics pushes, this thread pops
+
+    SfxBank   bank;         //own voices, the main thread's pool is not shared
+    SfxHandle sfx = -1;
+
+    float cellSize = 2.0f;          //coalescing grid
+    float coalesceWindow = 0.04f;   //seconds a cell gathers hits before it sounds
+    float cellCooldown = 0.08f;     //minimum gap between sounds from one cell
+    float ratePerSecond = 30.0f;    //token bucket over all cells
+    float burst = 8.0f;
+    float maxDistance = 25.0f;
+
+    std::atomic<float> listenerX{ 0.0f }, listenerY{ 0.0f }, listenerZ{ 0.0f };
+
+    std::atomic<bool> running{ false };
+    std::thread       thread;
+
+    std::atomic<int> played{ 0 }, coalesced{ 0 }, limited{ 0 };
+};
+
+//sources are shared with the main bank, handles index the same list
+void StartImpactAudio(ImpactAudio& audio, irrklang::ISoundEngine* engine,
+    const std::vector<irrklang::ISoundSource*>& sources, SfxHandle sfx);
+void SetImpactListener(ImpactAudio& audio, const glm::vec3& pos);
+void StopImpactAudio(ImpactAudio& audio);
@@ -0,0 +1,173 @@
+#include <cstring>
+#include <vector>
+#include "Lz4.h"
+
+static const int LZ4_MIN_MATCH = 4;
+static const int LZ4_LAST_LITERALS = 5;    //the block always ends in literals
+static const int LZ4_MF_LIMIT = 12;        //no match may start this close to the end
+static const int LZ4_MAX_OFFSET = 65535;
+static const int LZ4_HASH_BITS = 16;
+
+static unsigned int Read32(const unsigned char* p)
+{
+    unsigned int v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+static unsigned int Hash4(unsigned int v)
+{
+    return (v * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+//length continuation bytes after a nibble of 15
+static unsigned char* WriteLength(unsigned char* op, int len)
+{
+    for (; len >= 255; len -= 255)
+        *op++ = 255;
+    *op++ = (unsigned char)len;
+    return op;
+}
+
+static unsigned char* WriteLiterals(unsigned char* op, unsigned char* token, const unsigned char* lit, int count)
+{
+    if (count >= 15)
+    {
+        *token = 15 << 4;
+        op = WriteLength(op, count - 15);
+    }
+    else
+        *token = (unsigned char)(count << 4);
+
+    std::memcpy(op, lit, count);
+    return op + count;
+}
+
+int Lz4Compress(const unsigned char* src, int srcSize, unsigned char* dst, int dstCapacity)
+{
+    std::vector<int> table((size_t)1 << LZ4_HASH_BITS, -1);
+
+    unsigned char* op = dst;
+    unsigned char* oend = dst + dstCapacity;
+    const int matchLimit = srcSize - LZ4_LAST_LITERALS;
+    const int ipLimit = srcSize - LZ4_MF_LIMIT;
+    int anchor = 0;
+    int ip = 0;
+
+    while (ip < ipLimit)
+    {
+        unsigned int seq = Read32(src + ip);
+        unsigned int h = Hash4(seq);
+        int ref = table[h];
+        table[h] = ip;
+
+        if (ref < 0 || ip - ref > LZ4_MAX_OFFSET || Read32(src + ref) != seq)
+        {
+            ++ip;
+            continue;
+        }
+
+        //grow the match backwards into the pending literals, then forwards
+        while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1])
+        {
+            --ip;
+            --ref;
+        }
+        int len = LZ4_MIN_MATCH;
+        while (ip + len < matchLimit && src[ip + len] == src[ref + len])
+            ++len;
+
+        int lit = ip - anchor;
+        if (op + 1 + lit + lit / 255 + 1 + 2 + len / 255 + 1 > oend)
+            return 0;
+
+        unsigned char* token = op++;
+        op = WriteLiterals(op, token, src + anchor, lit);
+
+        int offset = ip - ref;
+        *op++ = (unsigned char)(offset & 255);
+        *op++ = (unsigned char)(offset >> 8);
+
+        int extra = len - LZ4_MIN_MATCH;
+        if (extra >= 15)
+        {
+            *token |= 15;
+            op = WriteLength(op, extra - 15);
+        }
+        else
+            *token |= (unsigned char)extra;
+
+        ip += len;
+        anchor = ip;
+
+        //seed the table inside the match so repeats right after it are found
+        if (ip < ipLimit)
+            table[Hash4(Read32(src + ip - 2))] = ip - 2;
+    }
+
+    int lit = srcSize - anchor;
+    if (op + 1 + lit + lit / 255 + 1 > oend)
+        return 0;
+
+    unsigned char* token = op++;
+    op = WriteLiterals(op, token, src + anchor, lit);
+    return (int)(op - dst);
+}
+
+static bool ReadLength(const unsigned char*& ip, const unsigned char* iend, size_t& len)
+{
+    unsigned char b;
+    do
+    {
+        if (ip >= iend) return false;
+        b = *ip++;
+        len += b;
+    } while (b == 255);
+    return true;
+}
+
+int Lz4Decompress(const unsigned char* src, int srcSize, unsigned char* dst, int dstSize)
+{
+    const unsigned char* ip = src;
+    const unsigned char* iend = src + srcSize;
+    unsigned char* op = dst;
+    unsigned char* oend = dst + dstSize;
+
+    while (ip < iend)
+    {
+        unsigned int token = *ip++;
+
+        size_t lit = token >> 4;
+        if (lit == 15 && !ReadLength(ip, iend, lit)) return -1;
+        if (lit > (size_t)(iend - ip) || lit > (size_t)(oend - op)) return -1;
+
+        std::memcpy(op, ip, lit);
+        op += lit;
+        ip += lit;
+
+        //the last sequence has no match part
+        if (ip >= iend) break;
+        if (iend - ip < 2) return -1;
+
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst)) return -1;
+
+        size_t len = token & 15;
+        if (len == 15 && !ReadLength(ip, iend, len)) return -1;
+        len += LZ4_MIN_MATCH;
+        if (len > (size_t)(oend - op)) return -1;
+
+        const unsigned char* match = op - offset;
+        if (offset >= len)
+            std::memcpy(op, match, len);
+        else
+        {
+            //overlapping copy repeats the last offset bytes
+            for (size_t i = 0; i < len; ++i)
+                op[i] = match[i];
+        }
+        op += len;
+    }
+    return (int)(op - dst);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+//LZ4 block format (no frame header), enough for the asset pack: a greedy
+//single-probe compressor for the packer and a bounds checked decompressor
+
+//worst case output size for srcSize input bytes
+inline int Lz4CompressBound(int srcSize)
+{
+    return srcSize + srcSize / 255 + 16;
+}
+
+//returns the compressed size, 0 if it doesn't fit in dstCapacity
+int Lz4Compress(const unsigned char* src, int srcSize, unsigned char* dst, int dstCapacity);
+
+//returns the decompressed size, -1 on malformed input or if dstSize is too small
+int Lz4Decompress(const unsigned char* src, int srcSize, unsigned char* dst, int dstSize);
@@ -0,0 +1,177 @@
+#include <cstring>
+#include "MappedFiles.h"
+#include "AssetPack.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace irrklang;
+
+bool MapFile(MappedFile& file, const char* path)
+{
+    file = MappedFile();
+
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || size.QuadPart <= 0)
+    {
+        CloseHandle(handle);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view)
+    {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(handle);
+        return false;
+    }
+
+    file.data = (const unsigned char*)view;
+    file.size = (size_t)size.QuadPart;
+    file.file = handle;
+    file.mapping = mapping;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    //the mapping keeps its own reference to the file
+    void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) return false;
+
+    file.data = (const unsigned char*)view;
+    file.size = (size_t)st.st_size;
+#endif
+    return true;
+}
+
+void UnmapFile(MappedFile& file)
+{
+    if (!file.data) return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(file.data);
+    CloseHandle((HANDLE)file.mapping);
+    CloseHandle((HANDLE)file.file);
+#else
+    munmap((void*)file.data, file.size);
+#endif
+    file = MappedFile();
+}
+
+//a read position over an asset owned by the factory; read() still has to
+//copy for irrKlang's own decoders, getData() is the zero copy path
+class MappedFileReader : public IMappedFileReader
+{
+public:
+    MappedFileReader(MappedFileFactory* factory, const AssetData& file, const char* name)
+        : factory(factory), data(file.data), size((ik_s32)file.size), name(name)
+    {
+        //the mapping lives as long as the factory, which irrKlang may drop first
+        factory->grab();
+    }
+
+    ~MappedFileReader()
+    {
+        factory->drop();
+    }
+
+    ik_s32 read(void* buffer, ik_u32 sizeToRead) override
+    {
+        ik_s32 n = size - pos;
+        if ((ik_s32)sizeToRead < n) n = (ik_s32)sizeToRead;
+        if (n <= 0) return 0;
+
+        std::memcpy(buffer, data + pos, n);
+        pos += n;
+        return n;
+    }
+
+    bool seek(ik_s32 finalPos, bool relativeMovement) override
+    {
+        ik_s32 target = relativeMovement ? pos + finalPos : finalPos;
+        if (target < 0 || target > size) return false;
+        pos = target;
+        return true;
+    }
+
+    ik_s32 getSize() override { return size; }
+    ik_s32 getPos() override { return pos; }
+    const ik_c8* getFileName() override { return name.c_str(); }
+    const ik_u8* getData() override { return data; }
+
+private:
+    MappedFileFactory*   factory;
+    const unsigned char* data;
+    ik_s32      size;
+    ik_s32      pos = 0;
+    std::string name;
+};
+
+MappedFileFactory::MappedFileFactory()
+{
+}
+
+MappedFileFactory::~MappedFileFactory()
+{
+    for (auto& entry : files)
+        CloseAsset(*entry.second);
+}
+
+IFileReader* MappedFileFactory::createFileReader(const ik_c8* filename)
+{
+    if (!filename) return nullptr;
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    auto it = files.find(filename);
+    if (it == files.end())
+    {
+        std::unique_ptr<AssetData> file(new AssetData());
+        if (!OpenAsset(filename, *file)) return nullptr;
+
+        //irrKlang positions are 32 bit
+        if (file->size > 0x7FFFFFFF)
+        {
+            CloseAsset(*file);
+            return nullptr;
+        }
+        it = files.emplace(filename, std::move(file)).first;
+    }
+
+    ++readersOpened;
+    return new MappedFileReader(this, *it->second, filename);
+}
+
+MappedFileStats MappedFileFactory::Stats()
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    MappedFileStats stats;
+    stats.files = (int)files.size();
+    stats.readersOpened = readersOpened;
+    for (const auto& entry : files)
+        stats.mappedBytes += entry.second->size;
+    return stats;
+}
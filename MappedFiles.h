@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <irrKlang.h>
+#include "external/irrKlang-master/plugins/ikpMP3/ik_IMappedFileReader.h"
+
+//asset files are memory mapped once and kept for the life of the factory;
+//irrKlang's readers are slices of the mapping, so reopening a sound never
+//touches the disk and the MP3 plugin decodes straight from the mapped pages.
+//the files are opened through the asset VFS, so mounted packs are served too
+
+struct MappedFile
+{
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+    void*  file = nullptr;      //HANDLEs on Windows, unused elsewhere
+    void*  mapping = nullptr;
+};
+
+bool MapFile(MappedFile& file, const char* path);
+void UnmapFile(MappedFile& file);
+
+struct AssetData;
+
+struct MappedFileStats
+{
+    int    files = 0;
+    size_t mappedBytes = 0;
+    int    readersOpened = 0;
+};
+
+class MappedFileFactory : public irrklang::IFileFactory
+{
+public:
+    MappedFileFactory();
+    ~MappedFileFactory();
+
+    //opens the asset on first use, returns 0 if it can't be found so irrKlang
+    //falls back to its own reader
+    irrklang::IFileReader* createFileReader(const irrklang::ik_c8* filename) override;
+
+    MappedFileStats Stats();
+
+private:
+    std::mutex lock;    //irrKlang opens streams from its own thread
+    std::unordered_map<std::string, std::unique_ptr<AssetData>> files;
+    int readersOpened = 0;
+};
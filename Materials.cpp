@@ -0,0 +1,142 @@
+#include <iostream>
+#include <string>
+#include <glad.h>
+#include "Materials.h"
+
+void InitMaterials(MaterialRegistry& reg)
+{
+    GpuMaterial none = { -1, 0, { 0, 0 } };
+    reg.materials.assign(1, none);
+    reg.sources.assign(1, 0);
+}
+
+int AddTextureMaterial(MaterialRegistry& reg, unsigned int texture)
+{
+    if (texture == 0) return 0;
+
+    auto it = reg.byTexture.find(texture);
+    if (it != reg.byTexture.end()) return it->second;
+
+    GpuMaterial m = { -1, 0, { 0, 0 } };
+    reg.materials.push_back(m);
+    reg.sources.push_back(texture);
+
+    int index = (int)reg.materials.size() - 1;
+    reg.byTexture[texture] = index;
+    return index;
+}
+
+//levels the texture actually has, glGenerateMipmap chains stop at 1x1
+static int SourceLevels(int w, int h)
+{
+    int maxLevel = 0;
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+
+    int levels = 1;
+    while ((w > 1 || h > 1) && levels <= maxLevel)
+    {
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+        ++levels;
+    }
+    return levels;
+}
+
+void BuildMaterials(MaterialRegistry& reg)
+{
+    //bucket the sources by everything glCopyImageSubData needs to match
+    for (size_t m = 1; m < reg.materials.size(); ++m)
+    {
+        glBindTexture(GL_TEXTURE_2D, reg.sources[m]);
+
+        int w = 0, h = 0, format = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &w);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &h);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+        int levels = SourceLevels(w, h);
+        if (w == 0 || h == 0) continue;
+
+        int bucket = -1;
+        for (size_t a = 0; a < reg.arrays.size() && bucket < 0; ++a)
+        {
+            const MaterialArray& arr = reg.arrays[a];
+            if (arr.width == w && arr.height == h && arr.format == (unsigned int)format && arr.levels == levels)
+                bucket = (int)a;
+        }
+        if (bucket < 0)
+        {
+            if ((int)reg.arrays.size() == MATERIAL_MAX_ARRAYS)
+            {
+                std::cout << "Material arrays full, texture " << reg.sources[m] << " drawn untextured\n";
+                continue;
+            }
+
+            MaterialArray arr;
+            arr.width = w;
+            arr.height = h;
+            arr.format = (unsigned int)format;
+            arr.levels = levels;
+            reg.arrays.push_back(arr);
+            bucket = (int)reg.arrays.size() - 1;
+        }
+
+        MaterialArray& arr = reg.arrays[bucket];
+        reg.materials[m].array = bucket;
+        reg.materials[m].layer = (int)arr.layers.size();
+        arr.layers.push_back(reg.sources[m]);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    for (MaterialArray& arr : reg.arrays)
+    {
+        glGenTextures(1, &arr.tex);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, arr.tex);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, arr.levels, arr.format, arr.width, arr.height, (GLsizei)arr.layers.size());
+
+        //a straight GPU copy, compressed blocks included
+        for (size_t layer = 0; layer < arr.layers.size(); ++layer)
+        {
+            int w = arr.width, h = arr.height;
+            for (int level = 0; level < arr.levels; ++level)
+            {
+                glCopyImageSubData(arr.layers[layer], GL_TEXTURE_2D, level, 0, 0, 0,
+                    arr.tex, GL_TEXTURE_2D_ARRAY, level, 0, 0, (GLint)layer, w, h, 1);
+                w = w > 1 ? w / 2 : 1;
+                h = h > 1 ? h / 2 : 1;
+            }
+        }
+
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    glGenBuffers(1, &reg.ssbo);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, reg.ssbo);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, reg.materials.size() * sizeof(GpuMaterial), reg.materials.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    std::cout << "Materials: " << reg.materials.size() - 1 << " textured in "
+        << reg.arrays.size() << " arrays\n";
+}
+
+void BindMaterialSamplers(Shader& shader)
+{
+    shader.use();
+    for (int i = 0; i < MATERIAL_MAX_ARRAYS; ++i)
+        shader.setInt("materialArrays[" + std::to_string(i) + "]", MATERIAL_FIRST_UNIT + i);
+}
+
+void BindMaterials(const MaterialRegistry& reg)
+{
+    for (size_t i = 0; i < reg.arrays.size(); ++i)
+    {
+        glActiveTexture(GL_TEXTURE0 + MATERIAL_FIRST_UNIT + (GLenum)i);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, reg.arrays[i].tex);
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_SSBO_BINDING, reg.ssbo);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <unordered_map>
+#include <vector>
+#include "shader_m.h"
+
+//material registry: every diffuse texture becomes a layer of a texture array
+//bucketed by size and format, draws and instances carry only a material
+//index; material 0 is untextured and keeps the per draw/instance colour
+
+const int MATERIAL_MAX_ARRAYS = 8;      //sampler2DArray slots in model_loading.frag
+const int MATERIAL_FIRST_UNIT = 8;      //texture units of the arrays
+const int MATERIAL_SSBO_BINDING = 5;
+
+//std430 layout shared with model_loading.frag
+struct GpuMaterial
+{
+    int array;      //-1 untextured
+    int layer;
+    int pad[2];
+};
+
+struct MaterialArray
+{
+    unsigned int tex = 0;
+    int width = 0, height = 0;
+    unsigned int format = 0;    //sized internal format
+    int levels = 0;
+    std::vector<unsigned int> layers;   //source textures, copied at build
+};
+
+struct MaterialRegistry
+{
+    std::vector<GpuMaterial>   materials;
+    std::vector<unsigned int>  sources;     //per material, 0 if untextured
+    std::vector<MaterialArray> arrays;
+    std::unordered_map<unsigned int, int> byTexture;
+    unsigned int ssbo = 0;
+};
+
+void InitMaterials(MaterialRegistry& reg);
+
+//one material per source texture, asking twice returns the same index;
+//texture 0 gives the untextured material
+int  AddTextureMaterial(MaterialRegistry& reg, unsigned int texture);
+
+//copies every source into its array and uploads the table; sources can be
+//deleted afterwards unless something still draws them directly
+void BuildMaterials(MaterialRegistry& reg);
+
+//sampler uniforms point at the array units once, at load
+void BindMaterialSamplers(Shader& shader);
+//arrays and table for the frame, units MATERIAL_FIRST_UNIT and up
+void BindMaterials(const MaterialRegistry& reg);
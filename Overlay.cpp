@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <cstddef>
+#include <glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include "Overlay.h"
+
+void InitOverlay(Overlay& overlay)
+{
+    glGenVertexArrays(1, &overlay.vao);
+    glGenBuffers(1, &overlay.vbo);
+
+    glBindVertexArray(overlay.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, overlay.vbo);
+
+    const GLsizei stride = sizeof(OverlayVertex);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(OverlayVertex, pos));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(OverlayVertex, local));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(OverlayVertex, color));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(OverlayVertex, params));
+    glEnableVertexAttribArray(3);
+
+    glBindVertexArray(0);
+}
+
+void BeginOverlay(Overlay& overlay)
+{
+    overlay.vertices.clear();
+}
+
+//two triangles, pos and local interpolate corner to corner
+static void PushQuad(Overlay& overlay, const glm::vec2& pMin, const glm::vec2& pMax,
+    const glm::vec2& lMin, const glm::vec2& lMax, const glm::vec4& color, const glm::vec4& params)
+{
+    OverlayVertex v00 = { pMin, lMin, color, params };
+    OverlayVertex v10 = { glm::vec2(pMax.x, pMin.y), glm::vec2(lMax.x, lMin.y), color, params };
+    OverlayVertex v11 = { pMax, lMax, color, params };
+    OverlayVertex v01 = { glm::vec2(pMin.x, pMax.y), glm::vec2(lMin.x, lMax.y), color, params };
+
+    overlay.vertices.push_back(v00);
+    overlay.vertices.push_back(v10);
+    overlay.vertices.push_back(v11);
+
+    overlay.vertices.push_back(v00);
+    overlay.vertices.push_back(v11);
+    overlay.vertices.push_back(v01);
+}
+
+void OverlayStar(Overlay& overlay, const glm::vec2& minCorner, float size, const glm::vec4& color)
+{
+    PushQuad(overlay, minCorner, minCorner + glm::vec2(size),
+        glm::vec2(-1.0f), glm::vec2(1.0f),
+        color, glm::vec4((float)OVERLAY_STAR, 0.0f, 0.0f, 0.0f));
+}
+
+void OverlayCircle(Overlay& overlay, OverlayShape shape, const glm::vec2& centre, float pixelsPerUnit,
+    float innerRadius, float outerRadius, const glm::vec4& color)
+{
+    //quad just big enough for the outer edge
+    float extent = std::max(std::max(innerRadius, outerRadius), 0.0f);
+    if (extent <= 0.0f) return;
+
+    glm::vec2 half(extent * pixelsPerUnit);
+    PushQuad(overlay, centre - half, centre + half,
+        glm::vec2(-extent), glm::vec2(extent),
+        color, glm::vec4((float)shape, innerRadius, outerRadius, 0.0f));
+}
+
+void DrawOverlay(Overlay& overlay, int screenWidth, int screenHeight)
+{
+    if (overlay.vertices.empty()) return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, overlay.vbo);
+    size_t bytes = overlay.vertices.size() * sizeof(OverlayVertex);
+    if (bytes > overlay.capacity)
+        overlay.capacity = std::max(bytes, overlay.capacity * 2);
+
+    //orphan so the driver does not stall on last frame's draw
+    glBufferData(GL_ARRAY_BUFFER, overlay.capacity, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, overlay.vertices.data());
+
+    glViewport(0, 0, screenWidth, screenHeight);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    overlay.shader->use();
+    overlay.shader->setMat4("uiProjection",
+        glm::ortho(0.0f, (float)screenWidth, 0.0f, (float)screenHeight));
+
+    glBindVertexArray(overlay.vao);
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)overlay.vertices.size());
+    glBindVertexArray(0);
+
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "shader_m.h"
+
+//batched 2D HUD drawn over the presented image, every shape goes through
+//one dynamic vertex buffer and a single draw call per frame
+
+enum OverlayShape
+{
+    OVERLAY_STAR = 0,
+    OVERLAY_DISC = 1,   //solid between the two radii
+    OVERLAY_RING = 2    //fades out from the inner to the outer radius
+};
+
+struct OverlayVertex
+{
+    glm::vec2 pos;      //window pixels, origin bottom left
+    glm::vec2 local;    //shape space, star in [-1,1], discs in radius units
+    glm::vec4 color;
+    glm::vec4 params;   //shape, inner radius, outer radius, unused
+};
+
+struct Overlay
+{
+    std::vector<OverlayVertex> vertices;
+    unsigned int vao = 0, vbo = 0;
+    size_t       capacity = 0;
+
+    Shader* shader = nullptr;
+};
+
+void InitOverlay(Overlay& overlay);
+void BeginOverlay(Overlay& overlay);
+
+//star filling the square at minCorner with the given size in pixels
+void OverlayStar(Overlay& overlay, const glm::vec2& minCorner, float size, const glm::vec4& color);
+
+//disc or ring around centre, radii are in units of pixelsPerUnit
+void OverlayCircle(Overlay& overlay, OverlayShape shape, const glm::vec2& centre, float pixelsPerUnit,
+    float innerRadius, float outerRadius, const glm::vec4& color);
+
+void DrawOverlay(Overlay& overlay, int screenWidth, int screenHeight);
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+//on disk layout of the asset pack, shared by the game and tools/packassets:
+//
+//  PackHeader | entry data, each PACK_ALIGN aligned | PackEntry[entryCount] | names
+//
+//the TOC is sorted by path hash so lookups are a binary search straight over
+//the mapped file; names are kept to resolve hash collisions and for listings
+
+const uint32_t PACK_MAGIC = 0x4B504343;     //"CCPK"
+const uint32_t PACK_VERSION = 1;
+const uint32_t PACK_ALIGN = 64;
+
+enum PackEntryFlags
+{
+    PACK_ENTRY_LZ4 = 1     //stored as one LZ4 block of packedSize bytes
+};
+
+struct PackHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+    uint64_t tocOffset;
+    uint64_t namesOffset;
+};
+
+struct PackEntry
+{
+    uint64_t hash;
+    uint64_t offset;
+    uint32_t size;          //bytes once unpacked
+    uint32_t packedSize;    //bytes in the file
+    uint32_t flags;
+    uint32_t nameOffset;    //from namesOffset, zero terminated
+};
+
+static_assert(sizeof(PackHeader) == 32, "PackHeader layout");
+static_assert(sizeof(PackEntry) == 32, "PackEntry layout");
+
+//pack keys are relative paths with '/' separators, lower case (the loose files
+//are opened on Windows), without "." segments and with ".." folded away
+inline std::string NormalizeAssetPath(const char* path)
+{
+    std::string out;
+    const char* p = path;
+    while (*p)
+    {
+        const char* end = p;
+        while (*end && *end != '/' && *end != '\\')
+            ++end;
+
+        std::string segment(p, end);
+        if (segment == "..")
+        {
+            size_t slash = out.find_last_of('/');
+            size_t parent = (slash == std::string::npos) ? 0 : slash;
+            size_t last = (slash == std::string::npos) ? 0 : slash + 1;
+            if (!out.empty() && out.compare(last, std::string::npos, "..") != 0)
+                out.erase(parent);
+            else
+                out += out.empty() ? ".." : "/..";
+        }
+        else if (!segment.empty() && segment != ".")
+        {
+            if (!out.empty()) out += '/';
+            for (char c : segment)
+                out += (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+        }
+
+        p = *end ? end + 1 : end;
+    }
+    return out;
+}
+
+//64 bit FNV-1a of the normalized path
+inline uint64_t HashAssetPath(const std::string& path)
+{
+    uint64_t h = 14695981039346656037ull;
+    for (char c : path)
+    {
+        h ^= (unsigned char)c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
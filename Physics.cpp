@@ -1,6 +1,21 @@
 #include "Physics.h"
+#include "Terrain.h"
+#include <algorithm>
+#include <cfloat>
 #include <cmath>
 
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PHYSICS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define PHYSICS_TARGET_AVX
+#else
+#include <cpuid.h>
+#define PHYSICS_TARGET_AVX __attribute__((target("avx")))
+#endif
+#endif
+
 float gravity = -9.81f;
 
 void UpdatePhysics(PhysicsBody& b, float dt)
@@ -10,9 +25,10 @@ void UpdatePhysics(PhysicsBody& b, float dt)
 
     b.pos += b.vel * dt;
 
-    if (b.pos.y - b.size.y < 0)
+    float ground = TerrainHeight(b.pos.x, b.pos.z);
+    if (b.pos.y - b.size.y < ground)
     {
-        b.pos.y = b.size.y;
+        b.pos.y = ground + b.size.y;
         b.vel.y = 0;
         b.grounded = true;
     }
@@ -26,10 +42,15 @@ void UpdateSphere(Sphere& s, float dt)
 
     s.pos += s.vel * dt;
 
-    if (s.pos.y - s.radius < 0)
+    float ground = TerrainHeight(s.pos.x, s.pos.z);
+    if (s.pos.y - s.radius < ground)
     {
-        s.pos.y = s.radius;
-        s.vel.y *= -0.4f;
+        s.pos.y = ground + s.radius;
+
+        //bounce off the slope, same restitution as the old flat floor
+        glm::vec3 n = TerrainNormal(s.pos.x, s.pos.z);
+        float vN = glm::dot(s.vel, n);
+        if (vN < 0) s.vel -= n * ((1 + 0.4f) * vN);
     }
 }
 
@@ -56,13 +77,29 @@ void ResolveAABB(PhysicsBody& A, const PhysicsBody& B)
     }
 }
 
-void ResolveSphereSphere(Sphere& A, Sphere& B)
+//where contacts go, set once before the simulation starts
+static ContactRing* contactSink = nullptr;
+static float        contactMinImpulse = 0.0f;
+
+void SetContactSink(ContactRing* ring, float minImpulse)
+{
+    contactSink = ring;
+    contactMinImpulse = minImpulse;
+}
+
+void ReportContact(const glm::vec3& pos, float impulse, int bodyA, int bodyB)
+{
+    if (!contactSink || bodyA < 0 || impulse < contactMinImpulse) return;
+    contactSink->Push({ pos, impulse, bodyA, bodyB });
+}
+
+float ResolveSphereSphere(Sphere& A, Sphere& B, int idA, int idB)
 {
     glm::vec3 diff = B.pos - A.pos;
     float dist2 = glm::dot(diff, diff);
     float minDist = A.radius + B.radius;
 
-    if (dist2 >= minDist * minDist) return;
+    if (dist2 >= minDist * minDist) return 0.0f;
 
     float dist = std::sqrt(dist2);
     if (dist < 0.0001f) dist = 0.0001f;
@@ -75,26 +112,23 @@ void ResolveSphereSphere(Sphere& A, Sphere& B)
 
     glm::vec3 relVel = B.vel - A.vel;
     float velN = glm::dot(relVel, normal);
-    if (velN > 0) return;
+    if (velN > 0) return 0.0f;
 
     float j = -(1 + 0.4f) * velN / (1 / A.mass + 1 / B.mass);
     glm::vec3 impulse = j * normal;
 
     A.vel -= impulse / A.mass;
     B.vel += impulse / B.mass;
+
+    ReportContact(A.pos + normal * A.radius, j, idA, idB);
+    return j;
 }
 
-void ResolveSphereAABB(Sphere& s, PhysicsBody& box)
+//response shared by the per box and batched paths, closest is on the box
+static float ResolveSphereBoxContact(Sphere& s, const glm::vec3& closest, float dist2, int sphereId, int boxId, float* deepest)
 {
-    glm::vec3 minB = box.pos - box.size;
-    glm::vec3 maxB = box.pos + box.size;
-
-    glm::vec3 closest = glm::clamp(s.pos, minB, maxB);
     glm::vec3 diff = s.pos - closest;
 
-    float dist2 = glm::dot(diff, diff);
-    if (dist2 > s.radius * s.radius) return;
-
     float dist = std::sqrt(dist2);
     if (dist < 0.0001f) dist = 0.0001f;
 
@@ -102,8 +136,258 @@ void ResolveSphereAABB(Sphere& s, PhysicsBody& box)
     float penetration = s.radius - dist;
 
     s.pos += normal * penetration;
+    if (deepest && penetration > *deepest)
+        *deepest = penetration;
 
     float vN = glm::dot(s.vel, normal);
     s.vel -= normal * vN;
     s.vel *= 0.6f;
-}
\ No newline at end of file
+
+    //the box is static, the impulse is the normal momentum removed from the sphere
+    float j = (vN < 0.0f) ? -vN * s.mass : 0.0f;
+    if (j > 0.0f)
+        ReportContact(closest, j, sphereId, boxId);
+    return j;
+}
+
+float ResolveSphereAABB(Sphere& s, PhysicsBody& box, int sphereId, int boxId, float* penetration)
+{
+    glm::vec3 minB = box.pos - box.size;
+    glm::vec3 maxB = box.pos + box.size;
+
+    glm::vec3 closest = glm::clamp(s.pos, minB, maxB);
+    glm::vec3 diff = s.pos - closest;
+
+    float dist2 = glm::dot(diff, diff);
+    if (dist2 > s.radius * s.radius) return 0.0f;
+
+    return ResolveSphereBoxContact(s, closest, dist2, sphereId, boxId, penetration);
+}
+
+void ClearAABBBatch(AABBBatch& batch)
+{
+    batch.minX.clear(); batch.minY.clear(); batch.minZ.clear();
+    batch.maxX.clear(); batch.maxY.clear(); batch.maxZ.clear();
+    batch.ids.clear();
+    batch.groupMin.clear(); batch.groupMax.clear();
+    batch.count = 0;
+}
+
+void SetAABB(AABBBatch& batch, int lane, const PhysicsBody& box)
+{
+    glm::vec3 minB = box.pos - box.size;
+    glm::vec3 maxB = box.pos + box.size;
+
+    batch.minX[lane] = minB.x; batch.minY[lane] = minB.y; batch.minZ[lane] = minB.z;
+    batch.maxX[lane] = maxB.x; batch.maxY[lane] = maxB.y; batch.maxZ[lane] = maxB.z;
+
+    //padding lanes are inverted and drop out of the union
+    int first = lane - lane % PHYSICS_BOX_GROUP;
+    glm::vec3 gMin(FLT_MAX), gMax(-FLT_MAX);
+    for (int i = first; i < first + PHYSICS_BOX_GROUP; ++i)
+    {
+        gMin = glm::min(gMin, glm::vec3(batch.minX[i], batch.minY[i], batch.minZ[i]));
+        gMax = glm::max(gMax, glm::vec3(batch.maxX[i], batch.maxY[i], batch.maxZ[i]));
+    }
+    batch.groupMin[lane / PHYSICS_BOX_GROUP] = gMin;
+    batch.groupMax[lane / PHYSICS_BOX_GROUP] = gMax;
+}
+
+int AddAABB(AABBBatch& batch, const PhysicsBody& box, int id)
+{
+    //open a group of inverted bounds, a clamp against them lands a huge
+    //distance away so unused lanes never pass the radius test
+    if (batch.count % PHYSICS_BOX_GROUP == 0)
+    {
+        size_t lanes = batch.ids.size() + PHYSICS_BOX_GROUP;
+        batch.minX.resize(lanes, FLT_MAX); batch.minY.resize(lanes, FLT_MAX); batch.minZ.resize(lanes, FLT_MAX);
+        batch.maxX.resize(lanes, -FLT_MAX); batch.maxY.resize(lanes, -FLT_MAX); batch.maxZ.resize(lanes, -FLT_MAX);
+        batch.ids.resize(lanes, -1);
+        batch.groupMin.resize(lanes / PHYSICS_BOX_GROUP);
+        batch.groupMax.resize(lanes / PHYSICS_BOX_GROUP);
+    }
+
+    int lane = batch.count++;
+    SetAABB(batch, lane, box);
+    batch.ids[lane] = id;
+    return lane;
+}
+
+void AddAABBs(AABBBatch& batch, const std::vector<PhysicsBody>& boxes, int idBase)
+{
+    for (int i = 0; i < (int)boxes.size(); ++i)
+        AddAABB(batch, boxes[i], idBase + i);
+}
+
+//deepest overlapping lane of the group starting at first, -1 when none;
+//every kernel picks the same lane: smallest distance, lowest index on ties
+typedef int (*DeepestLaneFn)(const AABBBatch& b, int first, const glm::vec3& p, float r2, float& bestD2);
+
+static int DeepestLaneScalar(const AABBBatch& b, int first, const glm::vec3& p, float r2, float& bestD2)
+{
+    int best = -1;
+    for (int lane = first; lane < first + PHYSICS_BOX_GROUP; ++lane)
+    {
+        float dx = p.x - std::min(std::max(p.x, b.minX[lane]), b.maxX[lane]);
+        float dy = p.y - std::min(std::max(p.y, b.minY[lane]), b.maxY[lane]);
+        float dz = p.z - std::min(std::max(p.z, b.minZ[lane]), b.maxZ[lane]);
+        float d2 = dx * dx + dy * dy + dz * dz;
+
+        if (d2 <= r2 && (best < 0 || d2 < bestD2))
+        {
+            best = lane;
+            bestD2 = d2;
+        }
+    }
+    return best;
+}
+
+#ifdef PHYSICS_X86
+static int DeepestLaneSse(const AABBBatch& b, int first, const glm::vec3& p, float r2, float& bestD2)
+{
+    const __m128 px = _mm_set1_ps(p.x);
+    const __m128 py = _mm_set1_ps(p.y);
+    const __m128 pz = _mm_set1_ps(p.z);
+    const __m128 radius2 = _mm_set1_ps(r2);
+
+    int best = -1;
+    for (int half = first; half < first + PHYSICS_BOX_GROUP; half += 4)
+    {
+        __m128 dx = _mm_sub_ps(px, _mm_min_ps(_mm_max_ps(px, _mm_loadu_ps(&b.minX[half])), _mm_loadu_ps(&b.maxX[half])));
+        __m128 dy = _mm_sub_ps(py, _mm_min_ps(_mm_max_ps(py, _mm_loadu_ps(&b.minY[half])), _mm_loadu_ps(&b.maxY[half])));
+        __m128 dz = _mm_sub_ps(pz, _mm_min_ps(_mm_max_ps(pz, _mm_loadu_ps(&b.minZ[half])), _mm_loadu_ps(&b.maxZ[half])));
+        __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+        //nearly every group is rejected here
+        int mask = _mm_movemask_ps(_mm_cmple_ps(d2, radius2));
+        if (!mask) continue;
+
+        alignas(16) float d[4];
+        _mm_store_ps(d, d2);
+        for (int i = 0; i < 4; ++i)
+        {
+            if ((mask & (1 << i)) && (best < 0 || d[i] < bestD2))
+            {
+                best = half + i;
+                bestD2 = d[i];
+            }
+        }
+    }
+    return best;
+}
+
+PHYSICS_TARGET_AVX
+static int DeepestLaneAvx(const AABBBatch& b, int first, const glm::vec3& p, float r2, float& bestD2)
+{
+    const __m256 px = _mm256_set1_ps(p.x);
+    const __m256 py = _mm256_set1_ps(p.y);
+    const __m256 pz = _mm256_set1_ps(p.z);
+
+    __m256 dx = _mm256_sub_ps(px, _mm256_min_ps(_mm256_max_ps(px, _mm256_loadu_ps(&b.minX[first])), _mm256_loadu_ps(&b.maxX[first])));
+    __m256 dy = _mm256_sub_ps(py, _mm256_min_ps(_mm256_max_ps(py, _mm256_loadu_ps(&b.minY[first])), _mm256_loadu_ps(&b.maxY[first])));
+    __m256 dz = _mm256_sub_ps(pz, _mm256_min_ps(_mm256_max_ps(pz, _mm256_loadu_ps(&b.minZ[first])), _mm256_loadu_ps(&b.maxZ[first])));
+    __m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+
+    int mask = _mm256_movemask_ps(_mm256_cmp_ps(d2, _mm256_set1_ps(r2), _CMP_LE_OQ));
+    if (!mask) return -1;
+
+    alignas(32) float d[8];
+    _mm256_store_ps(d, d2);
+
+    int best = -1;
+    for (int i = 0; i < 8; ++i)
+    {
+        if ((mask & (1 << i)) && (best < 0 || d[i] < bestD2))
+        {
+            best = first + i;
+            bestD2 = d[i];
+        }
+    }
+    return best;
+}
+
+static void Cpuid(int leaf, unsigned int regs[4])
+{
+#ifdef _MSC_VER
+    int r[4];
+    __cpuidex(r, leaf, 0);
+    for (int i = 0; i < 4; ++i) regs[i] = (unsigned int)r[i];
+#else
+    __cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+//the OS has to save the ymm registers too
+static bool OsSavesYmm()
+{
+#ifdef _MSC_VER
+    return (_xgetbv(0) & 6) == 6;
+#else
+    unsigned int lo, hi;
+    __asm__ volatile ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return (lo & 6) == 6;
+#endif
+}
+#endif
+
+PhysicsSimd PhysicsSimdSupported()
+{
+#ifdef PHYSICS_X86
+    unsigned int regs[4];
+    Cpuid(1, regs);
+
+    //SSE2 is the x86 baseline the game is built for; OSXSAVE and AVX
+    if ((regs[2] & (1u << 27)) && (regs[2] & (1u << 28)) && OsSavesYmm())
+        return PHYSICS_SIMD_AVX;
+    return PHYSICS_SIMD_SSE;
+#else
+    return PHYSICS_SIMD_SCALAR;
+#endif
+}
+
+static DeepestLaneFn DeepestLaneFor(PhysicsSimd level)
+{
+#ifdef PHYSICS_X86
+    if (level == PHYSICS_SIMD_AVX) return DeepestLaneAvx;
+    if (level == PHYSICS_SIMD_SSE) return DeepestLaneSse;
+#endif
+    return DeepestLaneScalar;
+}
+
+//picked once before the simulation starts
+static DeepestLaneFn deepestLane = DeepestLaneFor(PhysicsSimdSupported());
+
+PhysicsSimd SetPhysicsSimd(PhysicsSimd level)
+{
+    level = std::min(level, PhysicsSimdSupported());
+    deepestLane = DeepestLaneFor(level);
+    return level;
+}
+
+float ResolveSphereAABBBatch(Sphere& s, const AABBBatch& batch, int sphereId, float* penetration)
+{
+    float total = 0.0f;
+    int lanes = (int)batch.ids.size();
+
+    for (int first = 0; first < lanes; first += PHYSICS_BOX_GROUP)
+    {
+        //the sphere moves with every resolve, later groups see the new position;
+        //one test against the group's union skips groups nowhere near it
+        const glm::vec3& gMin = batch.groupMin[first / PHYSICS_BOX_GROUP];
+        const glm::vec3& gMax = batch.groupMax[first / PHYSICS_BOX_GROUP];
+        glm::vec3 outside = s.pos - glm::clamp(s.pos, gMin, gMax);
+        if (glm::dot(outside, outside) > s.radius * s.radius) continue;
+
+        float d2 = 0.0f;
+        int lane = deepestLane(batch, first, s.pos, s.radius * s.radius, d2);
+        if (lane < 0) continue;
+
+        glm::vec3 closest(
+            std::min(std::max(s.pos.x, batch.minX[lane]), batch.maxX[lane]),
+            std::min(std::max(s.pos.y, batch.minY[lane]), batch.maxY[lane]),
+            std::min(std::max(s.pos.z, batch.minZ[lane]), batch.maxZ[lane]));
+
+        total += ResolveSphereBoxContact(s, closest, d2, sphereId, batch.ids[lane], penetration);
+    }
+    return total;
+}
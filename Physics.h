@@ -1,5 +1,7 @@
 #pragma once
+#include <vector>
 #include <glm/glm.hpp>
+#include "SpscRing.h"
 
 extern float gravity;
 
@@ -19,10 +21,72 @@ struct Sphere
     float     mass;
 };
 
+//closing contact found by the narrow phase, handed to the impact audio thread
+struct ContactEvent
+{
+    glm::vec3 pos;
+    float     impulse;
+    int       bodyA;
+    int       bodyB;
+};
+
+//body id ranges, the low 16 bits index into the matching list
+enum ContactBodyBase
+{
+    CONTACT_BALL = 0,
+    CONTACT_BOULDER = 1 << 16,
+    CONTACT_PIT_WALL = 2 << 16,
+    CONTACT_PLAYER = 3 << 16
+};
+
+typedef SpscRing<ContactEvent, 1024> ContactRing;
+
+//resolves given body ids push their contacts here, a full ring drops the event
+void SetContactSink(ContactRing* ring, float minImpulse);
+//for solvers outside this file, ignored when bodyA is -1 or the impulse is under the minimum
+void ReportContact(const glm::vec3& pos, float impulse, int bodyA, int bodyB);
+
 void UpdatePhysics(PhysicsBody& b, float dt);
 void UpdateSphere(Sphere& s, float dt);
 
 bool AABBCollide(const PhysicsBody& A, const PhysicsBody& B);
 void ResolveAABB(PhysicsBody& A, const PhysicsBody& B);
-void ResolveSphereSphere(Sphere& A, Sphere& B);
-void ResolveSphereAABB(Sphere& s, PhysicsBody& box);
\ No newline at end of file
+//both return the impulse applied, 0 when the bodies were not closing;
+//ids of -1 resolve without reporting a contact, penetration is raised to the
+//depth corrected when given
+float ResolveSphereSphere(Sphere& A, Sphere& B, int idA = -1, int idB = -1);
+float ResolveSphereAABB(Sphere& s, PhysicsBody& box, int sphereId = -1, int boxId = -1, float* penetration = nullptr);
+//narrow phase for one sphere against many boxes: bounds are packed structure
+//of arrays in groups of PHYSICS_BOX_GROUP lanes, a group is tested in one
+//AVX or two SSE passes and only its deepest contact is resolved
+enum { PHYSICS_BOX_GROUP = 8 };
+
+enum PhysicsSimd
+{
+    PHYSICS_SIMD_SCALAR = 0,    //reference, same lane order and results
+    PHYSICS_SIMD_SSE,
+    PHYSICS_SIMD_AVX
+};
+
+struct AABBBatch
+{
+    std::vector<float> minX, minY, minZ;
+    std::vector<float> maxX, maxY, maxZ;
+    std::vector<int>   ids;     //contact body id per lane
+    std::vector<glm::vec3> groupMin, groupMax;  //union of each group's lanes
+    int count = 0;              //real lanes, the rest of the last group never overlaps
+};
+
+//highest level the CPU and OS support
+PhysicsSimd PhysicsSimdSupported();
+//clamped to what is supported, returns the level in use
+PhysicsSimd SetPhysicsSimd(PhysicsSimd level);
+
+void ClearAABBBatch(AABBBatch& batch);
+int  AddAABB(AABBBatch& batch, const PhysicsBody& box, int id);
+void AddAABBs(AABBBatch& batch, const std::vector<PhysicsBody>& boxes, int idBase);
+void SetAABB(AABBBatch& batch, int lane, const PhysicsBody& box);
+
+//same response as ResolveSphereAABB per contact, returns the summed impulse;
+//a sphereId of -1 resolves without reporting contacts
+float ResolveSphereAABBBatch(Sphere& s, const AABBBatch& batch, int sphereId = -1, float* penetration = nullptr);
@@ -0,0 +1,87 @@
+#include <iostream>
+#include <algorithm>
+#include <glad.h>
+#include "RenderTarget.h"
+
+//attribute-less VAO for the fullscreen triangle
+static unsigned int fullscreenVAO = 0;
+
+bool ResizeSceneTarget(SceneTarget& target, int width, int height)
+{
+    if (width < 1) width = 1;
+    if (height < 1) height = 1;
+    if (target.fbo && target.width == width && target.height == height)
+        return false;
+
+    if (!target.fbo)
+    {
+        glGenFramebuffers(1, &target.fbo);
+        glGenTextures(1, &target.colorTex);
+        glGenTextures(1, &target.depthTex);
+    }
+
+    target.width = width;
+    target.height = height;
+
+    glBindTexture(GL_TEXTURE_2D, target.colorTex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glBindTexture(GL_TEXTURE_2D, target.depthTex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.colorTex, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, target.depthTex, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::FRAMEBUFFER:: scene target incomplete\n";
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return true;
+}
+
+void ScaledTargetSize(const PostSettings& post, int screenWidth, int screenHeight, int& width, int& height)
+{
+    float scale = std::min(std::max(post.renderScale, 0.25f), 1.0f);
+    width = std::max(1, (int)(screenWidth * scale + 0.5f));
+    height = std::max(1, (int)(screenHeight * scale + 0.5f));
+}
+
+void PresentSceneTarget(const SceneTarget& target, Shader& postShader, const PostSettings& post,
+    int screenWidth, int screenHeight)
+{
+    if (!fullscreenVAO)
+        glGenVertexArrays(1, &fullscreenVAO);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, screenWidth, screenHeight);
+    glDisable(GL_DEPTH_TEST);
+
+    postShader.use();
+    postShader.setInt("sceneTex", 0);
+    postShader.setVec2("texelSize", 1.0f / target.width, 1.0f / target.height);
+    postShader.setFloat("exposure", post.exposure);
+    postShader.setFloat("whitePoint", post.whitePoint);
+    postShader.setFloat("colorSteps", post.colorSteps);
+    postShader.setFloat("wobbleAmount", post.wobbleAmount);
+    postShader.setBool("fxaaEnabled", post.fxaa);
+
+    //bilinear fetch does the upscale when rendering below window resolution
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, target.colorTex);
+
+    glBindVertexArray(fullscreenVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    glEnable(GL_DEPTH_TEST);
+}
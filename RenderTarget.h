@@ -0,0 +1,33 @@
+#pragma once
+#include "shader_m.h"
+
+//offscreen HDR colour + depth the main pass renders into, so later passes can sample its depth
+struct SceneTarget
+{
+    unsigned int fbo = 0;
+    unsigned int colorTex = 0;
+    unsigned int depthTex = 0;
+    int width = 0;
+    int height = 0;
+};
+
+//post chain settings, all applied by retro_post.frag in one fullscreen pass
+struct PostSettings
+{
+    float renderScale = 1.0f;   //internal resolution relative to the window, 0.5 - 1
+    float exposure = 1.0f;
+    float whitePoint = 1.0f;    //1 keeps the LDR look, higher rolls highlights off
+    float colorSteps = 32.0f;
+    float wobbleAmount = 0.0f;
+    bool  fxaa = true;
+};
+
+//(re)allocates the attachments when the size changes, returns true if it did
+bool ResizeSceneTarget(SceneTarget& target, int width, int height);
+
+//window size scaled by renderScale, clamped to at least one pixel
+void ScaledTargetSize(const PostSettings& post, int screenWidth, int screenHeight, int& width, int& height);
+
+//runs the fused post shader over the target and upscales into the default framebuffer
+void PresentSceneTarget(const SceneTarget& target, Shader& postShader, const PostSettings& post,
+    int screenWidth, int screenHeight);
@@ -0,0 +1,260 @@
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include "Sfx.h"
+
+using namespace irrklang;
+
+void InitSfx(SfxBank& bank, ISoundEngine* engine)
+{
+    bank.engine = engine;
+    bank.sources.reserve(16);
+    bank.emitters.reserve(128);
+    bank.order.reserve(128);
+}
+
+SfxHandle LoadSfx(SfxBank& bank, const char* path, float volume, bool stream)
+{
+    if (!bank.engine) return -1;
+
+    ISoundSource* source = bank.engine->addSoundSourceFromFile(path,
+        stream ? ESM_STREAMING : ESM_NO_STREAMING, !stream);
+    if (!source)
+    {
+        std::cout << "Failed to load sound " << path << "\n";
+        return -1;
+    }
+
+    source->setDefaultVolume(volume);
+    bank.sources.push_back(source);
+    return (SfxHandle)bank.sources.size() - 1;
+}
+
+static void ReleaseVoice(SfxVoice& v)
+{
+    if (v.sound)
+    {
+        v.sound->stop();
+        v.sound->drop();
+        v.sound = nullptr;
+    }
+    v.priority = 0;
+    v.emitterKey = 0;
+    v.positional = false;
+}
+
+static irrklang::vec3df ToIrr(const glm::vec3& v)
+{
+    return irrklang::vec3df(v.x, v.y, v.z);
+}
+
+static int FindVoice(SfxBank& bank, int priority)
+{
+    int steal = -1;
+
+    for (int i = 0; i < SfxBank::VoiceCount; ++i)
+    {
+        SfxVoice& v = bank.voices[i];
+        if (!v.sound) return i;
+
+        if (v.sound->isFinished())
+        {
+            ReleaseVoice(v);
+            return i;
+        }
+
+        //lowest priority first, oldest within the same priority
+        if (v.priority <= priority &&
+            (steal < 0 ||
+                v.priority < bank.voices[steal].priority ||
+                (v.priority == bank.voices[steal].priority && v.serial < bank.voices[steal].serial)))
+            steal = i;
+    }
+
+    if (steal >= 0)
+    {
+        ReleaseVoice(bank.voices[steal]);
+        bank.stolen++;
+    }
+    return steal;
+}
+
+static SfxVoiceId StartVoice(SfxBank& bank, int slot, ISound* sound, int priority)
+{
+    SfxVoice& v = bank.voices[slot];
+    v.sound = sound;
+    v.priority = priority;
+    v.serial = bank.nextSerial++;
+
+    SfxVoiceId id;
+    id.voice = slot;
+    id.serial = v.serial;
+    return id;
+}
+
+SfxVoiceId PlaySfx(SfxBank& bank, SfxHandle sfx, int priority, float volume, float pan)
+{
+    SfxVoiceId id;
+    if (!bank.engine || sfx < 0 || sfx >= (int)bank.sources.size()) return id;
+
+    int slot = FindVoice(bank, priority);
+    if (slot < 0)
+    {
+        bank.rejected++;
+        return id;
+    }
+
+    //start paused so volume and pan apply before the first sample
+    ISound* sound = bank.engine->play2D(bank.sources[sfx], false, true, true);
+    if (!sound) return id;
+
+    if (volume >= 0.0f) sound->setVolume(volume);
+    sound->setPan(pan);
+    sound->setIsPaused(false);
+
+    return StartVoice(bank, slot, sound, priority);
+}
+
+SfxVoiceId PlaySfxAt(SfxBank& bank, const SfxEmitter& e)
+{
+    SfxVoiceId id;
+    if (!bank.engine || e.sfx < 0 || e.sfx >= (int)bank.sources.size()) return id;
+
+    int slot = FindVoice(bank, e.priority);
+    if (slot < 0)
+    {
+        bank.rejected++;
+        return id;
+    }
+
+    ISound* sound = bank.engine->play3D(bank.sources[e.sfx], ToIrr(e.pos), e.key != 0, true, true);
+    if (!sound) return id;
+
+    sound->setVolume(e.volume);
+    sound->setMinDistance(e.minDistance);
+    if (e.speed != 1.0f) sound->setPlaybackSpeed(e.speed);
+    sound->setIsPaused(false);
+
+    id = StartVoice(bank, slot, sound, e.priority);
+    bank.voices[slot].emitterKey = e.key;
+    bank.voices[slot].pos = e.pos;
+    bank.voices[slot].positional = true;
+    return id;
+}
+
+void StopSfx(SfxBank& bank, SfxVoiceId id)
+{
+    if (id.voice < 0 || id.voice >= SfxBank::VoiceCount) return;
+
+    SfxVoice& v = bank.voices[id.voice];
+    if (v.serial == id.serial)
+        ReleaseVoice(v);
+}
+
+void BeginSfxFrame(SfxBank& bank)
+{
+    bank.emitters.clear();
+}
+
+void AddSfxEmitter(SfxBank& bank, const SfxEmitter& emitter)
+{
+    bank.emitters.push_back(emitter);
+}
+
+void UpdateSfx(SfxBank& bank, const glm::vec3& listenerPos, const glm::vec3& listenerForward)
+{
+    if (!bank.engine) return;
+
+    bank.engine->setListenerPosition(ToIrr(listenerPos), ToIrr(listenerForward),
+        irrklang::vec3df(0, 0, 0), irrklang::vec3df(0, 1, 0));
+
+    //same rolloff irrKlang applies, min / distance past the full volume radius
+    bank.order.clear();
+    for (int i = 0; i < (int)bank.emitters.size(); ++i)
+    {
+        SfxEmitter& e = bank.emitters[i];
+        glm::vec3 d = e.pos - listenerPos;
+        float dist2 = glm::dot(d, d);
+        if (dist2 > e.maxDistance * e.maxDistance) continue;
+
+        float dist = std::sqrt(dist2);
+        e.gain = e.volume * ((dist <= e.minDistance) ? 1.0f : e.minDistance / dist);
+        if (e.gain < bank.minGain) continue;
+
+        bank.order.push_back(i);
+    }
+
+    //priority first, then loudest
+    std::sort(bank.order.begin(), bank.order.end(), [&](int a, int b)
+        {
+            const SfxEmitter& ea = bank.emitters[a];
+            const SfxEmitter& eb = bank.emitters[b];
+            if (ea.priority != eb.priority) return ea.priority > eb.priority;
+            return ea.gain > eb.gain;
+        });
+    //one shots from earlier frames still playing count against the cap
+    int budget = bank.maxAudible;
+    for (auto& v : bank.voices)
+    {
+        v.touched = false;
+        if (v.sound && v.positional && v.emitterKey == 0 && !v.sound->isFinished())
+            budget--;
+    }
+
+    //looping emitters keep their voice and only move, new ones and one shots start
+    for (int i : bank.order)
+    {
+        if (budget <= 0) break;
+        budget--;
+
+        const SfxEmitter& e = bank.emitters[i];
+
+        int existing = -1;
+        if (e.key != 0)
+        {
+            for (int v = 0; v < SfxBank::VoiceCount; ++v)
+            {
+                if (bank.voices[v].sound && bank.voices[v].emitterKey == e.key)
+                {
+                    existing = v;
+                    break;
+                }
+            }
+        }
+
+        if (existing >= 0)
+        {
+            SfxVoice& v = bank.voices[existing];
+            v.touched = true;
+
+            glm::vec3 moved = e.pos - v.pos;
+            if (glm::dot(moved, moved) > 1e-4f)
+            {
+                v.sound->setPosition(ToIrr(e.pos));
+                v.pos = e.pos;
+            }
+            continue;
+        }
+
+        SfxVoiceId id = PlaySfxAt(bank, e);
+        if (id.voice >= 0)
+            bank.voices[id.voice].touched = true;
+    }
+
+    //looping emitters that went away or were culled this frame
+    int audible = 0;
+    for (auto& v : bank.voices)
+    {
+        if (v.emitterKey != 0 && !v.touched)
+            ReleaseVoice(v);
+        if (v.sound && v.positional)
+            audible++;
+    }
+    bank.audibleLastFrame = audible;
+}
+
+void ShutdownSfx(SfxBank& bank)
+{
+    for (auto& v : bank.voices)
+        ReleaseVoice(v);
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include <irrKlang.h>
+
+//preloaded sound effects played through a fixed pool of voices, nothing on
+//the trigger path touches the filesystem or the console
+
+typedef int SfxHandle;      //index into SfxBank::sources, -1 if loading failed
+
+struct SfxVoiceId
+{
+    int          voice = -1;
+    unsigned int serial = 0;    //guards against the voice being reused since
+};
+
+struct SfxVoice
+{
+    irrklang::ISound* sound = nullptr;
+    int          priority = 0;
+    unsigned int serial = 0;    //also orders voices by start time for stealing
+    unsigned int emitterKey = 0;    //looping emitter that owns the voice, 0 for none
+    glm::vec3    pos = glm::vec3(0.0f);
+    bool         positional = false;
+    bool         touched = false;   //emitter still selected this frame
+};
+
+//a positional sound gathered for this frame, looping emitters are matched
+//to their voice by key across frames, one shots start once
+struct SfxEmitter
+{
+    glm::vec3    pos = glm::vec3(0.0f);
+    SfxHandle    sfx = -1;
+    unsigned int key = 0;           //non zero for looping emitters
+    float        volume = 1.0f;
+    float        speed = 1.0f;      //playback speed, pitches one shots
+    float        minDistance = 2.0f;    //full volume inside, 1/d rolloff beyond
+    float        maxDistance = 40.0f;   //culled beyond
+    int          priority = 0;
+
+    float        gain = 0.0f;       //estimated audible level, filled in by UpdateSfx
+};
+
+struct SfxBank
+{
+    static const int VoiceCount = 16;
+
+    irrklang::ISoundEngine* engine = nullptr;
+    std::vector<irrklang::ISoundSource*> sources;   //owned by the engine
+
+    SfxVoice     voices[VoiceCount];
+    unsigned int nextSerial = 1;
+    int          stolen = 0;
+    int          rejected = 0;
+
+    //positional emitters collected after the physics step
+    std::vector<SfxEmitter> emitters;
+    std::vector<int>        order;          //scratch for sorting by audibility
+    int   maxAudible = 10;                  //cap on concurrently playing positional voices
+    float minGain = 0.01f;                  //quieter emitters are culled
+    int   audibleLastFrame = 0;
+};
+
+void InitSfx(SfxBank& bank, irrklang::ISoundEngine* engine);
+
+//decodes the whole file into memory up front (ESM_NO_STREAMING)
+//stream keeps long music on disk instead
+SfxHandle LoadSfx(SfxBank& bank, const char* path, float volume = 1.0f, bool stream = false);
+
+//takes a free voice, or steals the oldest voice of lower or equal priority;
+//returns an invalid id when every voice is busy with something more important
+SfxVoiceId PlaySfx(SfxBank& bank, SfxHandle sfx, int priority, float volume = -1.0f, float pan = 0.0f);
+void       StopSfx(SfxBank& bank, SfxVoiceId id);
+
+//one positional voice right away, bypassing the per frame emitter selection
+SfxVoiceId PlaySfxAt(SfxBank& bank, const SfxEmitter& emitter);
+
+//emitters are gathered every frame, then UpdateSfx culls them by distance and
+//estimated level, keeps the loudest maxAudible and pushes the listener and all
+//voice positions to irrKlang in one pass
+void BeginSfxFrame(SfxBank& bank);
+void AddSfxEmitter(SfxBank& bank, const SfxEmitter& emitter);
+void UpdateSfx(SfxBank& bank, const glm::vec3& listenerPos, const glm::vec3& listenerForward);
+
+void ShutdownSfx(SfxBank& bank);
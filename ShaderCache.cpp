@@ -0,0 +1,325 @@
+#include <iostream>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <future>
+#include <cstdint>
+#include <cstdio>
+#include <glad.h>
+#include "ShaderCache.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#define MakeDir(p) _mkdir(p)
+#else
+#include <sys/stat.h>
+#define MakeDir(p) mkdir(p, 0755)
+#endif
+
+static const char*   cacheDir = "shadercache";
+static const uint32_t cacheMagic = 0x43485348;   //"HSHC"
+
+//one program in flight
+struct PendingProgram
+{
+    std::string vertex, fragment, compute;   //sources with defines injected
+    uint64_t    key = 0;
+    std::string path;
+
+    std::vector<char> binary;   //cached binary, empty on a miss
+    GLenum            binaryFormat = 0;
+
+    unsigned int stages[2] = {};
+    unsigned int program = 0;
+};
+
+static std::string ReadSource(const char* path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << path << "\n";
+        return std::string();
+    }
+    std::stringstream ss;
+    ss << file.rdbuf();
+    std::string src = ss.str();
+
+    //some of the shaders were saved with a UTF-8 BOM
+    if (src.size() >= 3 && (unsigned char)src[0] == 0xEF && (unsigned char)src[1] == 0xBB && (unsigned char)src[2] == 0xBF)
+        src.erase(0, 3);
+    return src;
+}
+
+//defines go straight after #version, #line keeps error messages on the file's numbering
+static std::string InjectDefines(const std::string& src, const std::vector<std::string>& defines)
+{
+    if (src.empty() || defines.empty()) return src;
+
+    size_t version = src.find("#version");
+    size_t lineEnd = (version == std::string::npos) ? 0 : src.find('\n', version);
+    size_t insertAt = (lineEnd == std::string::npos) ? src.size() : lineEnd + 1;
+    int    nextLine = 1 + (int)std::count(src.begin(), src.begin() + insertAt, '\n');
+
+    std::string block;
+    for (const auto& d : defines)
+        block += "#define " + d + "\n";
+    block += "#line " + std::to_string(nextLine) + "\n";
+
+    return src.substr(0, insertAt) + block + src.substr(insertAt);
+}
+
+//FNV-1a
+static uint64_t HashBytes(const char* data, size_t size, uint64_t h = 14695981039346656037ull)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        h ^= (unsigned char)data[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static uint64_t HashString(const std::string& s, uint64_t h)
+{
+    //length first so "ab"+"c" and "a"+"bc" differ
+    uint64_t len = s.size();
+    h = HashBytes((const char*)&len, sizeof(len), h);
+    return HashBytes(s.data(), s.size(), h);
+}
+
+static std::string GLString(GLenum name)
+{
+    const GLubyte* s = glGetString(name);
+    return s ? std::string((const char*)s) : std::string();
+}
+
+static bool ReadCacheFile(const std::string& path, std::vector<char>& binary, GLenum& format)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+
+    uint32_t magic = 0, fmt = 0, size = 0;
+    file.read((char*)&magic, sizeof(magic));
+    file.read((char*)&fmt, sizeof(fmt));
+    file.read((char*)&size, sizeof(size));
+    if (!file || magic != cacheMagic || size == 0) return false;
+
+    binary.resize(size);
+    file.read(binary.data(), size);
+    if (!file)
+    {
+        binary.clear();
+        return false;
+    }
+    format = (GLenum)fmt;
+    return true;
+}
+
+static void WriteCacheFile(const std::string& path, unsigned int program)
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+    MakeDir(cacheDir);
+
+    //write then rename so a crash never leaves a truncated entry behind
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        if (!file) return;
+
+        uint32_t magic = cacheMagic, fmt = format, size = (uint32_t)length;
+        file.write((const char*)&magic, sizeof(magic));
+        file.write((const char*)&fmt, sizeof(fmt));
+        file.write((const char*)&size, sizeof(size));
+        file.write(binary.data(), length);
+    }
+    std::remove(path.c_str());
+    std::rename(tmp.c_str(), path.c_str());
+}
+
+static unsigned int SubmitStage(GLenum type, const std::string& src)
+{
+    const char* code = src.c_str();
+    unsigned int stage = glCreateShader(type);
+    glShaderSource(stage, 1, &code, NULL);
+    glCompileShader(stage);
+    return stage;
+}
+
+static bool CheckStage(unsigned int stage, const char* type, const char* path)
+{
+    GLint success = 0;
+    glGetShaderiv(stage, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        GLchar infoLog[1024];
+        glGetShaderInfoLog(stage, 1024, NULL, infoLog);
+        std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << " (" << path << ")\n" << infoLog << "\n";
+    }
+    return success != 0;
+}
+
+std::vector<Shader*> BuildShaderPrograms(const std::vector<ShaderProgramDesc>& descs, ShaderCacheStats* stats)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    //binary formats are only valid for the exact driver that produced them
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    const bool cacheEnabled = formatCount > 0;
+
+    uint64_t driverKey = 14695981039346656037ull;
+    driverKey = HashString(GLString(GL_VENDOR), driverKey);
+    driverKey = HashString(GLString(GL_RENDERER), driverKey);
+    driverKey = HashString(GLString(GL_VERSION), driverKey);
+
+    //file reads, define injection, hashing and cache lookups on worker threads
+    std::vector<std::future<PendingProgram>> loads;
+    loads.reserve(descs.size());
+    for (const auto& desc : descs)
+    {
+        loads.push_back(std::async(std::launch::async, [&desc, driverKey, cacheEnabled]()
+            {
+                PendingProgram p;
+                if (desc.computePath)
+                {
+                    p.compute = InjectDefines(ReadSource(desc.computePath), desc.defines);
+                }
+                else
+                {
+                    p.vertex = InjectDefines(ReadSource(desc.vertexPath), desc.defines);
+                    p.fragment = InjectDefines(ReadSource(desc.fragmentPath), desc.defines);
+                }
+
+                p.key = HashString(p.vertex, driverKey);
+                p.key = HashString(p.fragment, p.key);
+                p.key = HashString(p.compute, p.key);
+
+                char name[32];
+                std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)p.key);
+                p.path = std::string(cacheDir) + "/" + name;
+
+                if (cacheEnabled)
+                    ReadCacheFile(p.path, p.binary, p.binaryFormat);
+                return p;
+            }));
+    }
+
+    std::vector<PendingProgram> pending;
+    pending.reserve(descs.size());
+    for (auto& f : loads)
+        pending.push_back(f.get());
+
+    int hits = 0, compiled = 0;
+
+    //warm path, a binary the driver still accepts needs no compilation at all
+    for (auto& p : pending)
+    {
+        if (p.binary.empty()) continue;
+
+        p.program = glCreateProgram();
+        glProgramBinary(p.program, p.binaryFormat, p.binary.data(), (GLsizei)p.binary.size());
+
+        GLint ok = 0;
+        glGetProgramiv(p.program, GL_LINK_STATUS, &ok);
+        if (ok)
+        {
+            ++hits;
+        }
+        else
+        {
+            //driver update or corrupt entry, recompile below
+            glDeleteProgram(p.program);
+            p.program = 0;
+        }
+        p.binary.clear();
+    }
+
+    //cold path, submit every compile and link before waiting on any of them
+    for (auto& p : pending)
+    {
+        if (p.program) continue;
+
+        if (!p.compute.empty())
+        {
+            p.stages[0] = SubmitStage(GL_COMPUTE_SHADER, p.compute);
+        }
+        else
+        {
+            p.stages[0] = SubmitStage(GL_VERTEX_SHADER, p.vertex);
+            p.stages[1] = SubmitStage(GL_FRAGMENT_SHADER, p.fragment);
+        }
+    }
+
+    for (auto& p : pending)
+    {
+        if (p.program) continue;
+
+        p.program = glCreateProgram();
+        if (cacheEnabled)
+            glProgramParameteri(p.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        for (unsigned int stage : p.stages)
+            if (stage) glAttachShader(p.program, stage);
+        glLinkProgram(p.program);
+    }
+
+    std::vector<Shader*> shaders;
+    shaders.reserve(pending.size());
+    for (size_t i = 0; i < pending.size(); ++i)
+    {
+        PendingProgram& p = pending[i];
+        const ShaderProgramDesc& desc = descs[i];
+
+        if (p.stages[0])
+        {
+            ++compiled;
+
+            if (desc.computePath)
+            {
+                CheckStage(p.stages[0], "COMPUTE", desc.computePath);
+            }
+            else
+            {
+                CheckStage(p.stages[0], "VERTEX", desc.vertexPath);
+                CheckStage(p.stages[1], "FRAGMENT", desc.fragmentPath);
+            }
+
+            GLint linked = 0;
+            glGetProgramiv(p.program, GL_LINK_STATUS, &linked);
+            if (!linked)
+            {
+                GLchar infoLog[1024];
+                glGetProgramInfoLog(p.program, 1024, NULL, infoLog);
+                std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: PROGRAM\n" << infoLog << "\n";
+            }
+            else if (cacheEnabled)
+            {
+                WriteCacheFile(p.path, p.program);
+            }
+
+            for (unsigned int stage : p.stages)
+                if (stage) glDeleteShader(stage);
+        }
+
+        Shader* shader = new Shader();
+        shader->ID = p.program;
+        shaders.push_back(shader);
+    }
+
+    if (stats)
+    {
+        stats->programs = (int)pending.size();
+        stats->cacheHits = hits;
+        stats->compiled = compiled;
+        stats->milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    return shaders;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "shader_m.h"
+
+//builds shader programs with injected #defines and keeps the linked binaries
+//on disk, keyed by the final source text and the driver, so a warm start
+//skips GLSL compilation
+
+struct ShaderProgramDesc
+{
+    const char* vertexPath = nullptr;     //vertex + fragment program
+    const char* fragmentPath = nullptr;
+    const char* computePath = nullptr;    //or a compute program
+    std::vector<std::string> defines;     //"NAME" or "NAME VALUE"
+};
+
+struct ShaderCacheStats
+{
+    int    programs = 0;
+    int    cacheHits = 0;
+    int    compiled = 0;
+    double milliseconds = 0.0;
+};
+
+//compiles the whole batch at once: sources are loaded and hashed on worker
+//threads, then every miss is submitted before any status is queried so
+//drivers with background compilation work on them together
+std::vector<Shader*> BuildShaderPrograms(const std::vector<ShaderProgramDesc>& descs,
+    ShaderCacheStats* stats = nullptr);
@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include "Simulation.h"
+
+static void MovePlayer(World& world, const SimInput& in, float dt)
+{
+    float speed = 6.0f;
+
+    glm::vec3 fwd = glm::normalize(glm::vec3(in.front.x, 0, in.front.z));
+    glm::vec3 right = glm::normalize(glm::cross(fwd, glm::vec3(0, 1, 0)));
+
+    if (in.keys & SIM_KEY_FORWARD) world.player.pos += fwd * speed * dt;
+    if (in.keys & SIM_KEY_BACK)    world.player.pos -= fwd * speed * dt;
+    if (in.keys & SIM_KEY_LEFT)    world.player.pos -= right * speed * dt;
+    if (in.keys & SIM_KEY_RIGHT)   world.player.pos += right * speed * dt;
+
+    if ((in.keys & SIM_KEY_JUMP) && world.player.grounded)
+    {
+        world.player.vel.y = 6;
+        world.player.grounded = false;
+    }
+}
+
+double SimClock()
+{
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void Advance(World& world, const SimInput& held, float dt)
+{
+    if (dt <= 0.0f) return;
+
+    //cockroach timers
+    for (auto& r : world.cockroaches)
+        r.time += dt;
+
+    MovePlayer(world, held, dt);
+    UpdateWorld(world, dt);
+}
+
+static void SimulationThread(Simulation* sim)
+{
+    using Clock = std::chrono::steady_clock;
+
+    World& world = *sim->world;
+    SimInput held;
+    double   lastEvent = 0.0;
+
+    const auto period = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / sim->stepRate));
+    auto next = Clock::now();
+
+    while (sim->running.load(std::memory_order_acquire))
+    {
+        double now = SimClock();
+        double cursor = std::max(sim->time, now - sim->maxStep);
+
+        //latest held keys and look direction
+        SimInput in;
+        while (sim->input.Pop(in))
+            held = in;
+
+        //presses in order, the step is split at each one so QTE and skull
+        //checks run against the world at the press; one that arrives after
+        //its time was already stepped is judged lateBy in the past
+        SimEvent ev;
+        while (sim->events.Pop(ev))
+        {
+            double at = std::min(ev.time, now);
+            if (at > cursor)
+            {
+                Advance(world, held, (float)(at - cursor));
+                cursor = at;
+            }
+
+            if (ev.type == SIM_EVENT_INTERACT)
+                HandleInteractInput(world, (float)(cursor - ev.time));
+            lastEvent = ev.time;
+        }
+
+        Advance(world, held, (float)(now - cursor));
+        sim->time = now;
+
+        //positional audio from the settled transforms
+        UpdateAudio(world, world.player.pos + glm::vec3(0, 1, 0), held.front);
+
+        RenderSnapshot& snap = sim->snapshots.Back();
+        BuildRenderSnapshot(world, snap);
+        snap.step = sim->steps.fetch_add(1, std::memory_order_relaxed) + 1;
+        snap.inputTime = held.time;
+        snap.eventTime = lastEvent;
+        if (sim->snapshots.Publish())
+            sim->unseen.fetch_add(1, std::memory_order_relaxed);
+
+        //fixed cadence, a late step starts the next one straight away
+        next += period;
+        if (next < Clock::now())
+            next = Clock::now();
+        std::this_thread::sleep_until(next);
+    }
+}
+
+void StartSimulation(Simulation& sim, World& world)
+{
+    sim.world = &world;
+    sim.time = SimClock();
+
+    BuildRenderSnapshot(world, sim.snapshots.Back());
+    sim.snapshots.Publish();
+
+    sim.running.store(true, std::memory_order_release);
+    sim.thread = std::thread(SimulationThread, &sim);
+}
+
+void SubmitSimInput(Simulation& sim, const SimInput& input)
+{
+    //a full ring means the simulation stalled for 64 frames, dropping is fine
+    sim.input.Push(input);
+}
+
+void SubmitSimEvent(Simulation& sim, const SimEvent& ev)
+{
+    sim.events.Push(ev);
+}
+
+const RenderSnapshot& AcquireSnapshot(Simulation& sim)
+{
+    if (!sim.snapshots.Acquire())
+        sim.repeated++;
+    sim.frames++;
+    return sim.snapshots.Front();
+}
+
+void StopSimulation(Simulation& sim)
+{
+    sim.running.store(false, std::memory_order_release);
+    if (sim.thread.joinable())
+        sim.thread.join();
+
+    std::cout << "Simulation: " << sim.steps.load() << " steps, "
+        << sim.frames << " frames, "
+        << sim.repeated << " frames reused a snapshot, "
+        << sim.unseen.load() << " snapshots never drawn\n";
+    PrintSolverStats(sim.world->ballSolver);
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <glm/glm.hpp>
+#include "World.h"
+#include "SpscRing.h"
+#include "TripleBuffer.h"
+
+//held keys, sampled on the main thread because GLFW input is main thread only
+enum SimKey
+{
+    SIM_KEY_FORWARD = 1 << 0,
+    SIM_KEY_BACK = 1 << 1,
+    SIM_KEY_LEFT = 1 << 2,
+    SIM_KEY_RIGHT = 1 << 3,
+    SIM_KEY_JUMP = 1 << 4
+};
+
+//held state as of one render frame's late input sample
+struct SimInput
+{
+    unsigned int keys = 0;
+    glm::vec3    front = glm::vec3(0, 0, -1);
+    double       time = 0.0;    //SimClock
+};
+
+enum SimEventType
+{
+    SIM_EVENT_INTERACT = 0      //E went down
+};
+
+//presses carry the time the key callback saw them, the simulation splits its
+//step there so timed checks see the world as it was at the press
+struct SimEvent
+{
+    SimEventType type = SIM_EVENT_INTERACT;
+    double       time = 0.0;    //SimClock
+};
+
+//seconds on the clock input, snapshots and frame pacing share
+double SimClock();
+
+//owns World's game state once started: the thread steps it at its own rate
+//and publishes a RenderSnapshot after every step, the render thread only
+//ever reads the newest one and the render owned parts of World
+struct Simulation
+{
+    World* world = nullptr;
+
+    float stepRate = 120.0f;    //steps per second, the thread sleeps the rest
+    float maxStep = 0.1f;       //dt clamp after a stall
+
+    SpscRing<SimInput, 64>       input;     //main pushes, sim pops
+    SpscRing<SimEvent, 64>       events;
+    TripleBuffer<RenderSnapshot> snapshots; //sim publishes, main acquires
+
+    double time = 0.0;          //SimClock the world has been stepped to, sim thread only
+
+    std::atomic<bool> running{ false };
+    std::thread       thread;
+
+    std::atomic<unsigned long long> steps{ 0 };
+    std::atomic<unsigned long long> unseen{ 0 };    //published and replaced before a frame took them
+    unsigned long long frames = 0;
+    unsigned long long repeated = 0;                //frames that found no new snapshot
+};
+
+//publishes the first snapshot before the thread starts, so the render thread
+//always has one
+void StartSimulation(Simulation& sim, World& world);
+void SubmitSimInput(Simulation& sim, const SimInput& input);
+void SubmitSimEvent(Simulation& sim, const SimEvent& ev);
+
+//newest published snapshot, the previous one again when the simulation has
+//not stepped since; valid until the next call
+const RenderSnapshot& AcquireSnapshot(Simulation& sim);
+void StopSimulation(Simulation& sim);
@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include "Solver.h"
+
+void PrepareBallContacts(BallSolver& solver, std::vector<Sphere>& balls)
+{
+    //last step's contacts become the cache, both lists are sorted by key
+    solver.previous.swap(solver.contacts);
+    solver.contacts.clear();
+
+    size_t cached = 0;
+    for (int i = 0; i < (int)balls.size(); ++i)
+    {
+        for (int j = i + 1; j < (int)balls.size(); ++j)
+        {
+            Sphere& A = balls[i];
+            Sphere& B = balls[j];
+
+            glm::vec3 diff = B.pos - A.pos;
+            float dist2 = glm::dot(diff, diff);
+            float minDist = A.radius + B.radius;
+            if (dist2 >= minDist * minDist) continue;
+
+            float dist = std::sqrt(dist2);
+            if (dist < 0.0001f) dist = 0.0001f;
+
+            BallContact c;
+            c.key = ((unsigned int)i << 16) | (unsigned int)j;
+            c.a = i;
+            c.b = j;
+            c.normal = diff / dist;
+            c.massNormal = 1.0f / (1.0f / A.mass + 1.0f / B.mass);
+            c.impulse = 0.0f;
+
+            //bounce from the approach speed before any impulse this step
+            float vN = glm::dot(B.vel - A.vel, c.normal);
+            c.bias = (vN < -solver.restitutionThreshold) ? -solver.restitution * vN : 0.0f;
+
+            //merge walk, keys only grow in both lists
+            while (cached < solver.previous.size() && solver.previous[cached].key < c.key)
+                cached++;
+            if (cached < solver.previous.size() && solver.previous[cached].key == c.key)
+            {
+                c.impulse = solver.previous[cached].impulse;
+                glm::vec3 P = c.normal * c.impulse;
+                A.vel -= P / A.mass;
+                B.vel += P / B.mass;
+                solver.warmStarted++;
+            }
+
+            solver.contacts.push_back(c);
+        }
+    }
+}
+
+float SolveBallContacts(BallSolver& solver, std::vector<Sphere>& balls, float& penetration)
+{
+    float maxDelta = 0.0f;
+
+    //velocities, the accumulated impulse is clamped rather than each step of it
+    for (auto& c : solver.contacts)
+    {
+        Sphere& A = balls[c.a];
+        Sphere& B = balls[c.b];
+
+        float vN = glm::dot(B.vel - A.vel, c.normal);
+        float newImpulse = std::max(c.impulse + c.massNormal * (c.bias - vN), 0.0f);
+        float delta = newImpulse - c.impulse;
+        c.impulse = newImpulse;
+
+        glm::vec3 P = c.normal * delta;
+        A.vel -= P / A.mass;
+        B.vel += P / B.mass;
+
+        maxDelta = std::max(maxDelta, std::fabs(delta));
+    }
+
+    //positions, projected apart from the current overlap like ResolveSphereSphere
+    for (auto& c : solver.contacts)
+    {
+        Sphere& A = balls[c.a];
+        Sphere& B = balls[c.b];
+
+        glm::vec3 diff = B.pos - A.pos;
+        float dist2 = glm::dot(diff, diff);
+        float minDist = A.radius + B.radius;
+        if (dist2 >= minDist * minDist) continue;
+
+        float dist = std::sqrt(dist2);
+        if (dist < 0.0001f) dist = 0.0001f;
+
+        glm::vec3 normal = diff / dist;
+        float overlap = minDist - dist;
+
+        A.pos -= normal * (overlap * 0.5f);
+        B.pos += normal * (overlap * 0.5f);
+        penetration = std::max(penetration, overlap);
+    }
+
+    return maxDelta;
+}
+
+bool BallSolveConverged(const BallSolver& solver, float impulseDelta, float penetration)
+{
+    return penetration < solver.penetrationTolerance && impulseDelta < solver.impulseTolerance;
+}
+
+void FinishBallContacts(BallSolver& solver, std::vector<Sphere>& balls, int iterations)
+{
+    //one event per touching pair and step, the impact audio drops resting ones by impulse
+    for (const auto& c : solver.contacts)
+    {
+        const Sphere& A = balls[c.a];
+        ReportContact(A.pos + c.normal * A.radius, c.impulse, CONTACT_BALL + c.a, CONTACT_BALL + c.b);
+    }
+
+    solver.lastIterations = iterations;
+    solver.steps++;
+    solver.iterationSum += iterations;
+    solver.contactSum += solver.contacts.size();
+    solver.histogram[std::min(iterations, (int)BALL_SOLVER_MAX_ITERATIONS)]++;
+}
+
+void PrintSolverStats(const BallSolver& solver)
+{
+    if (!solver.steps) return;
+
+    double steps = (double)solver.steps;
+    std::cout << "Solver: " << solver.iterationSum / steps << " iterations avg (limit " << solver.maxIterations << "), "
+        << solver.contactSum / steps << " ball contacts avg, "
+        << (solver.contactSum ? 100.0 * solver.warmStarted / solver.contactSum : 0.0) << "% warm started\n";
+
+    std::cout << "Solver iterations:";
+    for (int i = 1; i <= BALL_SOLVER_MAX_ITERATIONS; ++i)
+        if (solver.histogram[i])
+            std::cout << " " << i << "x" << solver.histogram[i];
+    std::cout << "\n";
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "Physics.h"
+
+//sequential impulse solver for ball pairs. Contacts persist across steps by
+//pair key, last step's accumulated impulse is applied up front (warm start)
+//and the caller stops iterating once penetration and impulse change are
+//both under tolerance, so a resting pit settles in one or two passes
+struct BallContact
+{
+    unsigned int key;       //a << 16 | b with a < b, contacts are built sorted by it
+    int          a, b;
+    glm::vec3    normal;    //a towards b
+    float        massNormal;
+    float        bias;      //separating speed restitution asks for
+    float        impulse;   //accumulated, never negative
+};
+
+enum { BALL_SOLVER_MAX_ITERATIONS = 16 };
+
+struct BallSolver
+{
+    int   maxIterations = 8;
+    float penetrationTolerance = 0.005f;    //metres
+    float impulseTolerance = 0.01f;         //largest impulse change in one pass
+    float restitution = 0.4f;
+    float restitutionThreshold = 0.2f;      //slower closing speeds do not bounce, resting balls stay put
+
+    std::vector<BallContact> contacts;
+    std::vector<BallContact> previous;      //last step's, for the warm start
+
+    //stats
+    int lastIterations = 0;
+    unsigned long long steps = 0;
+    unsigned long long iterationSum = 0;
+    unsigned long long contactSum = 0;
+    unsigned long long warmStarted = 0;
+    unsigned long long histogram[BALL_SOLVER_MAX_ITERATIONS + 1] = {};
+};
+
+//finds the touching pairs and applies their cached impulses
+void PrepareBallContacts(BallSolver& solver, std::vector<Sphere>& balls);
+
+//one velocity and one position pass over the contacts; returns the largest
+//impulse change and raises penetration to the deepest overlap it corrected
+float SolveBallContacts(BallSolver& solver, std::vector<Sphere>& balls, float& penetration);
+
+bool BallSolveConverged(const BallSolver& solver, float impulseDelta, float penetration);
+
+//reports impacts, keeps the impulses for the next step's warm start
+void FinishBallContacts(BallSolver& solver, std::vector<Sphere>& balls, int iterations);
+void PrintSolverStats(const BallSolver& solver);
@@ -0,0 +1,43 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+//single producer / single consumer ring, neither side ever blocks or allocates;
+//Capacity must be a power of two
+template <typename T, size_t Capacity>
+class SpscRing
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+    //producer side, false when full so the caller can drop the item
+    bool Push(const T& item)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) >= Capacity)
+            return false;
+
+        items_[head & (Capacity - 1)] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    //consumer side
+    bool Pop(T& item)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire))
+            return false;
+
+        item = items_[tail & (Capacity - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T items_[Capacity];
+
+    //own cache lines so the two threads do not false share
+    alignas(64) std::atomic<size_t> head_{ 0 };
+    alignas(64) std::atomic<size_t> tail_{ 0 };
+};
@@ -0,0 +1,219 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include "TaskGraph.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct ContextCall
+{
+    const std::function<void()>* fn;
+    bool done;
+};
+
+//one graph runs at a time, RunOnContextThread has to find it without a handle
+static std::mutex              graphLock;
+static std::condition_variable graphChanged;
+static TaskGraph*              running = nullptr;
+static std::thread::id         contextThread;
+static Clock::time_point       graphStart;
+static std::deque<int>         readyWorker, readyContext;
+static std::deque<ContextCall*> contextCalls;
+static int                     remaining = 0;
+
+//for RunOnContextThread to charge its wait to the calling task
+static thread_local Task* currentTask = nullptr;
+
+static double Elapsed()
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - graphStart).count();
+}
+
+int AddTask(TaskGraph& graph, const char* name, TaskThread thread, std::function<void()> run,
+    std::initializer_list<int> dependsOn)
+{
+    int index = (int)graph.tasks.size();
+
+    Task task;
+    task.name = name;
+    task.thread = thread;
+    task.run = std::move(run);
+    graph.tasks.push_back(std::move(task));
+
+    for (int dep : dependsOn)
+    {
+        graph.tasks[dep].dependents.push_back(index);
+        graph.tasks[index].waitingOn++;
+    }
+    return index;
+}
+
+//called with graphLock held
+static void Ready(TaskGraph& graph, int index)
+{
+    if (graph.tasks[index].thread == TASK_CONTEXT)
+        readyContext.push_back(index);
+    else
+        readyWorker.push_back(index);
+}
+
+static void RunTask(TaskGraph& graph, int index)
+{
+    Task& task = graph.tasks[index];
+    currentTask = &task;
+    task.startMs = Elapsed();
+    task.run();
+    task.endMs = Elapsed();
+    currentTask = nullptr;
+
+    std::lock_guard<std::mutex> lock(graphLock);
+    for (int next : task.dependents)
+    {
+        if (--graph.tasks[next].waitingOn == 0)
+            Ready(graph, next);
+    }
+    remaining--;
+    graphChanged.notify_all();
+}
+
+static void WorkerLoop(TaskGraph* graph)
+{
+    for (;;)
+    {
+        int index;
+        {
+            std::unique_lock<std::mutex> lock(graphLock);
+            graphChanged.wait(lock, [] { return !readyWorker.empty() || remaining == 0; });
+            if (readyWorker.empty()) return;
+            index = readyWorker.front();
+            readyWorker.pop_front();
+        }
+        RunTask(*graph, index);
+    }
+}
+
+void RunTaskGraph(TaskGraph& graph, int workers)
+{
+    if (workers <= 0)
+        workers = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+    graph.workers = workers;
+
+    {
+        std::lock_guard<std::mutex> lock(graphLock);
+        running = &graph;
+        contextThread = std::this_thread::get_id();
+        graphStart = Clock::now();
+        remaining = (int)graph.tasks.size();
+        for (int i = 0; i < (int)graph.tasks.size(); ++i)
+        {
+            if (graph.tasks[i].waitingOn == 0)
+                Ready(graph, i);
+        }
+    }
+
+    std::vector<std::thread> pool;
+    for (int i = 0; i < workers; ++i)
+        pool.emplace_back(WorkerLoop, &graph);
+
+    //the context thread runs its own tasks and the workers' GL calls, calls
+    //first since a worker is blocked on each of them
+    for (;;)
+    {
+        ContextCall* call = nullptr;
+        int index = -1;
+        {
+            std::unique_lock<std::mutex> lock(graphLock);
+            graphChanged.wait(lock, []
+                {
+                    return !contextCalls.empty() || !readyContext.empty() || remaining == 0;
+                });
+            if (!contextCalls.empty())
+            {
+                call = contextCalls.front();
+                contextCalls.pop_front();
+            }
+            else if (!readyContext.empty())
+            {
+                index = readyContext.front();
+                readyContext.pop_front();
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        if (call)
+        {
+            (*call->fn)();
+            std::lock_guard<std::mutex> lock(graphLock);
+            call->done = true;
+            graph.contextCalls++;
+            graphChanged.notify_all();
+        }
+        else
+        {
+            RunTask(graph, index);
+        }
+    }
+
+    for (std::thread& t : pool)
+        t.join();
+
+    std::lock_guard<std::mutex> lock(graphLock);
+    graph.wallMs = Elapsed();
+    running = nullptr;
+}
+
+void RunOnContextThread(const std::function<void()>& fn)
+{
+    std::unique_lock<std::mutex> lock(graphLock);
+    if (!running || std::this_thread::get_id() == contextThread)
+    {
+        lock.unlock();
+        fn();
+        return;
+    }
+
+    double start = Elapsed();
+    ContextCall call = { &fn, false };
+    contextCalls.push_back(&call);
+    graphChanged.notify_all();
+    graphChanged.wait(lock, [&call] { return call.done; });
+
+    if (currentTask)
+        currentTask->contextMs += Elapsed() - start;
+}
+
+void PrintTaskTimings(const TaskGraph& graph)
+{
+    double serial = 0.0;
+    for (const Task& task : graph.tasks)
+        serial += task.endMs - task.startMs;
+
+    std::cout << "Startup: " << graph.tasks.size() << " tasks on " << graph.workers << " workers + context, "
+        << (int)graph.wallMs << " ms (" << (int)serial << " ms summed over tasks), "
+        << graph.contextCalls << " GL calls marshalled\n";
+
+    //in start order, reads like a timeline
+    std::vector<const Task*> order;
+    for (const Task& task : graph.tasks)
+        order.push_back(&task);
+    std::sort(order.begin(), order.end(), [](const Task* a, const Task* b) { return a->startMs < b->startMs; });
+
+    for (const Task* task : order)
+    {
+        char line[160];
+        std::snprintf(line, sizeof(line), "  %-18s %-7s %7.1f +%7.1f ms", task->name,
+            task->thread == TASK_CONTEXT ? "context" : "worker", task->startMs, task->endMs - task->startMs);
+        std::cout << line;
+        if (task->contextMs > 0.0)
+            std::cout << " (" << (int)task->contextMs << " ms on GL calls)";
+        std::cout << "\n";
+    }
+}
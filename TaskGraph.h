@@ -0,0 +1,53 @@
+#pragma once
+#include <functional>
+#include <initializer_list>
+#include <vector>
+
+//startup work as a dependency graph: worker tasks run on a small thread pool,
+//context tasks on the thread that owns the GL context, which also services
+//the GL calls workers hand over through RunOnContextThread
+
+enum TaskThread
+{
+    TASK_WORKER = 0,    //file I/O, parsing, decoding, procedural generation
+    TASK_CONTEXT        //anything that touches GL
+};
+
+struct Task
+{
+    const char*           name = "";
+    TaskThread            thread = TASK_WORKER;
+    std::function<void()> run;
+    std::vector<int>      dependents;
+    int                   waitingOn = 0;    //unfinished dependencies
+
+    //milliseconds from the start of RunTaskGraph
+    double startMs = 0.0;
+    double endMs = 0.0;
+    double contextMs = 0.0;     //part of it spent waiting on marshalled GL calls
+};
+
+struct TaskGraph
+{
+    std::vector<Task> tasks;
+
+    int    workers = 0;
+    double wallMs = 0.0;
+    int    contextCalls = 0;    //marshalled from workers
+};
+
+//returns the task index for later dependencies, every dependency has to be
+//added before the tasks that wait on it
+int  AddTask(TaskGraph& graph, const char* name, TaskThread thread, std::function<void()> run,
+    std::initializer_list<int> dependsOn = {});
+
+//runs everything, the caller has to be the context thread; workers <= 0
+//sizes the pool from the hardware
+void RunTaskGraph(TaskGraph& graph, int workers = 0);
+
+//per task start, duration and thread, then the wall time against the serial sum
+void PrintTaskTimings(const TaskGraph& graph);
+
+//runs fn on the context thread and waits for it; inline when called from
+//that thread or while no graph is running
+void RunOnContextThread(const std::function<void()>& fn);
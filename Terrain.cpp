@@ -0,0 +1,242 @@
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <algorithm>
+#include <glad.h>
+#include "Terrain.h"
+
+//heightfield the physics queries go to
+static const Terrain* groundTerrain = nullptr;
+
+//procedural hills, flat inside the play area and rising towards the boulder ring
+static float ProceduralHeight(float x, float z)
+{
+    float r = std::sqrt(x * x + z * z);
+    float t = glm::clamp((r - 18.0f) / (45.0f - 18.0f), 0.0f, 1.0f);
+    float mask = t * t * (3.0f - 2.0f * t);
+
+    float h = 2.5f * std::sin(x * 0.07f) * std::cos(z * 0.06f)
+        + 1.2f * std::sin(x * 0.17f + 1.3f) * std::sin(z * 0.13f + 0.7f)
+        + 0.5f * std::sin((x + z) * 0.31f)
+        + 3.0f;
+
+    return mask * h;
+}
+
+static void BuildPatch(Terrain& terrain)
+{
+    const int n = terrain.patchGrid;
+    const int half = n / 2;
+
+    std::vector<glm::vec2> verts;
+    verts.reserve((n + 1) * (n + 1));
+    for (int z = 0; z <= n; ++z)
+        for (int x = 0; x <= n; ++x)
+            verts.push_back(glm::vec2(float(x) / n, float(z) / n));
+
+    //indices grouped by quadrant so a partially selected node can draw a quarter
+    std::vector<unsigned int> idx;
+    idx.reserve(n * n * 6);
+    for (int q = 0; q < 4; ++q)
+    {
+        int x0 = (q & 1) ? half : 0;
+        int z0 = (q & 2) ? half : 0;
+
+        for (int z = z0; z < z0 + half; ++z)
+        {
+            for (int x = x0; x < x0 + half; ++x)
+            {
+                unsigned int i0 = z * (n + 1) + x;
+                unsigned int i1 = i0 + n + 1;
+
+                idx.push_back(i0);
+                idx.push_back(i1);
+                idx.push_back(i0 + 1);
+
+                idx.push_back(i0 + 1);
+                idx.push_back(i1);
+                idx.push_back(i1 + 1);
+            }
+        }
+    }
+
+    terrain.patchIndexCount = (int)idx.size();
+
+    glGenVertexArrays(1, &terrain.patchVAO);
+    glGenBuffers(1, &terrain.patchVBO);
+    glGenBuffers(1, &terrain.patchEBO);
+
+    glBindVertexArray(terrain.patchVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, terrain.patchVBO);
+    glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(glm::vec2), verts.data(), GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, terrain.patchEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size() * sizeof(unsigned int), idx.data(), GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glBindVertexArray(0);
+}
+
+void GenerateTerrain(Terrain& terrain)
+{
+    const int   res = terrain.heightRes;
+    const float cell = terrain.worldSize / (res - 1);
+    const float origin = -terrain.worldSize * 0.5f;
+
+    terrain.heights.resize(res * res);
+    terrain.minHeight = 1e9f;
+    terrain.maxHeight = -1e9f;
+
+    for (int z = 0; z < res; ++z)
+    {
+        for (int x = 0; x < res; ++x)
+        {
+            float h = ProceduralHeight(origin + x * cell, origin + z * cell);
+            terrain.heights[z * res + x] = h;
+            terrain.minHeight = std::min(terrain.minHeight, h);
+            terrain.maxHeight = std::max(terrain.maxHeight, h);
+        }
+    }
+
+    terrain.lodRanges.resize(terrain.lodCount);
+    for (int i = 0; i < terrain.lodCount; ++i)
+        terrain.lodRanges[i] = terrain.lodRange0 * float(1 << i);
+
+    groundTerrain = &terrain;
+}
+
+void UploadTerrain(Terrain& terrain)
+{
+    const int res = terrain.heightRes;
+
+    //linear filtering on texel centres gives the same bilinear result as TerrainHeight
+    glGenTextures(1, &terrain.heightTex);
+    glBindTexture(GL_TEXTURE_2D, terrain.heightTex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, res, res, 0, GL_RED, GL_FLOAT, terrain.heights.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    BuildPatch(terrain);
+}
+
+float TerrainHeight(float x, float z)
+{
+    if (!groundTerrain || groundTerrain->heights.empty()) return 0.0f;
+
+    const Terrain& t = *groundTerrain;
+    const int   res = t.heightRes;
+    const float cell = t.worldSize / (res - 1);
+
+    float fx = glm::clamp((x + t.worldSize * 0.5f) / cell, 0.0f, float(res - 1));
+    float fz = glm::clamp((z + t.worldSize * 0.5f) / cell, 0.0f, float(res - 1));
+
+    int x0 = std::min((int)fx, res - 2);
+    int z0 = std::min((int)fz, res - 2);
+    float tx = fx - x0;
+    float tz = fz - z0;
+
+    const float* row0 = &t.heights[z0 * res];
+    const float* row1 = row0 + res;
+
+    float h0 = row0[x0] + (row0[x0 + 1] - row0[x0]) * tx;
+    float h1 = row1[x0] + (row1[x0 + 1] - row1[x0]) * tx;
+    return h0 + (h1 - h0) * tz;
+}
+
+glm::vec3 TerrainNormal(float x, float z)
+{
+    const float e = groundTerrain ? groundTerrain->worldSize / (groundTerrain->heightRes - 1) : 1.0f;
+
+    float hL = TerrainHeight(x - e, z);
+    float hR = TerrainHeight(x + e, z);
+    float hD = TerrainHeight(x, z - e);
+    float hU = TerrainHeight(x, z + e);
+
+    return glm::normalize(glm::vec3(hL - hR, 2.0f * e, hD - hU));
+}
+
+//true when any part of the node lies within range of the eye
+static bool NodeInRange(const Terrain& terrain, const glm::vec2& origin, float size,
+    const glm::vec3& eye, float range)
+{
+    glm::vec3 minB(origin.x, terrain.minHeight, origin.y);
+    glm::vec3 maxB(origin.x + size, terrain.maxHeight, origin.y + size);
+
+    glm::vec3 closest = glm::clamp(eye, minB, maxB);
+    glm::vec3 diff = eye - closest;
+    return glm::dot(diff, diff) <= range * range;
+}
+
+static bool SelectNode(Terrain& terrain, const glm::vec2& origin, float size, int lod, const glm::vec3& eye)
+{
+    //out of this level's range, the parent covers it
+    if (!NodeInRange(terrain, origin, size, eye, terrain.lodRanges[lod]))
+        return false;
+
+    if (lod == 0 || !NodeInRange(terrain, origin, size, eye, terrain.lodRanges[lod - 1]))
+    {
+        terrain.selected.push_back({ origin, size, lod, -1 });
+        return true;
+    }
+
+    float half = size * 0.5f;
+    for (int q = 0; q < 4; ++q)
+    {
+        glm::vec2 childOrigin = origin + glm::vec2((q & 1) ? half : 0.0f, (q & 2) ? half : 0.0f);
+
+        //child too far for the finer level, draw that quarter at this level instead
+        if (!SelectNode(terrain, childOrigin, half, lod - 1, eye))
+            terrain.selected.push_back({ origin, size, lod, q });
+    }
+    return true;
+}
+
+void SelectTerrainNodes(Terrain& terrain, const glm::vec3& eye)
+{
+    terrain.selected.clear();
+
+    glm::vec2 rootOrigin(-terrain.worldSize * 0.5f);
+    if (!SelectNode(terrain, rootOrigin, terrain.worldSize, terrain.lodCount - 1, eye))
+        terrain.selected.push_back({ rootOrigin, terrain.worldSize, terrain.lodCount - 1, -1 });
+}
+
+void DrawTerrain(const Terrain& terrain, Shader& shader, const glm::vec3& eye)
+{
+    shader.setInt("heightMap", 3);
+    shader.setFloat("terrainSize", terrain.worldSize);
+    shader.setFloat("heightRes", (float)terrain.heightRes);
+    shader.setFloat("gridDim", (float)terrain.patchGrid);
+    shader.setVec3("eyePos", eye);
+
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D, terrain.heightTex);
+
+    glBindVertexArray(terrain.patchVAO);
+
+    const int quarterCount = terrain.patchIndexCount / 4;
+    for (const auto& node : terrain.selected)
+    {
+        float range = terrain.lodRanges[node.lod];
+
+        shader.setVec2("nodeOrigin", node.origin);
+        shader.setFloat("nodeSize", node.size);
+        shader.setVec2("morphRange", range * terrain.morphStart, range);
+
+        if (node.quadrant < 0)
+        {
+            glDrawElements(GL_TRIANGLES, terrain.patchIndexCount, GL_UNSIGNED_INT, 0);
+        }
+        else
+        {
+            size_t offset = (size_t)node.quadrant * quarterCount * sizeof(unsigned int);
+            glDrawElements(GL_TRIANGLES, quarterCount, GL_UNSIGNED_INT, (void*)offset);
+        }
+    }
+
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "shader_m.h"
+
+//one selected quadtree node, quadrant -1 means the whole patch
+struct TerrainNode
+{
+    glm::vec2 origin;
+    float     size;
+    int       lod;
+    int       quadrant;
+};
+
+struct Terrain
+{
+    //heightfield covering [-worldSize/2, worldSize/2] on X and Z
+    float worldSize = 200.0f;
+    int   heightRes = 257;
+    std::vector<float> heights;
+    float minHeight = 0.0f;
+    float maxHeight = 0.0f;
+
+    //CDLOD patch, every node draws the same grid scaled to its size
+    int   patchGrid = 16;
+    int   lodCount = 5;
+    float lodRange0 = 25.0f;    //doubles for every coarser level
+    float morphStart = 0.75f;   //fraction of a level's range where morphing begins
+    std::vector<float> lodRanges;
+
+    unsigned int heightTex = 0;
+    unsigned int patchVAO = 0, patchVBO = 0, patchEBO = 0;
+    int          patchIndexCount = 0;
+
+    std::vector<TerrainNode> selected;
+};
+
+//heights and LOD ranges only, no GL, so it can run off the context thread;
+//UploadTerrain then creates the height texture and the patch buffers
+void GenerateTerrain(Terrain& terrain);
+void UploadTerrain(Terrain& terrain);
+void SelectTerrainNodes(Terrain& terrain, const glm::vec3& eye);
+void DrawTerrain(const Terrain& terrain, Shader& shader, const glm::vec3& eye);
+
+//CPU height queries, bilinear over the same samples the GPU reads
+float     TerrainHeight(float x, float z);
+glm::vec3 TerrainNormal(float x, float z);
@@ -0,0 +1,425 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glad.h>
+#include <stb_image.h>
+#include "Textures.h"
+#include "AssetPack.h"
+#include "DdsFormat.h"
+#include "TaskGraph.h"
+
+//GL_EXT_texture_compression_s3tc, not in the core loader
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+static TextureStats stats;
+
+struct TextureUpload
+{
+    size_t gpuBytes = 0;
+    size_t uncompressedBytes = 0;
+};
+
+struct DecodedImage
+{
+    unsigned char* pixels = nullptr;
+    int    width = 0, height = 0;
+    GLenum format = GL_RGB, internal = GL_RGB8;
+};
+
+static bool HasS3tc()
+{
+    static int has = -1;
+    if (has < 0)
+    {
+        has = 0;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count && !has; ++i)
+        {
+            const char* ext = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            has = ext && std::strcmp(ext, "GL_EXT_texture_compression_s3tc") == 0;
+        }
+    }
+    return has != 0;
+}
+
+static void SetSamplerParams()
+{
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+static size_t ChainBytesRGBA8(unsigned int w, unsigned int h, unsigned int levels)
+{
+    size_t bytes = 0;
+    for (unsigned int i = 0; i < levels; ++i)
+    {
+        bytes += (size_t)w * h * 4;
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+    return bytes;
+}
+
+static unsigned int FullMipCount(unsigned int w, unsigned int h)
+{
+    unsigned int levels = 1;
+    while (w > 1 || h > 1)
+    {
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+        ++levels;
+    }
+    return levels;
+}
+
+//BC7 is core since 4.2, BC1/BC3 need the S3TC extension
+static bool DdsFormatToGL(const DdsHeader& header, const DdsHeaderDx10* dx10, GLenum& format, size_t& blockBytes)
+{
+    uint32_t fourCC = header.format.fourCC;
+    uint32_t dxgi = dx10 ? dx10->dxgiFormat : 0;
+
+    if (fourCC == DDS_FOURCC_DXT1 || dxgi == DXGI_FORMAT_BC1_UNORM)
+    {
+        format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+        blockBytes = 8;
+        return HasS3tc();
+    }
+    if (fourCC == DDS_FOURCC_DXT5 || dxgi == DXGI_FORMAT_BC3_UNORM)
+    {
+        format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        blockBytes = 16;
+        return HasS3tc();
+    }
+    if (dxgi == DXGI_FORMAT_BC7_UNORM)
+    {
+        format = GL_COMPRESSED_RGBA_BPTC_UNORM;
+        blockBytes = 16;
+        return true;
+    }
+    return false;
+}
+
+//the asset stays mapped while this uploads straight from it
+static unsigned int LoadDds(const AssetData& asset, TextureUpload& upload)
+{
+    const unsigned char* p = asset.data;
+    const unsigned char* end = asset.data + asset.size;
+
+    uint32_t magic;
+    DdsHeader header;
+    if (asset.size < 4 + sizeof(header))
+        return 0;
+    std::memcpy(&magic, p, 4);
+    std::memcpy(&header, p + 4, sizeof(header));
+    p += 4 + sizeof(header);
+
+    DdsHeaderDx10 dx10;
+    bool hasDx10 = header.format.fourCC == DDS_FOURCC_DX10;
+    if (hasDx10)
+    {
+        if ((size_t)(end - p) < sizeof(dx10))
+            return 0;
+        std::memcpy(&dx10, p, sizeof(dx10));
+        p += sizeof(dx10);
+    }
+
+    GLenum format;
+    size_t blockBytes;
+    if (magic != DDS_MAGIC || header.size != sizeof(DdsHeader) || header.width == 0 || header.height == 0 ||
+        !DdsFormatToGL(header, hasDx10 ? &dx10 : nullptr, format, blockBytes))
+        return 0;
+
+    unsigned int levels = (header.flags & DDSD_MIPMAPCOUNT) && header.mipMapCount ? header.mipMapCount : 1;
+    levels = std::min(levels, FullMipCount(header.width, header.height));
+
+    unsigned int tex;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+
+    unsigned int w = header.width, h = header.height;
+    size_t uploaded = 0;
+    unsigned int level = 0;
+    for (; level < levels; ++level)
+    {
+        size_t size = (size_t)((w + 3) / 4) * ((h + 3) / 4) * blockBytes;
+        if ((size_t)(end - p) < size) break;
+
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, format, w, h, 0, (GLsizei)size, p);
+        p += size;
+        uploaded += size;
+
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+
+    if (level == 0)
+    {
+        glDeleteTextures(1, &tex);
+        return 0;
+    }
+
+    //a truncated chain still samples, just without the missing small levels
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+    SetSamplerParams();
+
+    upload.gpuBytes = uploaded;
+    upload.uncompressedBytes = ChainBytesRGBA8(header.width, header.height, level);
+    return tex;
+}
+
+//stb decode, no GL, so it runs on whichever thread is loading
+static bool DecodeImage(const AssetData& asset, DecodedImage& image)
+{
+    int ch;
+    image.pixels = stbi_load_from_memory(asset.data, (int)asset.size, &image.width, &image.height, &ch, 0);
+    if (!image.pixels) return false;
+
+    //sized internal formats, the material arrays copy these level by level
+    image.format = GL_RGB;
+    image.internal = GL_RGB8;
+    if (ch == 1)
+    {
+        image.format = GL_RED;
+        image.internal = GL_R8;
+    }
+    else if (ch == 4)
+    {
+        image.format = GL_RGBA;
+        image.internal = GL_RGBA8;
+    }
+    else if (ch == 2)
+    {
+        //grey + alpha has no GL pixel format of its own
+        stbi_image_free(image.pixels);
+        image.pixels = stbi_load_from_memory(asset.data, (int)asset.size, &image.width, &image.height, &ch, 4);
+        if (!image.pixels) return false;
+        image.format = GL_RGBA;
+        image.internal = GL_RGBA8;
+    }
+    return true;
+}
+
+static unsigned int UploadImage(const DecodedImage& image, TextureUpload& upload)
+{
+    unsigned int tex;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, image.internal, image.width, image.height, 0, image.format, GL_UNSIGNED_BYTE, image.pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    SetSamplerParams();
+
+    upload.gpuBytes = ChainBytesRGBA8(image.width, image.height, FullMipCount(image.width, image.height));
+    upload.uncompressedBytes = upload.gpuBytes;
+    return tex;
+}
+
+//FNV-1a over 8 byte words, the images are megabytes and hashed on every miss
+static uint64_t HashContent(const unsigned char* data, size_t size)
+{
+    uint64_t h = 14695981039346656037ull;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        h = (h ^ word) * 1099511628211ull;
+    }
+    for (; i < size; ++i)
+        h = (h ^ data[i]) * 1099511628211ull;
+    return h;
+}
+
+//identical bytes uploaded the same way give the same texture; the kind
+//stands in for the format (a .dds upload or a decoded image) and the
+//sampler for the SetSamplerParams state
+struct TextureKey
+{
+    uint64_t hash;
+    size_t   size;
+    uint32_t kind;
+    uint32_t sampler;
+
+    bool operator==(const TextureKey& o) const
+    {
+        return hash == o.hash && size == o.size && kind == o.kind && sampler == o.sampler;
+    }
+};
+
+struct TextureKeyHash
+{
+    size_t operator()(const TextureKey& k) const
+    {
+        return (size_t)(k.hash ^ (k.size * 0x9E3779B97F4A7C15ull) ^ ((uint64_t)k.kind << 32) ^ k.sampler);
+    }
+};
+
+enum { TEXTURE_KIND_IMAGE = 0, TEXTURE_KIND_DDS = 1 };
+enum { TEXTURE_SAMPLER_REPEAT_TRILINEAR = 0 };
+
+struct CachedTexture
+{
+    TextureKey key;
+    int        refs = 0;
+    bool       compressed = false;
+    size_t     gpuBytes = 0;
+    size_t     uncompressedBytes = 0;
+    std::vector<std::string> paths;     //path cache entries pointing here
+};
+
+//loads can come from startup workers, the GL side goes through
+//RunOnContextThread and everything below is guarded by cacheLock
+static std::mutex cacheLock;
+static std::unordered_map<TextureKey, unsigned int, TextureKeyHash> byContent;
+static std::unordered_map<std::string, unsigned int> byPath;
+static std::unordered_map<unsigned int, CachedTexture> cache;
+
+//called with cacheLock held
+static unsigned int CacheHit(unsigned int tex)
+{
+    CachedTexture& entry = cache[tex];
+    entry.refs++;
+    stats.cacheHits++;
+    stats.bytesSaved += entry.gpuBytes;
+    return tex;
+}
+
+//called with cacheLock held
+static unsigned int AddPath(unsigned int tex, const std::string& name)
+{
+    byPath[name] = tex;
+    cache[tex].paths.push_back(name);
+    return CacheHit(tex);
+}
+
+//one file that may be uploaded, the bytes hashed are the bytes used
+static unsigned int LoadCandidate(const char* file, uint32_t kind, const std::string& name)
+{
+    AssetData asset;
+    if (!OpenAsset(file, asset)) return 0;
+
+    TextureKey key = { HashContent(asset.data, asset.size), asset.size, kind, TEXTURE_SAMPLER_REPEAT_TRILINEAR };
+    {
+        std::lock_guard<std::mutex> lock(cacheLock);
+        auto same = byContent.find(key);
+        if (same != byContent.end())
+        {
+            CloseAsset(asset);
+            return AddPath(same->second, name);
+        }
+    }
+
+    //decode here, only the upload needs the context
+    unsigned int tex = 0;
+    TextureUpload upload;
+    if (kind == TEXTURE_KIND_DDS)
+    {
+        RunOnContextThread([&]() { tex = LoadDds(asset, upload); });
+    }
+    else
+    {
+        DecodedImage image;
+        if (DecodeImage(asset, image))
+            RunOnContextThread([&]() { tex = UploadImage(image, upload); });
+        stbi_image_free(image.pixels);
+    }
+    CloseAsset(asset);
+    if (!tex) return 0;
+
+    std::unique_lock<std::mutex> lock(cacheLock);
+
+    //two loaders can race to the same bytes, the first one registered wins
+    auto same = byContent.find(key);
+    if (same != byContent.end())
+    {
+        unsigned int kept = AddPath(same->second, name);
+        lock.unlock();
+        RunOnContextThread([tex]() { glDeleteTextures(1, &tex); });
+        return kept;
+    }
+
+    CachedTexture& entry = cache[tex];
+    entry.key = key;
+    entry.refs = 1;
+    entry.compressed = kind == TEXTURE_KIND_DDS;
+    entry.gpuBytes = upload.gpuBytes;
+    entry.uncompressedBytes = upload.uncompressedBytes;
+    entry.paths.push_back(name);
+    byContent[key] = tex;
+    byPath[name] = tex;
+
+    stats.textures++;
+    if (entry.compressed) stats.compressed++;
+    stats.gpuBytes += entry.gpuBytes;
+    stats.uncompressedBytes += entry.uncompressedBytes;
+    stats.cacheMisses++;
+    return tex;
+}
+
+unsigned int LoadTextureFile(const char* path)
+{
+    //the same path again skips even the hashing
+    std::string name = NormalizeAssetPath(path);
+    {
+        std::lock_guard<std::mutex> lock(cacheLock);
+        auto named = byPath.find(name);
+        if (named != byPath.end())
+            return CacheHit(named->second);
+    }
+
+    std::string dds = path;
+    size_t dot = dds.find_last_of('.');
+    size_t slash = dds.find_last_of("/\\");
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+        dds.erase(dot);
+    dds += ".dds";
+
+    unsigned int tex = 0;
+    if (AssetExists(dds.c_str()))
+    {
+        tex = LoadCandidate(dds.c_str(), TEXTURE_KIND_DDS, name);
+        if (!tex)
+            std::cout << "Can't use " << dds << ", falling back to the source image\n";
+    }
+    if (!tex)
+        tex = LoadCandidate(path, TEXTURE_KIND_IMAGE, name);
+    return tex;
+}
+
+void ReleaseTexture(unsigned int tex)
+{
+    std::unique_lock<std::mutex> lock(cacheLock);
+    auto it = cache.find(tex);
+    if (it == cache.end() || --it->second.refs > 0) return;
+
+    const CachedTexture& entry = it->second;
+    for (const std::string& name : entry.paths)
+        byPath.erase(name);
+    byContent.erase(entry.key);
+
+    stats.textures--;
+    if (entry.compressed) stats.compressed--;
+    stats.gpuBytes -= entry.gpuBytes;
+    stats.uncompressedBytes -= entry.uncompressedBytes;
+
+    cache.erase(it);
+    lock.unlock();
+    RunOnContextThread([tex]() { glDeleteTextures(1, &tex); });
+}
+
+TextureStats GetTextureStats()
+{
+    std::lock_guard<std::mutex> lock(cacheLock);
+    return stats;
+}
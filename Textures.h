@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+
+//texture loading shared by LoadTexture and the models: a block compressed
+//.dds built offline by tools/texconvert (mips included) is preferred, the
+//source image with glGenerateMipmap stays as the fallback; uploads are
+//cached process wide by path and by content, so the same image reached
+//through two paths or two models shares one texture
+
+struct TextureStats
+{
+    int    textures = 0;
+    int    compressed = 0;
+    size_t gpuBytes = 0;            //all mip levels as uploaded
+    size_t uncompressedBytes = 0;   //the same chains as RGBA8
+
+    int    cacheHits = 0;
+    int    cacheMisses = 0;
+    size_t bytesSaved = 0;          //uploads the hits did not repeat
+};
+
+//path names the source image, "media/a/b.png" looks for "media/a/b.dds"
+//first; returns 0 if neither loads. Every successful call holds a
+//reference, released with ReleaseTexture. Safe from startup workers: the
+//file is read and decoded on the calling thread, the upload itself goes
+//through RunOnContextThread
+unsigned int LoadTextureFile(const char* path);
+void ReleaseTexture(unsigned int tex);
+
+TextureStats GetTextureStats();
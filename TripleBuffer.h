@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+
+//single producer / single consumer latest-value mailbox: the producer always
+//has a slot to write, the consumer always has a complete one to read, and
+//neither side ever waits for the other. The middle slot changes hands with
+//one atomic exchange, its FRESH bit says the producer published into it
+//since the consumer last took it
+template <typename T>
+class TripleBuffer
+{
+public:
+    //producer side, fill Back() then Publish()
+    T& Back() { return slots_[back_]; }
+
+    //true when the consumer never saw the slot this replaces
+    bool Publish()
+    {
+        unsigned int old = middle_.exchange(back_ | Fresh, std::memory_order_acq_rel);
+        back_ = old & Index;
+        return (old & Fresh) != 0;
+    }
+
+    //consumer side, false when nothing new was published and Front() is unchanged
+    bool Acquire()
+    {
+        if (!(middle_.load(std::memory_order_relaxed) & Fresh))
+            return false;
+
+        front_ = middle_.exchange(front_, std::memory_order_acq_rel) & Index;
+        return true;
+    }
+
+    const T& Front() const { return slots_[front_]; }
+
+private:
+    static const unsigned int Index = 3;
+    static const unsigned int Fresh = 4;
+
+    T slots_[3];
+
+    //own cache lines so the two threads do not false share
+    alignas(64) unsigned int back_ = 0;
+    alignas(64) std::atomic<unsigned int> middle_{ 1 };
+    alignas(64) unsigned int front_ = 2;
+};
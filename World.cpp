@@ -1,26 +1,36 @@
 ﻿#define _USE_MATH_DEFINES
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <iostream>
 #include <glad.h>
 #include <glm/gtc/matrix_transform.hpp>
 #include "model.h"
 #include "World.h"
-#include "stb_image.h"
+#include "Textures.h"
+#include "TaskGraph.h"
 
 //local helpers
-static float frand(float a, float b)
+static float frand(std::mt19937& rng, float a, float b)
 {
-    return a + (float(std::rand()) / RAND_MAX) * (b - a);
+    return std::uniform_real_distribution<float>(a, b)(rng);
+}
+
+//unindexed triangles into the shared arena
+static GeometryRange AddTriangles(World& world, const std::vector<SceneVertex>& verts)
+{
+    std::vector<unsigned int> idx(verts.size());
+    for (size_t i = 0; i < idx.size(); ++i)
+        idx[i] = (unsigned int)i;
+    return AddGeometry(world.geometry, verts, idx);
 }
 
 void GenerateSphereMesh(World& world, int lat, int lon)
 {
-    struct V { float x, y, z, nx, ny, nz; };
-    std::vector<glm::vec3> tempVerts;
+    std::vector<SceneVertex> verts;
     std::vector<unsigned int> idx;
-    std::vector<V> finalVerts;
 
     for (int y = 0; y <= lat; y++)
     {
@@ -33,7 +43,8 @@ void GenerateSphereMesh(World& world, int lat, int lon)
             float py = std::cos(ys * M_PI);
             float pz = std::sin(xs * 2 * M_PI) * std::sin(ys * M_PI);
 
-            tempVerts.push_back({ px,py,pz });
+            glm::vec3 p(px, py, pz);
+            verts.push_back({ p, glm::normalize(p), glm::vec2(0.0f) });
         }
     }
 
@@ -54,71 +65,122 @@ void GenerateSphereMesh(World& world, int lat, int lon)
         }
     }
 
-    for (unsigned int i : idx)
-    {
-        glm::vec3 p = tempVerts[i];
-        glm::vec3 n = glm::normalize(p);
-        finalVerts.push_back({ p.x,p.y,p.z, n.x,n.y,n.z });
-    }
+    //balls are drawn through the GPU scene, the pillar's sphere reuses the batch
+    int batch = AddSceneMesh(world.scene, verts, idx);
+    world.ballGroup = AddSceneGroup(world.scene, batch, 1);
+    world.sphereMesh = SceneBatchRange(world.scene, batch);
+}
 
-    world.sphereVertCount = (int)finalVerts.size();
+static float DistanceXZ(const glm::vec3& a, const glm::vec3& b)
+{
+    glm::vec2 da(a.x - b.x, a.z - b.z);
+    return glm::length(da);
+}
+static void ResetSkullMode(World& world);
+
+static glm::mat4 GrassMatrix(const GrassInstance& g)
+{
+    glm::mat4 mo(1);
+    mo = glm::translate(mo, g.pos);
+    mo = glm::rotate(mo, glm::radians(g.rot), glm::vec3(0, 1, 0));
+    mo = glm::scale(mo, glm::vec3(g.scale));
+    return mo;
+}
+
+static glm::mat4 RoachMatrix(const CockroachInstance& rInst)
+{
+    const float roachScale = 0.5f;
 
-    glGenVertexArrays(1, &world.sphereVAO);
-    glGenBuffers(1, &world.sphereVBO);
+    glm::mat4 mo(1.0f);
+    mo = glm::translate(mo, rInst.pos);
 
-    glBindVertexArray(world.sphereVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, world.sphereVBO);
-    glBufferData(GL_ARRAY_BUFFER, finalVerts.size() * sizeof(V), finalVerts.data(), GL_STATIC_DRAW);
+    if (rInst.dancing)
+    {
+        float t = rInst.time;
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(V), (void*)0);
-    glEnableVertexAttribArray(0);
+        float hopBase = 1.6f;
+        float hopHeight = 0.4f * std::sin(t * 12.0f);
+        mo = glm::translate(mo, glm::vec3(0.0f, hopBase + hopHeight, 0.0f));
 
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(V), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+        mo = glm::rotate(mo, glm::radians(-80.0f), glm::vec3(1, 0, 0));
+        mo = glm::rotate(mo, glm::radians(20.0f), glm::vec3(0, 0, 1));
+        mo = glm::rotate(mo, t * 8.0f, glm::vec3(0, 0, 1));
+    }
+
+    return glm::scale(mo, glm::vec3(roachScale));
 }
 
-void GeneratePlane(World& world)
+static glm::mat4 SkullMatrix(const SkullInstance& sInst)
 {
-    float verts[] = {
-        -1,0,-1,   0,1,0,    0,  0,
-         1,0,-1,   0,1,0,    100,0,
-         1,0, 1,   0,1,0,    100,100,
+    const float skullScale = 0.6f;
+
+    glm::mat4 mo(1.0f);
+    mo = glm::translate(mo, sInst.pos);
 
-        -1,0,-1,   0,1,0,    0,  0,
-         1,0, 1,   0,1,0,    100,100,
-        -1,0, 1,   0,1,0,    0, 100
-    };
+    //face towards movement direction
+    glm::vec3 dir = glm::normalize(sInst.vel);
+    if (glm::length(dir) > 0.0001f)
+    {
+        float yaw = std::atan2(dir.x, dir.z);
+        mo = glm::rotate(mo, yaw, glm::vec3(0, 1, 0));
+    }
 
-    glGenVertexArrays(1, &world.planeVAO);
-    glGenBuffers(1, &world.planeVBO);
+    return glm::scale(mo, glm::vec3(skullScale));
+}
 
-    glBindVertexArray(world.planeVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, world.planeVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);
+//first diffuse map of a model mesh, 0 if it has none
+static unsigned int DiffuseTexture(const Mesh& mesh)
+{
+    for (const auto& tex : mesh.textures)
+    {
+        if (tex.type == "texture_diffuse")
+            return tex.id;
+    }
+    return 0;
+}
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+//drops a model's diffuse maps once the material arrays hold copies of them;
+//nothing binds them directly any more
+static void ReleaseDiffuseTextures(Model& model)
+{
+    auto isDiffuse = [](const Texture& tex) { return tex.type == "texture_diffuse"; };
 
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    for (auto& mesh : model.meshes)
+        mesh.textures.erase(std::remove_if(mesh.textures.begin(), mesh.textures.end(), isDiffuse), mesh.textures.end());
 
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
+    //one cache reference per entry
+    auto& loaded = model.textures_loaded;
+    for (const auto& tex : loaded)
+        if (isDiffuse(tex))
+            ReleaseTexture(tex.id);
+    loaded.erase(std::remove_if(loaded.begin(), loaded.end(), isDiffuse), loaded.end());
 }
 
-static float DistanceXZ(const glm::vec3& a, const glm::vec3& b)
+//model and its normal matrix for the classic per object draws
+static void SetModelMatrix(Shader& s, const glm::mat4& model)
 {
-    glm::vec2 da(a.x - b.x, a.z - b.z);
-    return glm::length(da);
+    s.setMat4("model", model);
+    s.setMat3("normalMatrix", NormalMatrix(model));
+}
+
+//uniforms shared by every program that uses model_loading.frag
+static void SetLitUniforms(World& world, Shader& s,
+    const glm::mat4& view, const glm::mat4& proj, const glm::mat4& lightSpace)
+{
+    s.use();
+    s.setMat4("projection", proj);
+    s.setMat4("view", view);
+    s.setMat4("lightSpaceMatrix", lightSpace);
+    s.setVec3("lightDir", world.lightDir);
+    s.setInt("shadowMap", 1);
+    s.setInt("groundTex", 2);
 }
-static void ResetSkullMode(World& world);
 
 
 void GeneratePedestalMesh(World& world)
 {
  
-    struct V { float x, y, z, nx, ny, nz; };
-    std::vector<V> verts;
+    std::vector<SceneVertex> verts;
     verts.reserve(6);
 
     const float x0 = -1.0f;
@@ -126,35 +188,103 @@ void GeneratePedestalMesh(World& world)
     const float z0 = -1.0f;
     const float z1 = 1.0f;
     const float y = 0.0f;
-    const float nx = 0.0f, ny = 1.0f, nz = 0.0f;
+    const glm::vec3 n(0.0f, 1.0f, 0.0f);
+    const glm::vec2 uv(0.0f);
 
     //two triangles forming a square
-    verts.push_back({ x0, y, z0, nx, ny, nz });
-    verts.push_back({ x1, y, z0, nx, ny, nz });
-    verts.push_back({ x1, y, z1, nx, ny, nz });
+    verts.push_back({ glm::vec3(x0, y, z0), n, uv });
+    verts.push_back({ glm::vec3(x1, y, z0), n, uv });
+    verts.push_back({ glm::vec3(x1, y, z1), n, uv });
+
+    verts.push_back({ glm::vec3(x0, y, z0), n, uv });
+    verts.push_back({ glm::vec3(x1, y, z1), n, uv });
+    verts.push_back({ glm::vec3(x0, y, z1), n, uv });
+
+    world.pedestalMesh = AddTriangles(world, verts);
+}
+
+//E interaction
+void HandleInteractInput(World& world, float lateBy)
+{
+    //cockroach interaction
+    float bestDist2 = 3.0f * 3.0f;
+    int   bestIdx = -1;
+
+    for (int i = 0; i < (int)world.cockroaches.size(); ++i)
+    {
+        const auto& r = world.cockroaches[i];
+        float d2 = glm::length(world.player.pos - r.pos);
+        if (d2 < bestDist2)
+        {
+            bestDist2 = d2;
+            bestIdx = i;
+        }
+    }
 
-    verts.push_back({ x0, y, z0, nx, ny, nz });
-    verts.push_back({ x1, y, z1, nx, ny, nz });
-    verts.push_back({ x0, y, z1, nx, ny, nz });
+    if (bestIdx >= 0)
+    {
+        auto& r = world.cockroaches[bestIdx];
+        r.dancing = !r.dancing;
 
-    glGenVertexArrays(1, &world.pedestalVAO);
-    glGenBuffers(1, &world.pedestalVBO);
+        //check if all roaches are dancing
+        bool allDancing = !world.cockroaches.empty();
+        for (const auto& c : world.cockroaches)
+        {
+            if (!c.dancing)
+            {
+                allDancing = false;
+                break;
+            }
+        }
 
-    glBindVertexArray(world.pedestalVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, world.pedestalVBO);
-    glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(V), verts.data(), GL_STATIC_DRAW);
+        if (allDancing)
+        {
+            if (!world.starRoachesAwarded)
+            {
+                world.starRoachesAwarded = true;
+                world.starCount++;
+                std::cout << "All roaches dancing! +1 STAR (total: " << world.starCount << ")\n";
+            }
+            else
+            {
+                std::cout << "All roaches dancing (star already awarded)\n";
+            }
+        }
+    }
+
+    //golden ball interaction
+    if (world.goldenBallIndex >= 0 &&
+        world.goldenBallIndex < (int)world.balls.size())
+    {
+        Sphere& golden = world.balls[world.goldenBallIndex];
+        float dist = glm::length(world.player.pos - golden.pos);
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(V), (void*)0);
-    glEnableVertexAttribArray(0);
+        if (dist < 2.0f)
+        {
+            golden.radius = 0.0f; //disappear
+            world.goldenBallIndex = -1;
 
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(V), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+            //award star
+            if (!world.starGoldenBallAwarded)
+            {
+                world.starGoldenBallAwarded = true;
+                world.starCount++;
+                std::cout << "Found the golden ball! +1 STAR (total: " << world.starCount << ")\n";
+            }
+            else
+            {
+                std::cout << "Found the golden ball (star already awarded)\n";
+            }
+        }
+    }
 
-    glBindVertexArray(0);
+    //QTE interaction
+    HandleQTEInput(world, lateBy);
+    HandleSkullModeInput(world, lateBy);
 }
 
 //QTE input handler
-void HandleQTEInput(World& world)
+void HandleQTEInput(World& world, float lateBy)
 {
     const float startRange = 2.0f; //how close player must be
 
@@ -182,9 +312,14 @@ void HandleQTEInput(World& world)
     if (!world.qteVisible)
         return;
 
+    //the ring as it was when E went down, not as of this step
+    float timerAtPress = std::max(world.qteTimer - lateBy, 0.0f);
+    float tAtPress = glm::clamp(timerAtPress / world.qteOuterShrinkTime, 0.0f, 1.0f);
+    float outerAtPress = world.qteOuterMaxRadius * (1.0f - tAtPress);
+
     //success outer inside inner
     if (!world.qteThisRoundHit &&
-        world.qteOuterRadius <= world.qteInnerRadius)
+        outerAtPress <= world.qteInnerRadius)
     {
         world.qteThisRoundHit = true;
         world.qteCurrentHits++;
@@ -227,7 +362,7 @@ void HandleQTEInput(World& world)
     }
 }
 
-void HandleSkullModeInput(World& world)
+void HandleSkullModeInput(World& world, float lateBy)
 {
     const float startRange = 2.0f;
 
@@ -243,14 +378,17 @@ void HandleSkullModeInput(World& world)
         //full reset
         ResetSkullMode(world);
         world.skullModeActive = true;
+
+        //the clock started at the press
+        world.skullModeTime = lateBy;
+        world.skullSpawnTimer = lateBy;
     }
 }
 
 void GenerateCylinderMesh(World& world, int)
 {
     //square pit walls
-    struct V { float x, y, z, nx, ny, nz; };
-    std::vector<V> verts;
+    std::vector<SceneVertex> verts;
     verts.reserve(6 * 4);
 
     const float y0 = 0.0f;
@@ -265,9 +403,10 @@ void GenerateCylinderMesh(World& world, int)
         float xC, float yC, float zC,
         float nx, float ny, float nz)
         {
-            verts.push_back({ xA, yA, zA, nx, ny, nz });
-            verts.push_back({ xB, yB, zB, nx, ny, nz });
-            verts.push_back({ xC, yC, zC, nx, ny, nz });
+            glm::vec3 n(nx, ny, nz);
+            verts.push_back({ glm::vec3(xA, yA, zA), n, glm::vec2(0.0f) });
+            verts.push_back({ glm::vec3(xB, yB, zB), n, glm::vec2(0.0f) });
+            verts.push_back({ glm::vec3(xC, yC, zC), n, glm::vec2(0.0f) });
         };
 
     //+Z
@@ -295,50 +434,14 @@ void GenerateCylinderMesh(World& world, int)
         pushTri(x0, y0, z0, x0, y0, z1, x0, y1, z1, nx, ny, nz);
     }
 
-    world.pitVertCount = (int)verts.size();
-
-    glGenVertexArrays(1, &world.pitVAO);
-    glGenBuffers(1, &world.pitVBO);
-
-    glBindVertexArray(world.pitVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, world.pitVBO);
-    glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(V), verts.data(), GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(V), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(V), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    glBindVertexArray(0);
+    world.pitMesh = AddTriangles(world, verts);
 }
 
 unsigned int LoadTexture(const char* path)
 {
-    unsigned int tex;
-    glGenTextures(1, &tex);
-
-    int w, h, ch;
-    unsigned char* data = stbi_load(path, &w, &h, &ch, 0);
-
-    if (!data)
-    {
+    unsigned int tex = LoadTextureFile(path);
+    if (!tex)
         std::cout << "FAILED TO LOAD TEXTURE: " << path << "\n";
-        return 0;
-    }
-
-    GLenum format = (ch == 4 ? GL_RGBA : GL_RGB);
-
-    glBindTexture(GL_TEXTURE_2D, tex);
-    glTexImage2D(GL_TEXTURE_2D, 0, format, w, h, 0, format, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    stbi_image_free(data);
     return tex;
 }
 
@@ -350,10 +453,10 @@ static void SpawnSkullTowardsPlayer(World& world)
 
     //spawn on a circle around the player
     float radius = 25.0f;
-    float ang = frand(0.0f, 2.0f * (float)M_PI);
+    float ang = frand(world.rng, 0.0f, 2.0f * (float)M_PI);
     glm::vec3 spawn(
         world.player.pos.x + std::cos(ang) * radius,
-        world.player.pos.y + frand(0.5f, 3.0f), //random height
+        world.player.pos.y + frand(world.rng, 0.5f, 3.0f), //random height
         world.player.pos.z + std::sin(ang) * radius
     );
 
@@ -364,7 +467,7 @@ static void SpawnSkullTowardsPlayer(World& world)
     if (len < 0.0001f) len = 0.0001f;
     glm::vec3 dir = toPlayer / len;
 
-    float speed = frand(6.0f, 10.0f); //fly speed
+    float speed = frand(world.rng, 6.0f, 10.0f); //fly speed
     inst.vel = dir * speed;
     inst.active = true;
 
@@ -385,147 +488,365 @@ static void ResetSkullMode(World& world)
 
 void InitWorld(World& world)
 {
-    //construct models
-    world.boulder = new Model("media/boulders/RockSpires_Obj/RockSpires_Obj/RockSpires_2.obj");
-    world.grass1 = new Model("media/grass/Grass1.obj");
-    world.grass2 = new Model("media/grass/Grass2.obj");
-    world.grass3 = new Model("media/grass/Grass3.obj");
-    world.cockroach = new Model("media/cockroach/cuban-cockroach/source/cuban_cockroach.obj");
-    world.skull = new Model("media/skull/scull lp.obj");
+    //startup as a task graph: Assimp parsing, image decoding and procedural
+    //work on workers, GL on this thread; texture uploads from the model
+    //loads are marshalled back here by LoadTextureFile
+    TaskGraph graph;
 
+    int boulder = AddTask(graph, "model boulder", TASK_WORKER, [&]()
+        {
+            world.boulder = new Model("media/boulders/RockSpires_Obj/RockSpires_Obj/RockSpires_2.obj");
+        });
+    int grass1 = AddTask(graph, "model grass1", TASK_WORKER, [&]() { world.grass1 = new Model("media/grass/Grass1.obj"); });
+    int grass2 = AddTask(graph, "model grass2", TASK_WORKER, [&]() { world.grass2 = new Model("media/grass/Grass2.obj"); });
+    int grass3 = AddTask(graph, "model grass3", TASK_WORKER, [&]() { world.grass3 = new Model("media/grass/Grass3.obj"); });
+    int roach = AddTask(graph, "model cockroach", TASK_WORKER, [&]()
+        {
+            world.cockroach = new Model("media/cockroach/cuban-cockroach/source/cuban_cockroach.obj");
+        });
+    int skull = AddTask(graph, "model skull", TASK_WORKER, [&]() { world.skull = new Model("media/skull/scull lp.obj"); });
 
-    GenerateSphereMesh(world);
-    GeneratePlane(world);
-    GenerateCylinderMesh(world, 48);
-    GeneratePedestalMesh(world);
-    world.groundTex = LoadTexture("media/textures/ground.png");
+    //every program in one batch, specialised through defines and served from the binary cache
+    int shaders = AddTask(graph, "shaders", TASK_CONTEXT, [&]()
+        {
+            enum
+            {
+                SHADER_LIT_COLOR, SHADER_LIT_GROUND, SHADER_LIT_DIFFUSE,
+                SHADER_TERRAIN, SHADER_TERRAIN_DEPTH, SHADER_INSTANCED, SHADER_DEPTH,
+                SHADER_CULL, SHADER_HIZ, SHADER_POST, SHADER_OVERLAY,
+                SHADER_BALLS_INTEGRATE, SHADER_BALLS_COUNT, SHADER_BALLS_SCAN,
+                SHADER_BALLS_SCATTER, SHADER_BALLS_COLLIDE, SHADER_BALLS_INSTANCES,
+                SHADER_COUNT
+            };
+
+            std::vector<ShaderProgramDesc> descs(SHADER_COUNT);
+            auto program = [&](int slot, const char* vs, const char* fs, std::vector<std::string> defines)
+                {
+                    descs[slot].vertexPath = vs;
+                    descs[slot].fragmentPath = fs;
+                    descs[slot].defines = defines;
+                };
+            auto compute = [&](int slot, const char* cs, std::vector<std::string> defines)
+                {
+                    descs[slot].computePath = cs;
+                    descs[slot].defines = defines;
+                };
 
-    world.meTex = LoadTexture("media/me!/image.jpg");
+            program(SHADER_LIT_COLOR, "model_loading.vert", "model_loading.frag", { "BASE_COLOR" });
+            program(SHADER_LIT_GROUND, "model_loading.vert", "model_loading.frag", { "BASE_GROUND" });
+            program(SHADER_LIT_DIFFUSE, "model_loading.vert", "model_loading.frag", { "BASE_DIFFUSE" });
+            program(SHADER_TERRAIN, "terrain.vert", "model_loading.frag", { "BASE_GROUND" });
+            program(SHADER_TERRAIN_DEPTH, "terrain.vert", "shadow_depth.frag", {});
+            program(SHADER_INSTANCED, "instanced.vert", "model_loading.frag", { "BASE_INSTANCE" });
+            program(SHADER_DEPTH, "instanced.vert", "shadow_depth.frag", {});
+            compute(SHADER_CULL, "cull.comp", {});
+            compute(SHADER_HIZ, "hiz.comp", {});
+            program(SHADER_POST, "retro_post.vert", "retro_post.frag", {});
+            program(SHADER_OVERLAY, "overlay.vert", "overlay.frag", {});
+            compute(SHADER_BALLS_INTEGRATE, "balls.comp", { "BALLS_INTEGRATE" });
+            compute(SHADER_BALLS_COUNT, "balls.comp", { "BALLS_COUNT" });
+            compute(SHADER_BALLS_SCAN, "balls.comp", { "BALLS_SCAN" });
+            compute(SHADER_BALLS_SCATTER, "balls.comp", { "BALLS_SCATTER" });
+            compute(SHADER_BALLS_COLLIDE, "balls.comp", { "BALLS_COLLIDE" });
+            compute(SHADER_BALLS_INSTANCES, "balls.comp", { "BALLS_INSTANCES" });
+
+            ShaderCacheStats stats;
+            std::vector<Shader*> shaders = BuildShaderPrograms(descs, &stats);
+
+            world.litShaders[LIT_COLOR] = shaders[SHADER_LIT_COLOR];
+            world.litShaders[LIT_GROUND] = shaders[SHADER_LIT_GROUND];
+            world.litShaders[LIT_DIFFUSE] = shaders[SHADER_LIT_DIFFUSE];
+            world.terrainShader = shaders[SHADER_TERRAIN];
+            world.terrainDepthShader = shaders[SHADER_TERRAIN_DEPTH];
+            world.instancedShader = shaders[SHADER_INSTANCED];
+            world.depthShader = shaders[SHADER_DEPTH];
+            world.scene.cullShader = shaders[SHADER_CULL];
+            world.hiz.buildShader = shaders[SHADER_HIZ];
+            world.postShader = shaders[SHADER_POST];
+            world.overlay.shader = shaders[SHADER_OVERLAY];
+            for (int p = 0; p < GPU_BALLS_PASS_COUNT; ++p)
+                world.gpuBalls.passes[p] = shaders[SHADER_BALLS_INTEGRATE + p];
+
+            std::cout << "Shaders: " << stats.programs << " programs, " << stats.cacheHits << " from cache, "
+                << stats.compiled << " compiled in " << stats.milliseconds << " ms\n";
+        });
+
+    //terrain first, everything placed below sits on it
+    int terrain = AddTask(graph, "terrain", TASK_WORKER, [&]() { GenerateTerrain(world.terrain); });
+    AddTask(graph, "terrain upload", TASK_CONTEXT, [&]() { UploadTerrain(world.terrain); }, { terrain });
+
+    int geometry = AddTask(graph, "scene geometry", TASK_WORKER, [&]()
+        {
+            //every model and procedural mesh shares one vertex/index buffer, the GPU
+            //culled props and the classic draws alike
+            InitSceneGeometry(world.geometry);
+            world.scene.geometry = &world.geometry;
+
+            GenerateSphereMesh(world);
+            world.grassGroup[0] = AddSceneMeshes(world.scene, world.grass1->meshes);
+            world.grassGroup[1] = AddSceneMeshes(world.scene, world.grass2->meshes);
+            world.grassGroup[2] = AddSceneMeshes(world.scene, world.grass3->meshes);
+            world.boulderGroup = AddSceneMeshes(world.scene, world.boulder->meshes, 1);
+            world.roachGroup = AddSceneMeshes(world.scene, world.cockroach->meshes);
+            world.skullGroup = AddSceneMeshes(world.scene, world.skull->meshes);
+            GenerateCylinderMesh(world, 48);
+            GeneratePedestalMesh(world);
+
+            //the arena has its own copy now; culling works off the batch bounds and
+            //physics off fixed boxes, so no model keeps even its positions
+            Model* models[] = { world.boulder, world.grass1, world.grass2, world.grass3, world.cockroach, world.skull };
+            size_t before = 0, after = 0;
+            for (Model* m : models)
+            {
+                before += m->cpuBytes();
+                m->releaseGeometry();
+                after += m->cpuBytes();
+            }
+            std::cout << "Meshes: " << before / 1024 << " KB of CPU geometry before release, " << after / 1024 << " KB after\n";
 
+            //unit quad, used for the picture by the pit
+            {
+                const glm::vec3 n(0.0f, 0.0f, 1.0f);
+                std::vector<SceneVertex> quad = {
+                    { glm::vec3(0.0f, 0.0f, 0.0f), n, glm::vec2(0.0f, 0.0f) },
+                    { glm::vec3(1.0f, 0.0f, 0.0f), n, glm::vec2(1.0f, 0.0f) },
+                    { glm::vec3(1.0f, 1.0f, 0.0f), n, glm::vec2(1.0f, 1.0f) },
+
+                    { glm::vec3(0.0f, 0.0f, 0.0f), n, glm::vec2(0.0f, 0.0f) },
+                    { glm::vec3(1.0f, 1.0f, 0.0f), n, glm::vec2(1.0f, 1.0f) },
+                    { glm::vec3(0.0f, 1.0f, 0.0f), n, glm::vec2(0.0f, 1.0f) }
+                };
+                world.quadMesh = AddTriangles(world, quad);
+            }
+        }, { boulder, grass1, grass2, grass3, roach, skull });
+    int upload = AddTask(graph, "geometry upload", TASK_CONTEXT, [&]()
+        {
+            UploadGeometry(world.geometry);
+            BuildSceneBuffers(world.scene);
+        }, { geometry });
 
-    //UI for stars
-    {
-        // x, y, z,  u, v
-        float uiVerts[] = {
-            0.0f, 0.0f, 0.0f,  0.0f, 0.0f,
-            1.0f, 0.0f, 0.0f,  1.0f, 0.0f,
-            1.0f, 1.0f, 0.0f,  1.0f, 1.0f,
-
-            0.0f, 0.0f, 0.0f,  0.0f, 0.0f,
-            1.0f, 1.0f, 0.0f,  1.0f, 1.0f,
-            0.0f, 1.0f, 0.0f,  0.0f, 1.0f
-        };
+    AddTask(graph, "materials", TASK_CONTEXT, [&]()
+        {
+            //roaches are the only textured props in the scene, one material for
+            //all their meshes; the skull's meshes each get their own
+            InitMaterials(world.materials);
+            for (const auto& mesh : world.cockroach->meshes)
+            {
+                unsigned int tex = DiffuseTexture(mesh);
+                if (tex != 0 && world.roachMaterial == 0)
+                    world.roachMaterial = AddTextureMaterial(world.materials, tex);
+            }
+            for (const auto& mesh : world.skull->meshes)
+                world.skullMaterials.push_back(AddTextureMaterial(world.materials, DiffuseTexture(mesh)));
+            BuildMaterials(world.materials);
+            ReleaseDiffuseTextures(*world.cockroach);
+            ReleaseDiffuseTextures(*world.skull);
+            BindMaterialSamplers(*world.litShaders[LIT_DIFFUSE]);
+            BindMaterialSamplers(*world.instancedShader);
+        }, { roach, skull, shaders });
+
+    AddTask(graph, "texture ground", TASK_WORKER, [&]() { world.groundTex = LoadTexture("media/textures/ground.png"); });
+    AddTask(graph, "texture me", TASK_WORKER, [&]() { world.meTex = LoadTexture("media/me!/image.jpg"); });
+
+    AddTask(graph, "sfx", TASK_WORKER, [&]()
+        {
+            //SFX decoded once, triggered by handle afterwards
+            InitSfx(world.sfx, world.soundEngine);
+            {
+                const char* footstepFiles[4] = {
+                    "media/music/dirt1.wav",
+                    "media/music/dirt2.wav",
+                    "media/music/dirt3.wav",
+                    "media/music/dirt4.wav"
+                };
+                for (int i = 0; i < 4; ++i)
+                    world.footstepSfx[i] = LoadSfx(world.sfx, footstepFiles[i], 0.05f);
 
-        glGenVertexArrays(1, &world.uiQuadVAO);
-        glGenBuffers(1, &world.uiQuadVBO);
-        glBindVertexArray(world.uiQuadVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, world.uiQuadVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(uiVerts), uiVerts, GL_STATIC_DRAW);
+                world.impactSfx = LoadSfx(world.sfx, "media/music/dirt1.wav");
+                world.skullSfx = LoadSfx(world.sfx, "media/music/footstep.mp3");
+                world.cucarachaSfx = LoadSfx(world.sfx, "media/music/La Cucaracha.mp3", 1.0f, true);
+            }
 
-        //position
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
+            //solver contacts feed the impact thread through a lock-free ring
+            if (world.soundEngine && world.impactSfx >= 0)
+            {
+                StartImpactAudio(world.impactAudio, world.soundEngine, world.sfx.sources, world.impactSfx);
+                SetContactSink(&world.impactAudio.ring, 0.5f);
+            }
+        });
 
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(2);
+    //HUD renderer for the stars and QTE circle
+    AddTask(graph, "overlay", TASK_CONTEXT, [&]() { InitOverlay(world.overlay); });
 
-        glBindVertexArray(0);
-    }
+    int placement = AddTask(graph, "placement", TASK_WORKER, [&]()
+        {
+            world.player = { glm::vec3(0,2,0), glm::vec3(0), glm::vec3(0.5f,1.0f,0.5f) };
+            world.lastPlayerPos = world.player.pos;
 
-    world.player = { glm::vec3(0,2,0), glm::vec3(0), glm::vec3(0.5f,1.0f,0.5f) };
-    world.lastPlayerPos = world.player.pos;
+            auto addBoulder = [&](const glm::vec3& p)
+                {
+                    world.boulderWall.push_back({ p, glm::vec3(0.0f), world.boulderHalf });
+                };
 
-    auto addBoulder = [&](const glm::vec3& p)
-        {
-            world.boulderWall.push_back({ p, glm::vec3(0.0f), world.boulderHalf });
-        };
+            const int   boulderCount = 32;
+            const float ringRadius = 30.0f;
+            const float minYOffset = -world.boulderHalf.y * 0.5f;
+            const float maxYOffset = world.boulderHalf.y * 0.2f;
 
-    const int   boulderCount = 32;
-    const float ringRadius = 30.0f;
-    const float minYOffset = -world.boulderHalf.y * 0.5f;
-    const float maxYOffset = world.boulderHalf.y * 0.2f;
+            for (int i = 0; i < boulderCount; ++i)
+            {
+                float t = (float)i / (float)boulderCount;
+                float ang = t * 2.0f * (float)M_PI;
 
-    for (int i = 0; i < boulderCount; ++i)
-    {
-        float t = (float)i / (float)boulderCount;
-        float ang = t * 2.0f * (float)M_PI;
+                float x = world.player.pos.x + std::cos(ang) * ringRadius;
+                float z = world.player.pos.z + std::sin(ang) * ringRadius;
+                float y = TerrainHeight(x, z) + world.boulderHalf.y + frand(world.rng, minYOffset, maxYOffset);
 
-        float x = world.player.pos.x + std::cos(ang) * ringRadius;
-        float z = world.player.pos.z + std::sin(ang) * ringRadius;
-        float y = world.boulderHalf.y + frand(minYOffset, maxYOffset);
+                addBoulder(glm::vec3(x, y, z));
+            }
 
-        addBoulder(glm::vec3(x, y, z));
-    }
+            // BALL PIT
+            world.balls.clear();
+            world.balls.reserve(150);
+
+            glm::vec3 pitCenter(0.0f, 0.5f, -10.0f);
+            float     pitRadius = 4.0f;
+            float     pitHeight = 1.4f;
+            float     ballRadius = 0.3f;
 
-    // BALL PIT
-    world.balls.clear();
-    world.balls.reserve(150);
+            for (int i = 0; i < 150; ++i)
+            {
+                float ang = frand(world.rng, 0.0f, 2.0f * (float)M_PI);
+                float r = std::sqrt(frand(world.rng, 0.0f, 1.0f)) * pitRadius;
+                float x = pitCenter.x + std::cos(ang) * r;
+                float z = pitCenter.z + std::sin(ang) * r;
+                float y = pitCenter.y + frand(world.rng, 0.0f, pitHeight);
+
+                Sphere s;
+                s.pos = glm::vec3(x, y, z);
+                s.vel = glm::vec3(0.0f);
+                s.radius = ballRadius;
+                s.mass = 1.0f;
+                world.balls.push_back(s);
+            }
 
-    glm::vec3 pitCenter(0.0f, 0.5f, -10.0f);
-    float     pitRadius = 4.0f;
-    float     pitHeight = 1.4f;
-    float     ballRadius = 0.3f;
+            world.goldenBallIndex = (world.balls.empty() ? -1 : (int)(world.rng() % world.balls.size()));
 
-    for (int i = 0; i < 150; ++i)
-    {
-        float ang = frand(0.0f, 2.0f * (float)M_PI);
-        float r = std::sqrt(frand(0.0f, 1.0f)) * pitRadius;
-        float x = pitCenter.x + std::cos(ang) * r;
-        float z = pitCenter.z + std::sin(ang) * r;
-        float y = pitCenter.y + frand(0.0f, pitHeight);
-
-        Sphere s;
-        s.pos = glm::vec3(x, y, z);
-        s.vel = glm::vec3(0.0f);
-        s.radius = ballRadius;
-        s.mass = 1.0f;
-        world.balls.push_back(s);
-    }
+            //GPU mode fills the arena around the pit, the golden ball stays in it
+            if (world.gpuBallPhysics)
+            {
+                const float fieldRadius = 60.0f;
+                world.balls.reserve(std::max(world.gpuBallCount, (int)world.balls.size()));
+                while ((int)world.balls.size() < world.gpuBallCount)
+                {
+                    float ang = frand(world.rng, 0.0f, 2.0f * (float)M_PI);
+                    float r = std::sqrt(frand(world.rng, 0.0f, 1.0f)) * fieldRadius;
+                    float x = std::cos(ang) * r;
+                    float z = std::sin(ang) * r;
+
+                    Sphere s;
+                    s.pos = glm::vec3(x, TerrainHeight(x, z) + frand(world.rng, ballRadius, 12.0f), z);
+                    s.vel = glm::vec3(0.0f);
+                    s.radius = ballRadius;
+                    s.mass = 1.0f;
+                    world.balls.push_back(s);
+                }
+            }
 
-    world.goldenBallIndex = (world.balls.empty() ? -1 : std::rand() % world.balls.size());
+            // BALL PIT PHYSICS
+            world.ballPitWalls.clear();
+            world.ballPitWalls.reserve(4);
 
-    // BALL PIT PHYSICS
-    world.ballPitWalls.clear();
-    world.ballPitWalls.reserve(4);
+            auto addWall = [&](const glm::vec3& center, const glm::vec3& halfSize)
+                {
+                    PhysicsBody wall;
+                    wall.pos = center;
+                    wall.vel = glm::vec3(0.0f);
+                    wall.size = halfSize;
+                    wall.grounded = false;
+                    world.ballPitWalls.push_back(wall);
+                };
 
-    auto addWall = [&](const glm::vec3& center, const glm::vec3& halfSize)
+            const float radiusInset = 0.2f;
+            const float wallRadius = pitRadius - radiusInset;
+            const float wallThickness = 0.3f;
+            const float wallHalfH = pitHeight * 0.5f;
+            const float wallY = wallHalfH;
+
+            //+Z wall
+            addWall(glm::vec3(pitCenter.x, wallY, pitCenter.z + wallRadius),
+                glm::vec3(wallRadius, wallHalfH, wallThickness));
+            //-Z wall
+            addWall(glm::vec3(pitCenter.x, wallY, pitCenter.z - wallRadius),
+                glm::vec3(wallRadius, wallHalfH, wallThickness));
+            //+X wall
+            addWall(glm::vec3(pitCenter.x + wallRadius, wallY, pitCenter.z),
+                glm::vec3(wallThickness, wallHalfH, wallRadius));
+            //-X wall
+            addWall(glm::vec3(pitCenter.x - wallRadius, wallY, pitCenter.z),
+                glm::vec3(wallThickness, wallHalfH, wallRadius));
+
+            //Grass
+            world.grass.reserve(1500);
+            for (int i = 0; i < 1500; ++i)
+            {
+                float x = frand(world.rng, -25, 25);
+                float z = frand(world.rng, -25, 25);
+                world.grass.push_back({
+                    glm::vec3(x, TerrainHeight(x, z), z),
+                    frand(world.rng, 0,360),
+                    frand(world.rng, 0.2f,0.4f),
+                    (int)(world.rng() % 3)
+                    });
+            }
+        }, { terrain });
+
+    AddTask(graph, "static instances", TASK_WORKER, [&]()
         {
-            PhysicsBody wall;
-            wall.pos = center;
-            wall.vel = glm::vec3(0.0f);
-            wall.size = halfSize;
-            wall.grounded = false;
-            world.ballPitWalls.push_back(wall);
-        };
+            //boulders and grass never move, upload them once; after the geometry
+            //upload since BuildSceneBuffers resets the static capacities
+            for (auto& r : world.boulderWall)
+            {
+                glm::mat4 mo(1);
+                mo = glm::translate(mo, r.pos);
+                mo = glm::scale(mo, glm::vec3(world.boulderScale));
+                AddSceneInstance(world.scene, world.boulderGroup, mo, glm::vec4(glm::vec3(0.5f), 1.0f));
+            }
+            for (auto& g : world.grass)
+                AddSceneInstance(world.scene, world.grassGroup[g.type], GrassMatrix(g), glm::vec4(0.1f, 0.7f, 0.1f, 1.0f));
+            MarkSceneStatic(world.scene);
+        }, { placement, upload });
+
+    RunTaskGraph(graph);
+    PrintTaskTimings(graph);
+
+    {
+        TextureStats stats = GetTextureStats();
+        std::cout << "Textures: " << stats.textures << " loaded, " << stats.compressed << " block compressed, "
+            << stats.gpuBytes / 1024 << " KB (" << stats.uncompressedBytes / 1024 << " KB as RGBA8), cache "
+            << stats.cacheHits << " hits / " << stats.cacheMisses << " misses, " << stats.bytesSaved / 1024 << " KB not re-uploaded\n";
+    }
 
-    const float radiusInset = 0.2f;
-    const float wallRadius = pitRadius - radiusInset;
-    const float wallThickness = 0.3f;
-    const float wallHalfH = pitHeight * 0.5f;
-    const float wallY = wallHalfH;
-
-    //+Z wall
-    addWall(glm::vec3(pitCenter.x, wallY, pitCenter.z + wallRadius),
-        glm::vec3(wallRadius, wallHalfH, wallThickness));
-    //-Z wall
-    addWall(glm::vec3(pitCenter.x, wallY, pitCenter.z - wallRadius),
-        glm::vec3(wallRadius, wallHalfH, wallThickness));
-    //+X wall
-    addWall(glm::vec3(pitCenter.x + wallRadius, wallY, pitCenter.z),
-        glm::vec3(wallThickness, wallHalfH, wallRadius));
-    //-X wall
-    addWall(glm::vec3(pitCenter.x - wallRadius, wallY, pitCenter.z),
-        glm::vec3(wallThickness, wallHalfH, wallRadius));
-
-    //Grass
-    world.grass.reserve(1500);
-    for (int i = 0; i < 1500; ++i)
-        world.grass.push_back({
-            glm::vec3(frand(-25,25),0,frand(-25,25)),
-            frand(0,360),
-            frand(0.2f,0.4f),
-            std::rand() % 3
-            });
+    //boxes the balls collide with, the player's lane is refreshed every solver pass
+    ClearAABBBatch(world.ballColliders);
+    AddAABB(world.ballColliders, world.player, CONTACT_PLAYER);
+    AddAABBs(world.ballColliders, world.boulderWall, CONTACT_BOULDER);
+    AddAABBs(world.ballColliders, world.ballPitWalls, CONTACT_PIT_WALL);
+    {
+        static const char* simdNames[] = { "scalar", "SSE", "AVX" };
+        std::cout << "Physics: " << world.ballColliders.count << " box colliders in "
+            << world.ballColliders.ids.size() / PHYSICS_BOX_GROUP << " groups, "
+            << simdNames[PhysicsSimdSupported()] << " sphere-box kernel\n";
+    }
+
+    //same colliders on the GPU, its instances go after the CPU ones every frame
+    if (world.gpuBallPhysics)
+    {
+        InitGpuBalls(world.gpuBalls, world.balls, world.goldenBallIndex, world.ballColliders);
+        ReserveSceneGpuInstances(world.scene, world.ballGroup, world.gpuBalls.count);
+    }
+
+    //the rest is a handful of assignments, not worth a task
 
     //single cockroach values
     world.cockroachPos = glm::vec3(5.0f, 0.1f, 10.0f);
@@ -571,6 +892,10 @@ void InitWorld(World& world)
         world.cockroaches.push_back(inst);
     }
 
+    //sit roaches on the terrain
+    for (auto& r : world.cockroaches)
+        r.pos.y += TerrainHeight(r.pos.x, r.pos.z);
+
     //first one
     if (!world.cockroaches.empty())
         world.cockroachPos = world.cockroaches[0].pos;
@@ -601,7 +926,8 @@ void InitWorld(World& world)
 void UpdateWorld(World& world, float dt)
 {
     UpdatePhysics(world.player, dt);
-    for (auto& b : world.balls) UpdateSphere(b, dt);
+    if (!world.gpuBallPhysics)
+        for (auto& b : world.balls) UpdateSphere(b, dt);
 
     //footstep SFX
     if (world.soundEngine)
@@ -624,16 +950,6 @@ void UpdateWorld(World& world, float dt)
         const float walkStopThreshold = 0.3f; //stop walking below this
 
         static bool   isWalking = false;
-        static irrklang::ISound* currentFootstep = nullptr;
-
-        //cycling footstep sounds 1-4
-        static int footstepIndex = 0;
-        static const char* const footstepFiles[4] = {
-            "media/music/dirt1.wav",
-            "media/music/dirt2.wav",
-            "media/music/dirt3.wav",
-            "media/music/dirt4.wav"
-        };
 
         if (world.player.grounded)
         {
@@ -655,40 +971,12 @@ void UpdateWorld(World& world, float dt)
             {
                 world.footstepTimer = 0.0f;
 
-                //pick current footstep sound and advance to the next
-                const char* footstepPath = footstepFiles[footstepIndex];
-                footstepIndex = (footstepIndex + 1) % 4;
-
-                std::cout << "FOOTSTEP (" << footstepPath << ")\n";
+                //cycle the four preloaded steps, the previous one is cut so they never overlap
+                SfxHandle step = world.footstepSfx[world.footstepIndex];
+                world.footstepIndex = (world.footstepIndex + 1) % 4;
 
-                //ensure no overlapping instances
-                if (currentFootstep)
-                {
-                    currentFootstep->stop();
-                    currentFootstep->drop();
-                    currentFootstep = nullptr;
-                }
-
-                currentFootstep =
-                    world.soundEngine->play2D(
-                        footstepPath,
-                        false,   //no loop
-                        true,    //start paused so we can configure safely
-                        true     //return ISound*
-                    );
-
-                if (currentFootstep)
-                {
-                    const float volume = 0.05f;
-                    currentFootstep->setVolume(volume);
-                    currentFootstep->setPan(0.0f);
-
-                    //debug: log final volume and pan
-                    std::cout << "Footstep vol=" << currentFootstep->getVolume()
-                        << " pan=" << currentFootstep->getPan() << "\n";
-
-                    currentFootstep->setIsPaused(false);
-                }
+                StopSfx(world.sfx, world.footstepVoice);
+                world.footstepVoice = PlaySfx(world.sfx, step, SFX_PRIORITY_FOOTSTEP);
             }
         }
         else
@@ -701,14 +989,12 @@ void UpdateWorld(World& world, float dt)
     }
 
     //song duration control
-    if (world.cucarachaSound)
+    if (world.cucarachaPlaying)
     {
         world.cucarachaTimer += dt;
         if (world.cucarachaTimer >= 30.0f)
         {
-            world.cucarachaSound->stop();
-            world.cucarachaSound->drop();
-            world.cucarachaSound = nullptr;
+            world.cucarachaPlaying = false;
             world.cucarachaTimer = 0.0f;
             std::cout << "La Cucaracha stopped after 30 seconds.\n";
         }
@@ -813,11 +1099,9 @@ void UpdateWorld(World& world, float dt)
             float t = static_cast<float>(i) / static_cast<float>(extraCount);
             float ang = t * 2.0f * static_cast<float>(M_PI);
 
-            glm::vec3 pos(
-                world.player.pos.x + std::cos(ang) * radius,
-                baseY,
-                world.player.pos.z + std::sin(ang) * radius
-            );
+            float x = world.player.pos.x + std::cos(ang) * radius;
+            float z = world.player.pos.z + std::sin(ang) * radius;
+            glm::vec3 pos(x, TerrainHeight(x, z) + baseY, z);
 
             CockroachInstance inst;
             inst.pos = pos;
@@ -831,21 +1115,10 @@ void UpdateWorld(World& world, float dt)
         //start song for up to 30 seconds
         if (world.soundEngine)
         {
-            //stop previous instance if somehow still playing
-            if (world.cucarachaSound)
-            {
-                world.cucarachaSound->stop();
-                world.cucarachaSound->drop();
-                world.cucarachaSound = nullptr;
-            }
-
-            world.cucarachaSound =
-                world.soundEngine->play2D("media/music/La Cucaracha.mp3",
-                    false,     
-                    false,     
-                    true);     
+            //positional, UpdateAudio plays it from the dancing roaches
+            world.cucarachaPlaying = world.cucarachaSfx >= 0;
 
-            if (world.cucarachaSound)
+            if (world.cucarachaPlaying)
             {
                 world.cucarachaTimer = 0.0f;
                 std::cout << "Playing La Cucaracha!\n";
@@ -857,173 +1130,278 @@ void UpdateWorld(World& world, float dt)
         }
     }
 
-    for (int it = 0; it < 8; ++it)
+    if (world.gpuBallPhysics)
     {
-        // ball–ball
-        for (int i = 0; i < (int)world.balls.size(); ++i)
-            for (int j = i + 1; j < (int)world.balls.size(); ++j)
-                ResolveSphereSphere(world.balls[i], world.balls[j]);
+        // player–boulders, the balls are stepped on the render thread
+        for (auto& r : world.boulderWall)
+            if (AABBCollide(world.player, r))
+                ResolveAABB(world.player, r);
 
-        // ball–boulder
-        for (auto& b : world.balls)
-            for (auto& r : world.boulderWall)
-                ResolveSphereAABB(b, r);
+        //a few frames old; enough to find the golden ball and thump the player
+        GpuBallReport report;
+        if (TakeGpuBallReports(world.gpuBalls, report))
+        {
+            if (world.goldenBallIndex >= 0 && report.golden.w > 0.0f)
+                world.balls[world.goldenBallIndex].pos = glm::vec3(report.golden);
 
-        // ball–ballpit
-        for (auto& b : world.balls)
-            for (auto& w : world.ballPitWalls)
-                ResolveSphereAABB(b, w);
+            if (report.playerContacts > 0)
+            {
+                float impulse;
+                std::memcpy(&impulse, &report.playerImpulse, sizeof(impulse));
+                ReportContact(world.player.pos, impulse, CONTACT_BALL, CONTACT_PLAYER);
+            }
+        }
+        return;
+    }
+
+    //ball pairs through the warm started solver, boxes are projected every
+    //pass; stops as soon as nothing moves by more than the tolerances
+    BallSolver& solver = world.ballSolver;
+    PrepareBallContacts(solver, world.balls);
+
+    int iterations = 0;
+    int maxIterations = std::min(solver.maxIterations, (int)BALL_SOLVER_MAX_ITERATIONS);
+    while (iterations < maxIterations)
+    {
+        //box contacts are only reported on the first iteration, later ones are resting corrections
+        int it = iterations++;
+        auto id = [it](int base, int index) { return (it == 0) ? base + index : -1; };
 
-        // ball–player
-        for (auto& b : world.balls)
-            ResolveSphereAABB(b, world.player);
+        // ball–ball
+        float penetration = 0.0f;
+        float impulseDelta = SolveBallContacts(solver, world.balls, penetration);
+
+        if (world.batchedColliders)
+        {
+            // ball–boulder, ball–ballpit and ball–player in packed groups
+            SetAABB(world.ballColliders, 0, world.player);
+            for (int i = 0; i < (int)world.balls.size(); ++i)
+                ResolveSphereAABBBatch(world.balls[i], world.ballColliders, id(CONTACT_BALL, i), &penetration);
+        }
+        else
+        {
+            // ball–boulder
+            for (int i = 0; i < (int)world.balls.size(); ++i)
+                for (int r = 0; r < (int)world.boulderWall.size(); ++r)
+                    ResolveSphereAABB(world.balls[i], world.boulderWall[r], id(CONTACT_BALL, i), id(CONTACT_BOULDER, r), &penetration);
+
+            // ball–ballpit
+            for (int i = 0; i < (int)world.balls.size(); ++i)
+                for (int w = 0; w < (int)world.ballPitWalls.size(); ++w)
+                    ResolveSphereAABB(world.balls[i], world.ballPitWalls[w], id(CONTACT_BALL, i), id(CONTACT_PIT_WALL, w), &penetration);
+
+            // ball–player
+            for (int i = 0; i < (int)world.balls.size(); ++i)
+                ResolveSphereAABB(world.balls[i], world.player, id(CONTACT_BALL, i), id(CONTACT_PLAYER, 0), &penetration);
+        }
 
         // player–boulders
         for (auto& r : world.boulderWall)
             if (AABBCollide(world.player, r))
                 ResolveAABB(world.player, r);
+
+        if (BallSolveConverged(solver, impulseDelta, penetration))
+            break;
     }
+    FinishBallContacts(solver, world.balls, iterations);
 }
 
-void RenderWorld(World& world,
-    Shader& shader,
-    Shader& depthShader,
-    const glm::mat4& lightSpace,
-    const glm::mat4& view,
-    const glm::mat4& proj,
-    unsigned int depthTex,
-    unsigned int depthFBO,
-    unsigned int SHW,
-    unsigned int SHH)
+void UpdateAudio(World& world, const glm::vec3& listenerPos, const glm::vec3& listenerForward)
 {
-    //shadow pass
-    glViewport(0, 0, SHW, SHH);
-    glBindFramebuffer(GL_FRAMEBUFFER, depthFBO);
-    glClear(GL_DEPTH_BUFFER_BIT);
+    if (!world.soundEngine) return;
 
-    depthShader.use();
-    depthShader.setMat4("lightSpaceMatrix", lightSpace);
+    BeginSfxFrame(world.sfx);
 
-    auto DrawDepth = [&](Shader& s)
+    //song follows the dancing roaches
+    if (world.cucarachaPlaying)
+    {
+        glm::vec3 centre(0.0f);
+        int dancing = 0;
+        for (const auto& r : world.cockroaches)
         {
-            glm::mat4 M(1);
-            M = glm::scale(M, glm::vec3(100, 1, 100));
-            s.setMat4("model", M);
+            if (!r.dancing) continue;
+            centre += r.pos;
+            dancing++;
+        }
 
-            glBindVertexArray(world.planeVAO);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+        SfxEmitter e;
+        e.pos = dancing ? centre / (float)dancing : listenerPos;
+        e.sfx = world.cucarachaSfx;
+        e.key = 1;
+        e.minDistance = 10.0f;
+        e.maxDistance = 200.0f;
+        e.priority = SFX_PRIORITY_MUSIC;
+        AddSfxEmitter(world.sfx, e);
+    }
 
-            auto DrawModel = [&](Model& m, glm::vec3 pos, float scale)
-                {
-                    glm::mat4 mo(1);
-                    mo = glm::translate(mo, pos);
-                    mo = glm::scale(mo, glm::vec3(scale));
-                    s.setMat4("model", mo);
+    //slowed thud loop on every incoming skull
+    for (int i = 0; i < (int)world.skulls.size(); ++i)
+    {
+        const auto& sk = world.skulls[i];
+        if (!sk.active) continue;
+
+        SfxEmitter e;
+        e.pos = sk.pos;
+        e.sfx = world.skullSfx;
+        e.key = 0x100 + i;
+        e.volume = 0.6f;
+        e.speed = 0.6f;
+        e.minDistance = 3.0f;
+        e.maxDistance = 30.0f;
+        e.priority = SFX_PRIORITY_EVENT;
+        AddSfxEmitter(world.sfx, e);
+    }
 
-                    if (!m.meshes.empty())
-                        m.meshes[0].Draw(s);
-                };
+    UpdateSfx(world.sfx, listenerPos, listenerForward);
 
-            for (auto& r : world.boulderWall)
-                DrawModel(*world.boulder, r.pos, world.boulderScale);
+    //ball impacts are played by their own thread straight from the solver's contacts
+    SetImpactListener(world.impactAudio, listenerPos);
+}
 
-            glBindVertexArray(world.sphereVAO);
-            for (auto& b : world.balls)
-            {
-                glm::mat4 mo(1);
-                mo = glm::translate(mo, b.pos);
-                mo = glm::scale(mo, glm::vec3(b.radius));
-                s.setMat4("model", mo);
-                glDrawArrays(GL_TRIANGLES, 0, world.sphereVertCount);
-            }
+void BuildRenderSnapshot(const World& world, RenderSnapshot& snap)
+{
+    snap.instances.clear();
+    for (int i = 0; i < (int)world.balls.size() && !world.gpuBallPhysics; ++i)
+    {
+        const auto& b = world.balls[i];
 
-            for (auto& g : world.grass)
-            {
-                glm::mat4 mo(1);
-                mo = glm::translate(mo, g.pos);
-                mo = glm::rotate(mo, glm::radians(g.rot), glm::vec3(0, 1, 0));
-                mo = glm::scale(mo, glm::vec3(g.scale));
-                s.setMat4("model", mo);
-
-                if (g.type == 0) world.grass1->Draw(s);
-                else if (g.type == 1) world.grass2->Draw(s);
-                else world.grass3->Draw(s);
-            }
+        glm::mat4 mo(1);
+        mo = glm::translate(mo, b.pos);
+        mo = glm::scale(mo, glm::vec3(b.radius));
 
-            if (world.cockroach && !world.cockroach->meshes.empty())
-            {
-                const float roachScale = 0.5f;
-                for (const auto& rInst : world.cockroaches)
-                {
-                    glm::mat4 mo(1.0f);
-                    glm::vec3 pos = rInst.pos;
+        glm::vec3 col = (i == world.goldenBallIndex)
+            ? glm::vec3(1.0f, 0.9f, 0.1f)
+            : glm::vec3(1.0f, 0.95f, 0.6f);
+        snap.instances.push_back({ mo, glm::vec4(col, 1.0f), world.ballGroup, 0 });
+    }
+    for (const auto& rInst : world.cockroaches)
+        snap.instances.push_back({ RoachMatrix(rInst), glm::vec4(1.0f), world.roachGroup, world.roachMaterial });
+    for (const auto& sInst : world.skulls)
+    {
+        if (!sInst.active) continue;
+        snap.instances.push_back({ SkullMatrix(sInst), glm::vec4(0.7f, 0.2f, 0.9f, 1.0f), world.skullGroup, 0 });
+    }
 
-                    mo = glm::translate(mo, pos);
+    snap.eye = world.player.pos + glm::vec3(0, 1, 0);
 
-                    if (rInst.dancing)
-                    {
-                        float t = rInst.time;
+    glm::vec3 col(0.7f, 0.2f, 0.9f);
+    if (world.skullModeActive)        col = glm::vec3(1.0f, 0.1f, 0.1f);  //active red
+    else if (world.skullModeSurvived) col = glm::vec3(0.1f, 1.0f, 0.1f);  //survived green
+    else if (world.skullModeFailed)   col = glm::vec3(0.4f, 0.4f, 0.4f);  //failed gray
+    snap.skullPillarColor = col;
 
-                        float hopBase = 1.6f;
-                        float hopHeight = 0.4f * std::sin(t * 12.0f);
-                        mo = glm::translate(mo, glm::vec3(0.0f, hopBase + hopHeight, 0.0f));
+    snap.qteVisible = world.qteVisible;
+    snap.qteInnerRadius = world.qteInnerRadius;
+    snap.qteOuterRadius = world.qteOuterRadius;
+    snap.starCount = world.starCount;
 
-                        mo = glm::rotate(mo, glm::radians(-80.0f), glm::vec3(1, 0, 0));
-                        mo = glm::rotate(mo, glm::radians(20.0f), glm::vec3(0, 0, 1));
-                        mo = glm::rotate(mo, t * 8.0f, glm::vec3(0, 0, 1));
-                    }
+    snap.goldenBall = world.goldenBallIndex;
+    snap.playerPos = world.player.pos;
+}
 
-                    mo = glm::scale(mo, glm::vec3(roachScale));
-                    s.setMat4("model", mo);
-                    world.cockroach->Draw(s);
-                }
-            }
-        };
+void RenderWorld(World& world,
+    const RenderSnapshot& snap,
+    const glm::mat4& lightSpace,
+    const glm::mat4& view,
+    const glm::mat4& proj,
+    unsigned int depthTex,
+    unsigned int depthFBO,
+    unsigned int SHW,
+    unsigned int SHH)
+{
+    //terrain LOD follows the camera in both passes
+    glm::vec3 eye = glm::vec3(glm::inverse(view)[3]);
+    SelectTerrainNodes(world.terrain, eye);
+
+    //main pass renders offscreen so its depth can feed the Hi-Z pyramid
+    int targetW, targetH;
+    ScaledTargetSize(world.post, world.screenWidth, world.screenHeight, targetW, targetH);
+    ResizeSceneTarget(world.sceneTarget, targetW, targetH);
+    ResizeHiZ(world.hiz, world.sceneTarget.width, world.sceneTarget.height);
+    const glm::mat4 viewProj = proj * view;
+
+    //dynamic instances, static grass/boulders are already resident
+    BeginSceneFrame(world.scene);
+    for (const auto& inst : snap.instances)
+        AddSceneInstance(world.scene, inst.group, inst.model, inst.color, inst.material);
+    UploadSceneInstances(world.scene);
+
+    //GPU ball pit catches up with the simulation and draws from its own buffers
+    if (world.gpuBallPhysics)
+    {
+        GpuBalls& gb = world.gpuBalls;
+        if (gb.golden >= 0 && snap.goldenBall != gb.golden)
+        {
+            HideGpuBall(gb, gb.golden);
+            gb.golden = snap.goldenBall;
+        }
+        StepGpuBalls(gb, snap.step, snap.playerPos, world.terrain);
+        WriteGpuBallInstances(gb, world.scene, world.ballGroup);
+        PollGpuBallReports(gb);
+    }
+
+    //GPU culling, the camera's early phase tests against last frame's pyramid
+    CullScene(world.scene, SCENE_PASS_SHADOW, lightSpace);
+    CullScene(world.scene, SCENE_PASS_CAMERA, viewProj, &world.hiz);
+
+    //shadow pass
+    glViewport(0, 0, SHW, SHH);
+    glBindFramebuffer(GL_FRAMEBUFFER, depthFBO);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    world.terrainDepthShader->use();
+    world.terrainDepthShader->setMat4("projection", lightSpace);
+    world.terrainDepthShader->setMat4("view", glm::mat4(1.0f));
+    DrawTerrain(world.terrain, *world.terrainDepthShader, eye);
+
+    world.depthShader->use();
+    world.depthShader->setMat4("projection", lightSpace);
+    world.depthShader->setMat4("view", glm::mat4(1.0f));
+    DrawScene(world.scene, SCENE_PASS_SHADOW);
 
-    DrawDepth(depthShader);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
     //main pass
 
-    glViewport(0, 0, world.screenWidth, world.screenHeight);
+    glBindFramebuffer(GL_FRAMEBUFFER, world.sceneTarget.fbo);
+    glViewport(0, 0, world.sceneTarget.width, world.sceneTarget.height);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    shader.use();
-    shader.setMat4("projection", proj);
-    shader.setMat4("view", view);
-    shader.setMat4("lightSpaceMatrix", lightSpace);
-
-    //QTE circle
-    shader.setInt("qteVisible", world.qteVisible ? 1 : 0);
-    shader.setFloat("qteInnerRadius", world.qteInnerRadius);
-    shader.setFloat("qteOuterRadius", world.qteOuterRadius);
-    shader.setVec3("qteInnerColor", glm::vec3(1.0f, 1.0f, 1.0f));   //white inner
-    shader.setVec3("qteOuterColor", glm::vec3(1.0f, 0.2f, 0.2f));   //red outer
-
-    //aspect ratio for QTE circle
-    float aspect = (world.screenHeight != 0)
-        ? static_cast<float>(world.screenWidth) / static_cast<float>(world.screenHeight)
-        : 800.0f / 600.0f;
-    shader.setFloat("qteAspect", aspect);
-    shader.setVec2("qteScreenSize", glm::vec2(world.screenWidth, world.screenHeight));
-
-    shader.setInt("shadowMap", 1);
-    shader.setInt("groundTex", 2);
-
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, depthTex);
 
     glActiveTexture(GL_TEXTURE2);
     glBindTexture(GL_TEXTURE_2D, world.groundTex);
 
+    //texture arrays and the material table, every textured draw below
+    BindMaterials(world.materials);
+
     //ground
-    glm::mat4 GM(1);
-    GM = glm::scale(GM, glm::vec3(100, 1, 100));
-    shader.setMat4("model", GM);
-    shader.setVec3("overrideColor", glm::vec3(-1));
-    shader.setInt("useTexture", 1);
-    glBindVertexArray(world.planeVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    {
+        Shader& ts = *world.terrainShader;
+        SetLitUniforms(world, ts, view, proj, lightSpace);
+        DrawTerrain(world.terrain, ts, eye);
+    }
+
+    //grass, boulders, balls, roaches and skulls in one indirect draw per phase
+    auto DrawInstanced = [&](ScenePass pass)
+        {
+            Shader& is = *world.instancedShader;
+            SetLitUniforms(world, is, view, proj, lightSpace);
+            DrawScene(world.scene, pass);
+        };
+
+    DrawInstanced(SCENE_PASS_CAMERA);
+
+    //classic draws, each uses the permutation for its colour source
+    for (Shader* lit : world.litShaders)
+        SetLitUniforms(world, *lit, view, proj, lightSpace);
+
+    Shader& shader = *world.litShaders[LIT_COLOR];
+    shader.use();
+
+    //every classic draw below comes out of the shared arena, one VAO bind
+    BindGeometry(world.geometry);
 
     //ball pit box
     {
@@ -1035,14 +1413,10 @@ void RenderWorld(World& world,
         mo = glm::translate(mo, glm::vec3(pitCenter.x, 0.0f, pitCenter.z));
         mo = glm::scale(mo, glm::vec3(pitRadius, pitHeight, pitRadius));
 
-        shader.setMat4("model", mo);
-        shader.setInt("useTexture", 0);
+        SetModelMatrix(shader, mo);
         shader.setVec3("overrideColor", glm::vec3(0.2f, 0.6f, 1.0f));
 
-        glBindVertexArray(world.pitVAO);
-        glDrawArrays(GL_TRIANGLES, 0, world.pitVertCount);
-
-        shader.setVec3("overrideColor", glm::vec3(-1.0f));
+        DrawGeometry(world.pitMesh);
     }
 
     //me
@@ -1068,106 +1442,18 @@ void RenderWorld(World& world,
 
         mo = glm::scale(mo, glm::vec3(imgWidth, imgHeight, 1.0f));
 
-        shader.setMat4("model", mo);
-
-        shader.setVec3("overrideColor", glm::vec3(-1.0f));
-        shader.setInt("useTexture", 1);
+        Shader& imageShader = *world.litShaders[LIT_GROUND];
+        imageShader.use();
+        SetModelMatrix(imageShader, mo);
 
         glActiveTexture(GL_TEXTURE2);
         glBindTexture(GL_TEXTURE_2D, world.meTex);
 
-        glBindVertexArray(world.uiQuadVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        DrawGeometry(world.quadMesh);
 
         //ground texture
         glBindTexture(GL_TEXTURE_2D, world.groundTex);
-        glBindVertexArray(0);
-        shader.setInt("useTexture", 0);
-    }
-
-    //grass
-    shader.setInt("useTexture", 0);
-    for (auto& g : world.grass)
-    {
-        glm::mat4 mo(1);
-        mo = glm::translate(mo, g.pos);
-        mo = glm::rotate(mo, glm::radians(g.rot), glm::vec3(0, 1, 0));
-        mo = glm::scale(mo, glm::vec3(g.scale));
-        shader.setMat4("model", mo);
-        shader.setVec3("overrideColor", glm::vec3(0.1f, 0.7f, 0.1f));
-
-        if (g.type == 0) world.grass1->Draw(shader);
-        else if (g.type == 1) world.grass2->Draw(shader);
-        else world.grass3->Draw(shader);
-    }
-    shader.setVec3("overrideColor", glm::vec3(-1.0f));
-    shader.setInt("useTexture", 0);
-
-    //boulders
-    for (auto& r : world.boulderWall)
-    {
-        glm::mat4 mo(1);
-        mo = glm::translate(mo, r.pos);
-        mo = glm::scale(mo, glm::vec3(world.boulderScale));
-        shader.setMat4("model", mo);
-
-        shader.setVec3("overrideColor", glm::vec3(0.5f));
-        if (!world.boulder->meshes.empty())
-            world.boulder->meshes[0].Draw(shader);
-    }
-
-    //balls
-    glBindVertexArray(world.sphereVAO);
-    for (int i = 0; i < (int)world.balls.size(); ++i)
-    {
-        const auto& b = world.balls[i];
-
-        glm::mat4 mo(1);
-        mo = glm::translate(mo, b.pos);
-        mo = glm::scale(mo, glm::vec3(b.radius));
-        shader.setMat4("model", mo);
-
-        if (i == world.goldenBallIndex)
-            shader.setVec3("overrideColor", glm::vec3(1.0f, 0.9f, 0.1f));
-        else
-            shader.setVec3("overrideColor", glm::vec3(1.0f, 0.95f, 0.6f));
-
-        glDrawArrays(GL_TRIANGLES, 0, world.sphereVertCount);
-    }
-    shader.setVec3("overrideColor", glm::vec3(-1.0f));
-
-    //roaches
-    if (world.cockroach && !world.cockroach->meshes.empty())
-    {
-        const float roachScale = 0.5f;
-
-        for (const auto& rInst : world.cockroaches)
-        {
-            glm::mat4 mo(1.0f);
-            glm::vec3 pos = rInst.pos;
-
-            mo = glm::translate(mo, pos);
-
-            if (rInst.dancing)
-            {
-                float t = rInst.time;
-
-                float hopBase = 1.6f;
-                float hopHeight = 0.4f * std::sin(t * 12.0f);
-                mo = glm::translate(mo, glm::vec3(0.0f, hopBase + hopHeight, 0.0f));
-
-                mo = glm::rotate(mo, glm::radians(-80.0f), glm::vec3(1, 0, 0));
-                mo = glm::rotate(mo, glm::radians(20.0f), glm::vec3(0, 0, 1));
-                mo = glm::rotate(mo, t * 8.0f, glm::vec3(0, 0, 1));
-            }
-
-            mo = glm::scale(mo, glm::vec3(roachScale));
-            shader.setMat4("model", mo);
-
-            shader.setVec3("overrideColor", glm::vec3(-1.0f));
-            shader.setInt("useTexture", 0);
-            world.cockroach->Draw(shader);
-        }
+        shader.use();
     }
 
     //QTE pillar
@@ -1182,11 +1468,10 @@ void RenderWorld(World& world,
         mo = glm::translate(mo, glm::vec3(pos.x, pos.y, pos.z));
         mo = glm::scale(mo, glm::vec3(pillarHalfSize, pillarHeight, pillarHalfSize));
 
-        shader.setMat4("model", mo);
+        SetModelMatrix(shader, mo);
         shader.setVec3("overrideColor", glm::vec3(0.9f, 0.9f, 0.4f));
 
-        glBindVertexArray(world.pitVAO);
-        glDrawArrays(GL_TRIANGLES, 0, world.pitVertCount);
+        DrawGeometry(world.pitMesh);
 
         //button
         {
@@ -1207,14 +1492,14 @@ void RenderWorld(World& world,
             btn = glm::translate(btn, buttonPos);
             btn = glm::scale(btn, glm::vec3(buttonSize, buttonSize, buttonDepth));
 
-            shader.setMat4("model", btn);
+            SetModelMatrix(shader, btn);
             shader.setVec3("overrideColor", glm::vec3(1.0f, 0.2f, 0.2f)); //red
-            glDrawArrays(GL_TRIANGLES, 0, world.pitVertCount);
+            DrawGeometry(world.pitMesh);
         }
 
         //red sphere on top of the pillar
         {
-            if (world.sphereVAO && world.sphereVertCount > 0)
+            if (world.sphereMesh.indexCount > 0)
             {
                 glm::mat4 sphereM(1.0f);
 
@@ -1229,48 +1514,15 @@ void RenderWorld(World& world,
                 sphereM = glm::translate(sphereM, topPos);
                 sphereM = glm::scale(sphereM, glm::vec3(sphereRadius));
 
-                shader.setMat4("model", sphereM);
+                SetModelMatrix(shader, sphereM);
                 shader.setVec3("overrideColor", glm::vec3(1.0f, 0.1f, 0.1f)); //red
 
-                glBindVertexArray(world.sphereVAO);
-                glDrawArrays(GL_TRIANGLES, 0, world.sphereVertCount);
+                DrawGeometry(world.sphereMesh);
             }
         }
-
-        glBindVertexArray(0);
-        shader.setVec3("overrideColor", glm::vec3(-1.0f));
     }
 
 
-    //skulls
-    if (world.skull && !world.skull->meshes.empty())
-    {
-        const float skullScale = 0.6f;
-        for (const auto& sInst : world.skulls)
-        {
-            if (!sInst.active) continue;
-
-            glm::mat4 mo(1.0f);
-            mo = glm::translate(mo, sInst.pos);
-
-			//face towards movement direction
-            glm::vec3 dir = glm::normalize(sInst.vel);
-            if (glm::length(dir) > 0.0001f)
-            {
-                float yaw = std::atan2(dir.x, dir.z);
-                mo = glm::rotate(mo, yaw, glm::vec3(0, 1, 0));
-            }
-
-            mo = glm::scale(mo, glm::vec3(skullScale));
-            shader.setMat4("model", mo);
-
-            shader.setVec3("overrideColor", glm::vec3(0.7f, 0.2f, 0.9f));
-            world.skull->Draw(shader);
-        }
-
-        shader.setVec3("overrideColor", glm::vec3(-1.0f));
-    }
-
     //pillar where you stand to start skull mode
     {
         glm::mat4 mo(1.0f);
@@ -1281,17 +1533,11 @@ void RenderWorld(World& world,
 
         mo = glm::translate(mo, glm::vec3(pos.x, pos.y, pos.z));
         mo = glm::scale(mo, glm::vec3(pillarHalfSize, pillarHeight, pillarHalfSize));
-        shader.setMat4("model", mo);
-
-        glm::vec3 col(0.7f, 0.2f, 0.9f);                  
-        if (world.skullModeActive)        col = glm::vec3(1.0f, 0.1f, 0.1f);  //active red
-        else if (world.skullModeSurvived) col = glm::vec3(0.1f, 1.0f, 0.1f);  //survived green
-        else if (world.skullModeFailed)   col = glm::vec3(0.4f, 0.4f, 0.4f);  //failed gray
+        SetModelMatrix(shader, mo);
 
-        shader.setVec3("overrideColor", col);
+        shader.setVec3("overrideColor", snap.skullPillarColor);
 
-        glBindVertexArray(world.pitVAO);
-        glDrawArrays(GL_TRIANGLES, 0, world.pitVertCount);
+        DrawGeometry(world.pitMesh);
 
         //square same position as QTE
         {
@@ -1311,9 +1557,9 @@ void RenderWorld(World& world,
             btn = glm::translate(btn, buttonPos);
             btn = glm::scale(btn, glm::vec3(buttonSize, buttonSize, buttonDepth));
 
-            shader.setMat4("model", btn);
+            SetModelMatrix(shader, btn);
             shader.setVec3("overrideColor", glm::vec3(1.0f, 0.2f, 0.2f)); // red
-            glDrawArrays(GL_TRIANGLES, 0, world.pitVertCount);
+            DrawGeometry(world.pitMesh);
         }
 
         //skull ontop of pillar
@@ -1335,34 +1581,59 @@ void RenderWorld(World& world,
             float skullScaleTop = 0.8f;
             skullM = glm::scale(skullM, glm::vec3(skullScaleTop));
 
-            shader.setMat4("model", skullM);
-            shader.setVec3("overrideColor", glm::vec3(-1.0f));
-            world.skull->Draw(shader);
+            Shader& skullShader = *world.litShaders[LIT_DIFFUSE];
+            skullShader.use();
+            SetModelMatrix(skullShader, skullM);
+
+            //the skull's meshes are the batches of its scene group, untextured
+            //ones stay white
+            const SceneGroup& group = world.scene.groups[world.skullGroup];
+            skullShader.setVec3("overrideColor", glm::vec3(1.0f));
+            for (unsigned int m = 0; m < group.batchCount; ++m)
+            {
+                skullShader.setInt("material", world.skullMaterials[m]);
+                DrawGeometry(SceneBatchRange(world.scene, group.firstBatch + m));
+            }
         }
 
         glBindVertexArray(0);
-        shader.setVec3("overrideColor", glm::vec3(-1.0f));
     }
 
+    //late phase, re-test what the early phase rejected against this frame's depth
+    BuildHiZ(world.hiz, world.sceneTarget.depthTex, world.sceneTarget.width, world.sceneTarget.height, viewProj);
+    CullScene(world.scene, SCENE_PASS_CAMERA_LATE, viewProj, &world.hiz);
+    DrawInstanced(SCENE_PASS_CAMERA_LATE);
 
+    //pyramid for next frame's early phase
+    BuildHiZ(world.hiz, world.sceneTarget.depthTex, world.sceneTarget.width, world.sceneTarget.height, viewProj);
 
+    //retro quantize, tonemap and FXAA in one pass, upscaling to the window
+    PresentSceneTarget(world.sceneTarget, *world.postShader, world.post, world.screenWidth, world.screenHeight);
 
-    //star counter in top right
+    //HUD at window resolution on top of the post processed image
     {
         float w = static_cast<float>(world.screenWidth);
         float h = static_cast<float>(world.screenHeight);
 
-        glm::mat4 uiProj = glm::ortho(0.0f, w, 0.0f, h);
+        BeginOverlay(world.overlay);
 
-        shader.use();
-        shader.setInt("isUI", 1);
-        shader.setMat4("uiProjection", uiProj);
+        //QTE circle, radii are in half screen heights so it stays round
+        if (snap.qteVisible)
+        {
+            glm::vec2 centre(w * 0.5f, h * 0.5f);
+            float unit = h * 0.5f;
 
-        //star size and padding in pixels
+            OverlayCircle(world.overlay, OVERLAY_DISC, centre, unit,
+                -1.0f, snap.qteInnerRadius, glm::vec4(1.0f, 1.0f, 1.0f, 0.8f));     //white inner
+            OverlayCircle(world.overlay, OVERLAY_RING, centre, unit,
+                snap.qteInnerRadius, snap.qteOuterRadius, glm::vec4(1.0f, 0.2f, 0.2f, 0.8f));   //red outer
+        }
+
+        //star counter in top right
         float starSize = 32.0f;
         float padding = 8.0f;
 
-        int starsToDraw = std::min(world.starCount, 4);
+        int starsToDraw = std::min(snap.starCount, 4);
 
         for (int i = 0; i < starsToDraw; ++i)
         {
@@ -1370,26 +1641,9 @@ void RenderWorld(World& world,
             float x = w - padding - starSize * (i + 1);
             float y = h - padding - starSize;
 
-            glm::mat4 m(1.0f);
-            m = glm::translate(m, glm::vec3(x, y, 0.0f));
-            m = glm::scale(m, glm::vec3(starSize, starSize, 1.0f));
-
-            shader.setMat4("model", m);
-
-            //golden color
-            shader.setVec3("overrideColor", glm::vec3(1.0f, 0.9f, 0.3f));
-            shader.setInt("useTexture", 0);
-
-            glBindVertexArray(world.uiQuadVAO);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+            OverlayStar(world.overlay, glm::vec2(x, y), starSize, glm::vec4(1.0f, 0.9f, 0.3f, 1.0f));
         }
 
-        glBindVertexArray(0);
-
-        //reset to normal 3D rendering state
-        shader.setInt("isUI", 0);
-        shader.setVec3("overrideColor", glm::vec3(-1.0f));
+        DrawOverlay(world.overlay, world.screenWidth, world.screenHeight);
     }
-
-    shader.setVec3("overrideColor", glm::vec3(-1));
 }
\ No newline at end of file
@@ -1,8 +1,21 @@
 ﻿#pragma once
+#include <random>
 #include <vector>
 #include <glm/glm.hpp>
 #include "shader_m.h"
 #include "Physics.h"
+#include "Solver.h"
+#include "Terrain.h"
+#include "GpuScene.h"
+#include "GpuBalls.h"
+#include "HiZ.h"
+#include "RenderTarget.h"
+#include "Overlay.h"
+#include "ShaderCache.h"
+#include "Sfx.h"
+#include "ImpactAudio.h"
+#include "MappedFiles.h"
+#include "Materials.h"
 #include <irrKlang.h>
 
 class Model;
@@ -31,26 +44,96 @@ struct SkullInstance
     bool      active = false;
 };
 
+//model_loading.frag permutations for the classic per object draws
+enum LitVariant
+{
+    LIT_COLOR = 0,      //flat overrideColor
+    LIT_GROUND,         //whatever is bound as groundTex
+    LIT_DIFFUSE,        //material uniform, see MaterialRegistry
+    LIT_VARIANT_COUNT
+};
+
+//voice stealing order, higher keeps its voice
+enum SfxPriority
+{
+    SFX_PRIORITY_FOOTSTEP = 1,
+    SFX_PRIORITY_EVENT = 5,
+    SFX_PRIORITY_MUSIC = 10
+};
+
 struct World {
     PhysicsBody                player;
     std::vector<PhysicsBody>   boulderWall;
     std::vector<Sphere>        balls;
     std::vector<GrassInstance> grass;
 
+    //layout and skull spawn randomness, seeded by main; the standard rand
+    //state is per thread on MSVC. The placement task uses it during InitWorld,
+    //the simulation thread owns it once started
+    std::mt19937 rng;
+
     int screenWidth = 800;
     int screenHeight = 600;
 
-    unsigned int planeVAO = 0, planeVBO = 0;
-    unsigned int sphereVAO = 0, sphereVBO = 0;
-    int          sphereVertCount = 0;
+    //specialised lit programs and the instanced shadow depth program
+    Shader*      litShaders[LIT_VARIANT_COUNT] = {};
+    Shader*      depthShader = nullptr;
+
+    //heightfield ground
+    Terrain      terrain;
+    Shader*      terrainShader = nullptr;
+    Shader*      terrainDepthShader = nullptr;
+    glm::vec3    lightDir = glm::vec3(0, -1, 0);
+
+    //GPU culled instanced props
+    GpuScene     scene;
+    Shader*      instancedShader = nullptr;
+    int          grassGroup[3] = { -1, -1, -1 };
+    int          boulderGroup = -1;
+    int          ballGroup = -1;
+    int          roachGroup = -1;
+    int          skullGroup = -1;
+
+    //every textured draw samples through here, instances and draws carry an index
+    MaterialRegistry materials;
+    int          roachMaterial = 0;
+    std::vector<int> skullMaterials;    //per skull mesh
+
+    //offscreen main pass and its depth pyramid for occlusion culling
+    SceneTarget  sceneTarget;
+    HiZPyramid   hiz;
+
+    //fused post chain and the internal render scale
+    PostSettings post;
+    Shader*      postShader = nullptr;
+
+    //SceneVertex arena every model and procedural mesh is drawn from
+    GeometryArena geometry;
+    GeometryRange sphereMesh;
+    GeometryRange pitMesh;      //unit box, also the pillars and buttons
+    GeometryRange pedestalMesh;
+    GeometryRange quadMesh;     //the picture by the pit
+
     unsigned int groundTex = 0;
 
     //ball pit parameters
-    unsigned int pitVAO = 0;
-    unsigned int pitVBO = 0;
-    int          pitVertCount = 0;
     std::vector<PhysicsBody>  ballPitWalls;
 
+    //player, boulders and pit walls packed for the batched narrow phase;
+    //false runs the per box ResolveSphereAABB loops instead
+    AABBBatch ballColliders;
+    bool      batchedColliders = true;
+
+    //ball pairs, contacts and their impulses carry over between steps
+    BallSolver ballSolver;
+
+    //--gpu-balls: the pit plus gpuBallCount more balls run in balls.comp on
+    //the render thread, the simulation only sees the golden ball and the
+    //player's contacts through the readback
+    bool     gpuBallPhysics = false;
+    int      gpuBallCount = 100000;
+    GpuBalls gpuBalls;
+
     glm::vec3 pedestalPos = glm::vec3(15.0f, 0.0f, -5.0f);
 
     bool  qteActive = false;  
@@ -65,9 +148,6 @@ struct World {
     bool  qteThisRoundHit = false;  
     bool  qteCompleted = false;  
 
-    unsigned int pedestalVAO = 0;
-    unsigned int pedestalVBO = 0;
-
     //star system
     int  starCount = 0;
 
@@ -102,23 +182,34 @@ struct World {
     bool      cockroachDance = false;
     float     cockroachTime = 0.0f;
 
-    //UI quad
-    unsigned int uiQuadVAO = 0;
-    unsigned int uiQuadVBO = 0;
+    //the HUD is batched separately
+    Overlay      overlay;
 
     std::vector<CockroachInstance> cockroaches;
 
     //audio (irrKlang)
     ISoundEngine* soundEngine = nullptr;
-    irrklang::ISound* cucarachaSound = nullptr;
+    MappedFileFactory* assetFiles = nullptr;    //owned by soundEngine
+    bool  cucarachaPlaying = false;
     float cucarachaTimer = 0.0f;
 
 
+    //preloaded SFX and their voice pool
+    SfxBank    sfx;
+
     //footstep SFX
     float footstepTimer = 0.0f;
     float footstepInterval = 0.45f;
     glm::vec3 lastPlayerPos = glm::vec3(0.0f);
     int footstepIndex = 0;
+    SfxHandle  footstepSfx[4] = { -1, -1, -1, -1 };
+    SfxHandle  impactSfx = -1;
+    SfxHandle  skullSfx = -1;
+    SfxHandle  cucarachaSfx = -1;
+
+    //pitched ball impacts, driven by the solver's contact events
+    ImpactAudio impactAudio;
+    SfxVoiceId footstepVoice;
 
 
     //skull attack mode
@@ -135,15 +226,53 @@ struct World {
     std::vector<SkullInstance> skulls;
 };
 
+//one dynamic prop as the render thread sees it
+struct SnapshotInstance
+{
+    glm::mat4 model;
+    glm::vec4 color;
+    int       group;
+    int       material;
+};
+
+//everything RenderWorld reads that the simulation changes, copied out once
+//per step and never written again after it is published
+struct RenderSnapshot
+{
+    std::vector<SnapshotInstance> instances;    //balls, roaches and live skulls
+
+    glm::vec3 eye = glm::vec3(0, 2, 8);
+
+    //newest input this step applied, for input to present latency
+    double inputTime = 0.0;     //held keys sample
+    double eventTime = 0.0;     //last E press handled
+    glm::vec3 skullPillarColor = glm::vec3(0.7f, 0.2f, 0.9f);
+
+    bool  qteVisible = false;
+    float qteInnerRadius = 0.0f;
+    float qteOuterRadius = 0.0f;
+    int   starCount = 0;
+
+    //GPU ball pit inputs
+    int       goldenBall = -1;
+    glm::vec3 playerPos = glm::vec3(0.0f);
+
+    unsigned long long step = 0;
+};
+
 void GenerateSphereMesh(World& world, int lat = 20, int lon = 20);
-void GeneratePlane(World& world);
 unsigned int LoadTexture(const char* path);
 
 void InitWorld(World& world);
 void UpdateWorld(World& world, float dt);
+void UpdateAudio(World& world, const glm::vec3& listenerPos, const glm::vec3& listenerForward);
+
+//reuses the snapshot's storage, so a recycled slot does not allocate
+void BuildRenderSnapshot(const World& world, RenderSnapshot& snap);
+
+//only reads the snapshot and render owned state, safe while the simulation steps
 void RenderWorld(World& world,
-    Shader& shader,
-    Shader& depthShader,
+    const RenderSnapshot& snap,
     const glm::mat4& lightSpace,
     const glm::mat4& view,
     const glm::mat4& proj,
@@ -152,9 +281,13 @@ void RenderWorld(World& world,
     unsigned int SHW,
     unsigned int SHH);
 
-//QTE input handler (used from main.cpp)
-void HandleQTEInput(World& world);
+//E press: roach dance, golden ball, then the QTE and skull mode handlers;
+//lateBy is how long ago the press happened, timed checks are judged then
+void HandleInteractInput(World& world, float lateBy = 0.0f);
+
+//QTE input handler
+void HandleQTEInput(World& world, float lateBy = 0.0f);
 
 
-//skull mode input handler (used from main.cpp)
-void HandleSkullModeInput(World& world);
\ No newline at end of file
+//skull mode input handler
+void HandleSkullModeInput(World& world, float lateBy = 0.0f);
\ No newline at end of file
@@ -6,9 +6,10 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-#include <shader.h>
+#include <shader_m.h>
 
 #include <string>
+#include <utility>
 #include <vector>
 using namespace std;
 
@@ -43,22 +44,48 @@ public:
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
-    unsigned int VAO;
+    vector<glm::vec3>    positions;     // compact copy kept by releaseGeometry(true)
+    unsigned int VAO = 0;
 
-    // constructor
+    // constructor, callers hand their buffers over with std::move
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+        : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures))
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        // GL buffers are only created if the mesh is drawn on its own (see Draw); the game
+        // draws models out of its shared geometry arena instead
+    }
+
+    // drops the full CPU vertices once they have been copied to the GPU. keepPositions
+    // keeps positions and indices for CPU queries (12 bytes a vertex instead of sizeof(Vertex))
+    void releaseGeometry(bool keepPositions = false)
+    {
+        if (keepPositions)
+        {
+            positions.reserve(vertices.size());
+            for (const Vertex& v : vertices)
+                positions.push_back(v.Position);
+        }
+        else
+        {
+            vector<unsigned int>().swap(indices);
+        }
+        vector<Vertex>().swap(vertices);
+    }
 
-        // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+    // resident CPU memory of the geometry, textures not included
+    size_t cpuBytes() const
+    {
+        return vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(unsigned int)
+            + positions.capacity() * sizeof(glm::vec3);
     }
 
     // render the mesh
     void Draw(Shader &shader) 
     {
+        // nothing left to upload once the geometry was released
+        if (!VAO && vertices.empty())
+            return;
+
         // bind appropriate textures
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
@@ -86,6 +113,8 @@ public:
         }
         
         // draw mesh
+        if (!VAO)
+            setupMesh();
         glBindVertexArray(VAO);
         glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
         glBindVertexArray(0);
@@ -96,7 +125,7 @@ public:
 
 private:
     // render data 
-    unsigned int VBO, EBO;
+    unsigned int VBO = 0, EBO = 0;
 
     // initializes all the buffer objects/arrays
     void setupMesh()
@@ -11,7 +11,9 @@
 #include <assimp/postprocess.h>
 
 #include <mesh.h>
-#include <shader.h>
+#include <shader_m.h>
+#include "AssetPack.h"
+#include "Textures.h"
 
 #include <string>
 #include <fstream>
@@ -27,7 +29,7 @@ class Model
 {
 public:
     // model data 
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<Texture> textures_loaded;	// texture cache references held by this model
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
@@ -38,6 +40,31 @@ public:
         loadModel(path);
     }
 
+    ~Model()
+    {
+        for (const Texture& texture : textures_loaded)
+            ReleaseTexture(texture.id);
+    }
+
+    // owns its texture references
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
+    // frees the CPU vertex copies once the meshes live on the GPU, see Mesh::releaseGeometry
+    void releaseGeometry(bool keepPositions = false)
+    {
+        for (Mesh& mesh : meshes)
+            mesh.releaseGeometry(keepPositions);
+    }
+
+    size_t cpuBytes() const
+    {
+        size_t bytes = 0;
+        for (const Mesh& mesh : meshes)
+            bytes += mesh.cpuBytes();
+        return bytes;
+    }
+
     // draws the model, and thus all its meshes
     void Draw(Shader &shader)
     {
@@ -51,6 +78,7 @@ private:
     {
         // read file via ASSIMP
         Assimp::Importer importer;
+        importer.SetIOHandler(CreateAssetIOSystem()); // read the model and its materials through the asset packs
         const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
@@ -61,7 +89,8 @@ private:
         // retrieve the directory path of the filepath
         directory = path.substr(0, path.find_last_of('/'));
 
-        // process ASSIMP's root node recursively
+        // process ASSIMP's root node recursively, meshes are moved in as they are built
+        meshes.reserve(scene->mNumMeshes);
         processNode(scene->mRootNode, scene);
     }
 
@@ -90,6 +119,8 @@ private:
         vector<Vertex> vertices;
         vector<unsigned int> indices;
         vector<Texture> textures;
+        vertices.reserve(mesh->mNumVertices);
+        indices.reserve(mesh->mNumFaces * 3); // triangulated on import
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -165,7 +196,7 @@ private:
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
         
         // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        return Mesh(std::move(vertices), std::move(indices), std::move(textures));
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -177,26 +208,14 @@ private:
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
-            }
+            // the process wide texture cache resolves repeats by path or content in O(1),
+            // every texture here holds one reference, dropped when the model goes away
+            Texture texture;
+            texture.id = TextureFromFile(str.C_Str(), this->directory);
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            textures.push_back(texture);
+            textures_loaded.push_back(texture);
         }
         return textures;
     }
@@ -208,37 +227,10 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
+    // prefers a block compressed .dds with prebuilt mips next to the image (tools/texconvert)
+    unsigned int textureID = LoadTextureFile(filename.c_str());
+    if (!textureID)
         std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
 
     return textureID;
 }
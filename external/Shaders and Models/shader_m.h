@@ -13,6 +13,9 @@ class Shader
 {
 public:
     unsigned int ID;
+    // empty shader, the program is attached later (e.g. by the program binary cache)
+    // ------------------------------------------------------------------------
+    Shader() : ID(0) {}
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath)
@@ -8,19 +8,191 @@
 #include <memory.h>
 #include <stdlib.h> // free, malloc and realloc
 #include <string.h>
+#include <stdio.h>
+#include <algorithm>
 
 namespace irrklang
 {
 
+// frame header fields needed to walk a stream without decoding it
+struct SMP3FrameHeader
+{
+	int Version;		// 3 = MPEG 1, 2 = MPEG 2, 0 = MPEG 2.5
+	int Layer;
+	int SampleRate;
+	int Channels;
+	int BitRate;
+	int Bytes;
+	int Samples;
+	int SideInfoSize;
+};
+
+// kbit/s, [lsf][layer-1][index]
+static const int MP3BitRates[2][3][15] =
+{
+	{
+		{ 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },
+		{ 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 },
+		{ 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 }
+	},
+	{
+		{ 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256 },
+		{ 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+		{ 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 }
+	}
+};
+
+static const int MP3SampleRates[3] = { 44100, 48000, 32000 };
+
+// returns false for anything that is not a frame header we can size,
+// free format streams (bitrate index 0) included
+static bool parseMP3FrameHeader(const ik_u8* h, SMP3FrameHeader& out)
+{
+	if (h[0] != 0xFF || (h[1] & 0xE0) != 0xE0)
+		return false;
+
+	const int version = (h[1] >> 3) & 3;
+	const int layerBits = (h[1] >> 1) & 3;
+	const int bitRateIndex = h[2] >> 4;
+	const int sampleRateIndex = (h[2] >> 2) & 3;
+
+	if (version == 1 || layerBits == 0 || bitRateIndex == 0 || bitRateIndex == 15 || sampleRateIndex == 3)
+		return false;
+
+	const int lsf = version != 3 ? 1 : 0;
+	const int padding = (h[2] >> 1) & 1;
+
+	out.Version = version;
+	out.Layer = 4 - layerBits;
+	out.SampleRate = MP3SampleRates[sampleRateIndex] >> (version == 3 ? 0 : (version == 2 ? 1 : 2));
+	out.Channels = (h[3] >> 6) == 3 ? 1 : 2;
+
+	const int bitRate = MP3BitRates[lsf][out.Layer - 1][bitRateIndex] * 1000;
+	out.BitRate = bitRate;
+
+	if (out.Layer == 1)
+	{
+		out.Bytes = (12 * bitRate / out.SampleRate + padding) * 4;
+		out.Samples = 384;
+	}
+	else
+	if (out.Layer == 2)
+	{
+		out.Bytes = 144 * bitRate / out.SampleRate + padding;
+		out.Samples = 1152;
+	}
+	else
+	{
+		out.Bytes = (lsf ? 72 : 144) * bitRate / out.SampleRate + padding;
+		out.Samples = lsf ? 576 : 1152;
+	}
+
+	if (out.Layer == 3)
+		out.SideInfoSize = lsf ? (out.Channels == 1 ? 9 : 17) : (out.Channels == 1 ? 17 : 32);
+	else
+		out.SideInfoSize = 0;
+
+	return true;
+}
+
+static bool isSameMP3Stream(const SMP3FrameHeader& a, const SMP3FrameHeader& b)
+{
+	return a.Version == b.Version && a.Layer == b.Layer && a.SampleRate == b.SampleRate;
+}
+
+static int readBigEndian32(const ik_u8* p)
+{
+	return (int)(((ik_u32)p[0] << 24) | ((ik_u32)p[1] << 16) | ((ik_u32)p[2] << 8) | (ik_u32)p[3]);
+}
+
+static int readBigEndian16(const ik_u8* p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+//! random access reads for the frame index scan, which must not disturb the playing stream
+class CMP3ScanSource
+{
+public:
+	virtual ~CMP3ScanSource() {}
+
+	//! returns up to size bytes at offset, valid until the next call
+	virtual const ik_u8* readAt(int offset, int size, int& length) = 0;
+};
+
+// separate handle on the same file, lets the scan run beside playback
+class CMP3ScanSourceStdio : public CMP3ScanSource
+{
+public:
+	CMP3ScanSourceStdio(FILE* file) : File(file) {}
+	~CMP3ScanSourceStdio() { fclose(File); }
+
+	virtual const ik_u8* readAt(int offset, int size, int& length)
+	{
+		Buffer.resize(size);
+		length = 0;
+		if (fseek(File, offset, SEEK_SET) == 0)
+			length = (int)fread(&Buffer[0], 1, size, File);
+		return &Buffer[0];
+	}
+
+private:
+	FILE* File;
+	std::vector<ik_u8> Buffer;
+};
+
+// the stream's own reader, only used on the decoding thread
+class CMP3ScanSourceReader : public CMP3ScanSource
+{
+public:
+	CMP3ScanSourceReader(IFileReader* file) : File(file) {}
+
+	virtual const ik_u8* readAt(int offset, int size, int& length)
+	{
+		Buffer.resize(size);
+		length = 0;
+		if (File->seek(offset))
+			length = File->read(&Buffer[0], size);
+		return &Buffer[0];
+	}
+
+private:
+	IFileReader* File;
+	std::vector<ik_u8> Buffer;
+};
+
+// mapped files are read in place, from any thread
+class CMP3ScanSourceMemory : public CMP3ScanSource
+{
+public:
+	CMP3ScanSourceMemory(const ik_u8* data, int size) : Data(data), Size(size) {}
+
+	virtual const ik_u8* readAt(int offset, int size, int& length)
+	{
+		length = offset < Size ? (size < Size - offset ? size : Size - offset) : 0;
+		return Data + offset;
+	}
+
+private:
+	const ik_u8* Data;
+	int Size;
+};
+
+
 CIrrKlangAudioStreamMP3::CIrrKlangAudioStreamMP3(IFileReader* file)
 : File(file), TheMPAuDecContext(0), InputPosition(0), InputLength(0),
 	DecodeBuffer(0), FirstFrameRead(false), EndOfFileReached(0),
-	FileBegin(0), Position(0)
+	FileBegin(0), Position(0), IndexComplete(false), StopIndexing(false),
+	FirstFrameOffset(0), SamplesPerFrame(0), ConstantFrameBytes(0), Input(InputBuffer), MappedData(0)
 {
 	if (File)
 	{
 		File->grab();
 
+		IMappedFileReader* mapped = dynamic_cast<IMappedFileReader*>(File);
+		if (mapped)
+			MappedData = mapped->getData();
+
 		TheMPAuDecContext = new MPAuDecContext();
 
 		if (!TheMPAuDecContext || mpaudec_init(TheMPAuDecContext) < 0)
@@ -38,35 +210,29 @@ CIrrKlangAudioStreamMP3::CIrrKlangAudioStreamMP3(IFileReader* file)
 
 		if (File->getSize()>0)
 		{
-			// seekable file, now parse file to get size
+			// seekable file. Only the first frame is decoded here so opening costs the same
+			// for any length, the length comes from the VBR header, a sidecar or an estimate
 			// (needed to make it possible for the engine to loop a stream correctly)
 
 			skipID3IfNecessary();
+			decodeFrame();
 
-			TheMPAuDecContext->parse_only = 1;
-			Format.FrameCount = 0;
-
-			while(!EndOfFileReached)
+			if (TheMPAuDecContext->channels && TheMPAuDecContext->sample_rate)
 			{
-				if (!decodeFrame())
-					break;
-
-				Format.FrameCount += TheMPAuDecContext->frame_size;
+				SamplesPerFrame = TheMPAuDecContext->frame_size;
 
-				if (!EndOfFileReached /*&& File->isSeekable()*/ )
-				{
-					// to be able to seek in the stream, store offsets and sizes
+				const ik_c8* name = File->getFileName();
+				if (name && name[0])
+					SeekIndexPath = std::string(name) + ".seekidx";
 
-					SFramePositionData data;
-					data.size = TheMPAuDecContext->frame_size;
-					data.offset = File->getPos() - (InputLength - InputPosition) - TheMPAuDecContext->coded_frame_size;
+				if (!readVBRHeader())
+					IndexComplete = true; // free format, only seeks back to the start
+				else
+				if (!loadSeekIndex())
+					startIndexing(name);
 
-					FramePositionData.push_back(data);
-				}
+				setPosition(0);
 			}
-
-			TheMPAuDecContext->parse_only = 0;
-			setPosition(0);
 		}
 		else
 			decodeFrame(); // decode first frame to read audio format
@@ -85,6 +251,10 @@ CIrrKlangAudioStreamMP3::CIrrKlangAudioStreamMP3(IFileReader* file)
 
 CIrrKlangAudioStreamMP3::~CIrrKlangAudioStreamMP3()
 {
+	StopIndexing = true;
+	if (IndexThread.joinable())
+		IndexThread.join();
+
 	if (File)
 		File->drop();
 
@@ -102,6 +272,8 @@ CIrrKlangAudioStreamMP3::~CIrrKlangAudioStreamMP3()
 //! returns format of the audio stream
 SAudioStreamFormat CIrrKlangAudioStreamMP3::getFormat()
 {
+	// the indexing thread replaces an estimated frame count once it knows the exact one
+	std::lock_guard<std::mutex> lock(IndexMutex);
 	return Format;
 }
 
@@ -152,9 +324,22 @@ bool CIrrKlangAudioStreamMP3::decodeFrame()
 		if (InputPosition == InputLength)
 		{
 			InputPosition = 0;
-			InputLength = File->read(InputBuffer, IKP_MP3_INPUT_BUFFER_SIZE);
 
-			if (InputLength == 0)
+			if (MappedData)
+			{
+				// the rest of the mapped file is one input block, nothing is copied
+				const ik_s32 pos = File->getPos();
+				Input = MappedData + pos;
+				InputLength = File->getSize() - pos;
+				File->seek(InputLength, true);
+			}
+			else
+			{
+				Input = InputBuffer;
+				InputLength = File->read(InputBuffer, IKP_MP3_INPUT_BUFFER_SIZE);
+			}
+
+			if (InputLength <= 0)
 			{
 				EndOfFileReached = true;
 				return true;
@@ -163,7 +348,7 @@ bool CIrrKlangAudioStreamMP3::decodeFrame()
 
 		int rv = mpaudec_decode_frame( TheMPAuDecContext, (ik_s16*)DecodeBuffer,
 									   &outputSize,
-									   (ik_u8*)InputBuffer + InputPosition,
+									   Input + InputPosition,
 									   InputLength - InputPosition);
 
 		if (rv < 0)
@@ -246,66 +431,107 @@ bool CIrrKlangAudioStreamMP3::setPosition(ik_s32 pos)
 	}
 	else
 	{
-		// user wants to seek in the stream, so do this here
+		// user wants to seek in the stream, so do this here.
+		// the frames before the target are decoded too, layer 3 may
+		// reference up to this many through the bit reservoir
 
-		int scan_position = 0;
-		int target_frame = 0;
-		int frame_count = (int)FramePositionData.size();
+		const int MAX_FRAME_DEPENDENCY = 10;
 
-		while (target_frame < frame_count)
+		for (int attempt=0; attempt<2; ++attempt)
 		{
-			int frame_size = FramePositionData[target_frame].size;
+			ik_s32 offset = -1;
+			ik_s32 start = 0;
 
-			if (pos <= scan_position + frame_size)
-				break;
-			else
 			{
-				scan_position += frame_size;
-				target_frame++;
+				std::lock_guard<std::mutex> lock(IndexMutex);
+
+				if (!FramePositionData.empty())
+				{
+					const SFramePositionData& last = FramePositionData.back();
+
+					if (pos < last.start + last.size)
+					{
+						// binary search for the frame holding pos
+						int target_frame = (int)(std::upper_bound(FramePositionData.begin(),
+							FramePositionData.end(), pos, framePositionLess) - FramePositionData.begin()) - 1;
+
+						target_frame = std::max(0, target_frame - MAX_FRAME_DEPENDENCY);
+						offset = FramePositionData[target_frame].offset;
+						start = FramePositionData[target_frame].start;
+					}
+				}
 			}
-		}
 
+			if (offset < 0 && !IndexComplete && !SeekTable.empty())
+			{
+				// not indexed that far yet, land near the target with the VBR table
+				const ik_s32 wanted = std::max(0, pos - MAX_FRAME_DEPENDENCY * SamplesPerFrame);
 
-		const int MAX_FRAME_DEPENDENCY = 10;
-		target_frame = std::max(0, target_frame - MAX_FRAME_DEPENDENCY);
-		setPosition(0);
+				int point = (int)(std::upper_bound(SeekTable.begin(), SeekTable.end(),
+					wanted, seekPointLess) - SeekTable.begin()) - 1;
 
-		File->seek(FramePositionData[target_frame].offset, false);
+				if (point >= 0)
+				{
+					offset = SeekTable[point].offset;
+					start = SeekTable[point].start;
+				}
+			}
 
-		int i;
-		for (i = 0; i < target_frame; i++)
-		{
-			if (i>=(int)FramePositionData.size())
+			if (offset < 0 && !IndexComplete && ConstantFrameBytes > 0)
 			{
-				// internal error
-				setPosition(0);
-				return false;
+				// constant bitrate without a table, frames are all the same size apart
+				// from the padding byte so the offset lands within one frame of the target
+				const ik_s32 frame = std::max(0, pos - MAX_FRAME_DEPENDENCY * SamplesPerFrame) / SamplesPerFrame;
+
+				offset = FirstFrameOffset + (ik_s32)(frame * ConstantFrameBytes);
+				start = frame * SamplesPerFrame;
+
+				if (offset >= File->getSize())
+					break; // past the end
 			}
 
-			Position += FramePositionData[i].size;
-		}
+			if (offset >= 0)
+				return seekToFrame(offset, start, pos);
 
-		if (!decodeFrame() || EndOfFileReached)
-		{
-			setPosition(0);
-			return false;
-		}
+			if (IndexComplete)
+				break; // past the end
 
-		int frames_to_consume = pos - Position; // PCM frames now
-		if (frames_to_consume > 0)
-		{
-			ik_u8 *buf = new ik_u8[frames_to_consume * Format.getFrameSize()];
-			readFrames(buf, frames_to_consume);
-			delete[] buf;
+			waitForIndex();
 		}
 
-      	return true;
+		setPosition(0);
+		return false;
 	}
 
 	return false;
 }
 
 
+bool CIrrKlangAudioStreamMP3::seekToFrame(ik_s32 offset, ik_s32 startPosition, ik_s32 pos)
+{
+	setPosition(0);
+
+	File->seek(offset, false);
+	Position = startPosition;
+
+	if (!decodeFrame() || EndOfFileReached)
+	{
+		setPosition(0);
+		return false;
+	}
+
+	int frames_to_consume = pos - Position; // PCM frames now
+	if (frames_to_consume > 0)
+	{
+		ik_u8 *buf = new ik_u8[frames_to_consume * Format.getFrameSize()];
+		readFrames(buf, frames_to_consume);
+		delete[] buf;
+	}
+
+	return true;
+}
+
+
 CIrrKlangAudioStreamMP3::QueueBuffer::QueueBuffer()
 {
 	Capacity = 256;
@@ -394,4 +620,356 @@ void CIrrKlangAudioStreamMP3::skipID3IfNecessary()
 }
 
 
+//! looks for a Xing/Info or VBRI header in the first frame. Fills in the frame count and
+//! the coarse seek table, or estimates the length as constant bitrate without one.
+//! Returns false if the stream can't be walked by its frame headers (free format).
+bool CIrrKlangAudioStreamMP3::readVBRHeader()
+{
+	// peek at the start of the stream, the decoder's input buffer is left alone
+	ik_u8 buffer[IKP_MP3_INPUT_BUFFER_SIZE];
+	const ik_s32 fileSize = File->getSize();
+
+	File->seek(FileBegin);
+	const int length = File->read(buffer, IKP_MP3_INPUT_BUFFER_SIZE);
+	File->seek(FileBegin);
+
+	SMP3FrameHeader header;
+	int first = 0;
+	while (first + 4 <= length && !parseMP3FrameHeader(buffer + first, header))
+		++first;
+
+	if (first + 4 > length)
+		return false;
+
+	FirstFrameOffset = FileBegin + first;
+	SamplesPerFrame = header.Samples;
+
+	const ik_u8* frame = buffer + first;
+	const int available = length - first;
+
+	int frames = -1;
+	int bytes = fileSize - FirstFrameOffset;
+
+	// Xing (VBR) or Info (CBR) from LAME and most encoders, right after the side info
+	const int xing = 4 + header.SideInfoSize;
+	if (xing + 8 <= available &&
+		(!memcmp(frame + xing, "Xing", 4) || !memcmp(frame + xing, "Info", 4)))
+	{
+		const int flags = readBigEndian32(frame + xing + 4);
+		int p = xing + 8;
+
+		if ((flags & 1) && p + 4 <= available)
+		{
+			frames = readBigEndian32(frame + p);
+			p += 4;
+		}
+
+		if ((flags & 2) && p + 4 <= available)
+		{
+			bytes = readBigEndian32(frame + p);
+			p += 4;
+		}
+
+		// 100 entries, byte position of each percent of the duration in 1/256ths
+		if ((flags & 4) && p + 100 <= available && frames > 0)
+		{
+			for (int i=0; i<100; ++i)
+			{
+				SSeekPoint point;
+				point.start = (int)((double)i / 100.0 * frames * header.Samples);
+				point.offset = FirstFrameOffset + (int)(frame[p + i] / 256.0 * bytes);
+
+				if (SeekTable.empty() || point.offset >= SeekTable.back().offset)
+					SeekTable.push_back(point);
+			}
+		}
+	}
+
+	// VBRI from the Fraunhofer encoder, always 32 bytes after the header
+	const int vbri = 4 + 32;
+	if (frames < 0 && vbri + 26 <= available && !memcmp(frame + vbri, "VBRI", 4))
+	{
+		bytes = readBigEndian32(frame + vbri + 10);
+		frames = readBigEndian32(frame + vbri + 14);
+
+		const int entries = readBigEndian16(frame + vbri + 18);
+		const int scale = readBigEndian16(frame + vbri + 20);
+		const int entrySize = readBigEndian16(frame + vbri + 22);
+		const int framesPerEntry = readBigEndian16(frame + vbri + 24);
+
+		if (entrySize >= 1 && entrySize <= 4)
+		{
+			// table entries are byte sizes of each run of frames, starting after this frame
+			int offset = FirstFrameOffset + header.Bytes;
+			int p = vbri + 26;
+
+			for (int i=0; i<=entries; ++i)
+			{
+				SSeekPoint point;
+				point.start = (1 + i * framesPerEntry) * header.Samples;
+				point.offset = offset;
+				SeekTable.push_back(point);
+
+				if (i == entries || p + entrySize > available)
+					break;
+
+				int value = 0;
+				for (int b=0; b<entrySize; ++b)
+					value = (value << 8) | frame[p + b];
+
+				offset += value * scale;
+				p += entrySize;
+			}
+		}
+	}
+
+	if (frames > 0)
+		Format.FrameCount = (frames + 1) * header.Samples; // the tag frame decodes as silence
+	else
+	if (header.Bytes > 0)
+	{
+		// no header, assume constant bitrate for the length and for seeking
+		ConstantFrameBytes = header.Samples / 8.0 * header.BitRate / header.SampleRate;
+		Format.FrameCount = (bytes / header.Bytes) * header.Samples;
+	}
+
+	return true;
+}
+
+
+// sidecar layout: magic, version, file size, stream start, frame count, then offset/size pairs
+static const ik_s32 IKP_MP3_SEEK_INDEX_MAGIC = 0x49534B49; // "IKSI"
+static const ik_s32 IKP_MP3_SEEK_INDEX_VERSION = 1;
+
+bool CIrrKlangAudioStreamMP3::loadSeekIndex()
+{
+	if (SeekIndexPath.empty())
+		return false;
+
+	FILE* file = fopen(SeekIndexPath.c_str(), "rb");
+	if (!file)
+		return false;
+
+	ik_s32 header[5];
+	std::vector<SFramePositionData> frames;
+
+	// the size check catches a replaced file, a truncated sidecar fails the read
+	bool ok = fread(header, sizeof(header), 1, file) == 1 &&
+		header[0] == IKP_MP3_SEEK_INDEX_MAGIC &&
+		header[1] == IKP_MP3_SEEK_INDEX_VERSION &&
+		header[2] == File->getSize() &&
+		header[3] == FileBegin &&
+		header[4] > 0;
+
+	if (ok)
+	{
+		std::vector<ik_s32> raw(header[4] * 2);
+		ok = fread(&raw[0], sizeof(ik_s32), raw.size(), file) == raw.size();
+
+		if (ok)
+		{
+			frames.resize(header[4]);
+
+			int start = 0;
+			for (int i=0; i<header[4]; ++i)
+			{
+				frames[i].offset = raw[i*2];
+				frames[i].size = raw[i*2 + 1];
+				frames[i].start = start;
+				start += frames[i].size;
+			}
+
+			Format.FrameCount = start;
+		}
+	}
+
+	fclose(file);
+
+	if (!ok)
+		return false;
+
+	FramePositionData.swap(frames);
+	IndexComplete = true;
+	return true;
+}
+
+
+void CIrrKlangAudioStreamMP3::saveSeekIndex()
+{
+#if IKP_MP3_WRITE_SEEK_INDEX
+	if (SeekIndexPath.empty() || FramePositionData.empty())
+		return;
+
+	// read only media, it's simply indexed again next time
+	FILE* file = fopen(SeekIndexPath.c_str(), "wb");
+	if (!file)
+		return;
+
+	ik_s32 header[5];
+	header[0] = IKP_MP3_SEEK_INDEX_MAGIC;
+	header[1] = IKP_MP3_SEEK_INDEX_VERSION;
+	header[2] = File->getSize();
+	header[3] = FileBegin;
+	header[4] = (ik_s32)FramePositionData.size();
+	fwrite(header, sizeof(header), 1, file);
+
+	for (int i=0; i<(int)FramePositionData.size(); ++i)
+	{
+		ik_s32 pair[2];
+		pair[0] = FramePositionData[i].offset;
+		pair[1] = FramePositionData[i].size;
+		fwrite(pair, sizeof(pair), 1, file);
+	}
+
+	fclose(file);
+#endif
+}
+
+
+void CIrrKlangAudioStreamMP3::startIndexing(const ik_c8* fileName)
+{
+	// mapped files and files on disk (through their own handle) are indexed
+	// while playing, other readers are walked on the first seek that needs it
+	if (MappedData || (fileName && fileName[0]))
+		IndexThread = std::thread(&CIrrKlangAudioStreamMP3::indexThreadMain, this,
+			std::string(fileName ? fileName : ""), File->getSize());
+}
+
+
+void CIrrKlangAudioStreamMP3::waitForIndex()
+{
+	if (IndexThread.joinable())
+		IndexThread.join();
+
+	if (!IndexComplete)
+	{
+		// no second handle on the file, walk the headers through ours
+		const ik_s32 pos = File->getPos();
+
+		CMP3ScanSourceReader source(File);
+		scanFrames(source, File->getSize());
+
+		File->seek(pos);
+	}
+}
+
+
+void CIrrKlangAudioStreamMP3::indexThreadMain(std::string fileName, ik_s32 fileSize)
+{
+	if (MappedData)
+	{
+		CMP3ScanSourceMemory source(MappedData, fileSize);
+
+		if (scanFrames(source, fileSize))
+			saveSeekIndex();
+		return;
+	}
+
+	FILE* file = fopen(fileName.c_str(), "rb");
+	if (!file)
+		return;
+
+	CMP3ScanSourceStdio source(file);
+
+	if (scanFrames(source, fileSize))
+		saveSeekIndex();
+}
+
+
+//! walks the frame headers from the first frame to the end of the file, publishing
+//! the index every few hundred frames so seeks into the scanned part work right away
+bool CIrrKlangAudioStreamMP3::scanFrames(CMP3ScanSource& source, int fileSize)
+{
+	const int SCAN_BLOCK_SIZE = 64 * 1024;
+	const int PUBLISH_FRAME_COUNT = 256;
+
+	const ik_u8* block = 0;
+	std::vector<SFramePositionData> pending;
+	pending.reserve(PUBLISH_FRAME_COUNT);
+
+	{
+		std::lock_guard<std::mutex> lock(IndexMutex);
+		FramePositionData.clear();
+	}
+
+	int blockBegin = 0;
+	int blockLength = 0;
+	int offset = FirstFrameOffset;
+	int start = 0;
+
+	SMP3FrameHeader first;
+	SMP3FrameHeader header;
+	bool haveFirst = false;
+
+	while (offset + 4 <= fileSize)
+	{
+		if (StopIndexing)
+			return false;
+
+		if (offset + 4 > blockBegin + blockLength)
+		{
+			blockBegin = offset;
+			block = source.readAt(offset, SCAN_BLOCK_SIZE, blockLength);
+
+			if (blockLength < 4)
+				break;
+		}
+
+		if (!parseMP3FrameHeader(block + (offset - blockBegin), header) ||
+			(haveFirst && !isSameMP3Stream(first, header)) ||
+			offset + header.Bytes > fileSize)
+		{
+			// lost sync (junk, a truncated last frame or a trailing tag), step a byte
+			++offset;
+			continue;
+		}
+
+		if (!haveFirst)
+		{
+			first = header;
+			haveFirst = true;
+		}
+
+		SFramePositionData data;
+		data.offset = offset;
+		data.size = header.Samples;
+		data.start = start;
+		pending.push_back(data);
+
+		start += header.Samples;
+		offset += header.Bytes;
+
+		if ((int)pending.size() == PUBLISH_FRAME_COUNT)
+		{
+			std::lock_guard<std::mutex> lock(IndexMutex);
+			FramePositionData.insert(FramePositionData.end(), pending.begin(), pending.end());
+			pending.clear();
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(IndexMutex);
+		FramePositionData.insert(FramePositionData.end(), pending.begin(), pending.end());
+
+		if (start > 0)
+			Format.FrameCount = start;
+	}
+
+	IndexComplete = true;
+	return true;
+}
+
+
+bool CIrrKlangAudioStreamMP3::framePositionLess(ik_s32 pos, const SFramePositionData& data)
+{
+	return pos < data.start;
+}
+
+
+bool CIrrKlangAudioStreamMP3::seekPointLess(ik_s32 pos, const SSeekPoint& point)
+{
+	return pos < point.start;
+}
+
+
 } // end namespace irrklang
@@ -10,16 +10,34 @@
 #include <ik_IAudioStream.h>
 #include <ik_IFileReader.h>
 #include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
 #include "decoder/mpaudec.h"
+#include "ik_IMappedFileReader.h"
+
+// set to 1 to also write seek index sidecars (<file>.seekidx) next to the
+// source, e.g. when preparing media/; off by default since an installed game
+// may not be able to write there. Existing sidecars are always read
+#ifndef IKP_MP3_WRITE_SEEK_INDEX
+#define IKP_MP3_WRITE_SEEK_INDEX 0
+#endif
 
 namespace irrklang
 {
 	const int IKP_MP3_INPUT_BUFFER_SIZE = 4096;
 
+	class CMP3ScanSource;
+
 	//!	Reads and decodes audio data into an usable audio stream for the ISoundEngine
 	/** To extend irrKlang with new audio format decoders, the only thing needed to do
 	is implementing the IAudioStream interface. All the code available in this class is only for
-	mp3 decoding and may make this class look a bit more complicated then it actually is. */
+	mp3 decoding and may make this class look a bit more complicated then it actually is.
+	Opening a stream only decodes the first frame. The length and a coarse seek table come from
+	a Xing/Info or VBRI header when there is one, constant bitrate streams without one seek by
+	the frame size. The exact frame index is loaded from a <file>.seekidx sidecar or built by
+	walking the frame headers on a background thread. */
 	class CIrrKlangAudioStreamMP3 : public IAudioStream
 	{
 	public:
@@ -52,6 +70,16 @@ namespace irrklang
 		bool decodeFrame();
 		void skipID3IfNecessary();
 
+		// fast start and seeking
+		bool readVBRHeader();
+		bool loadSeekIndex();
+		void saveSeekIndex();
+		void startIndexing(const ik_c8* fileName);
+		void waitForIndex();
+		void indexThreadMain(std::string fileName, ik_s32 fileSize);
+		bool scanFrames(CMP3ScanSource& source, int fileSize);
+		bool seekToFrame(ik_s32 offset, ik_s32 startPosition, ik_s32 pos);
+
 		irrklang::IFileReader* File;
 		SAudioStreamFormat Format;
 
@@ -59,6 +87,8 @@ namespace irrklang
 		MPAuDecContext* TheMPAuDecContext;
 
 		ik_u8 InputBuffer[IKP_MP3_INPUT_BUFFER_SIZE];
+		const ik_u8* Input;			// InputBuffer, or straight into MappedData
+		const ik_u8* MappedData;	// contents of an IMappedFileReader, 0 for other readers
 
 		int InputPosition;
 		int InputLength;
@@ -94,9 +124,31 @@ namespace irrklang
 		{
 			int offset;
 			int size;
+			int start;	// first PCM frame, for the binary search in setPosition
+		};
+
+		// coarse entry from a Xing/Info TOC or a VBRI table
+		struct SSeekPoint
+		{
+			int start;
+			int offset;
 		};
 
+		// exact index, published in batches by the indexing thread
+		static bool framePositionLess(ik_s32 pos, const SFramePositionData& data);
+		static bool seekPointLess(ik_s32 pos, const SSeekPoint& point);
+
 		std::vector<SFramePositionData> FramePositionData;
+		std::vector<SSeekPoint> SeekTable;
+		std::mutex IndexMutex;
+		std::thread IndexThread;
+		std::atomic<bool> IndexComplete;
+		std::atomic<bool> StopIndexing;
+		std::string SeekIndexPath;
+		ik_s32 FirstFrameOffset;
+		ik_s32 SamplesPerFrame;
+		double ConstantFrameBytes;	// average frame size without a Xing/VBRI header, 0 for VBR
+
 		QueueBuffer DecodedQueue;
 	};
 
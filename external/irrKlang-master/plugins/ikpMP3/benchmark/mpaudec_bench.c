@@ -0,0 +1,210 @@
+/*
+ * Decode benchmark for the mpaudec kernels. Every file is decoded with
+ * the scalar reference and each SIMD level the CPU supports, reporting
+ * the realtime factor (seconds of audio per second of decoding) and
+ * whether the output matches the reference bit for bit.
+ *
+ * usage: mpaudec_bench [-r repeats] file.mp3 ...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mpaudec.h"
+
+#ifdef _WIN32
+#    include <windows.h>
+#else
+#    include <time.h>
+#endif
+
+static double now_seconds(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER count, freq;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+    return (double)count.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+typedef struct PcmBuffer {
+    short *data;
+    size_t count;    /* samples, all channels */
+    size_t capacity;
+    int channels;
+    int sample_rate;
+} PcmBuffer;
+
+static void pcm_append(PcmBuffer *pcm, const short *samples, size_t count)
+{
+    if (pcm->count + count > pcm->capacity) {
+        size_t capacity = pcm->capacity ? pcm->capacity : 65536;
+        while (pcm->count + count > capacity)
+            capacity *= 2;
+        pcm->data = (short *)realloc(pcm->data, capacity * sizeof(short));
+        pcm->capacity = capacity;
+    }
+    memcpy(pcm->data + pcm->count, samples, count * sizeof(short));
+    pcm->count += count;
+}
+
+static unsigned char *load_file(const char *path, long *size)
+{
+    unsigned char *data;
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = (unsigned char *)malloc(*size > 0 ? *size : 1);
+    if (fread(data, 1, *size, f) != (size_t)*size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    return data;
+}
+
+/* same ID3v2 skip as CIrrKlangAudioStreamMP3 */
+static long skip_id3(const unsigned char *data, long size)
+{
+    if (size >= 10 && data[0] == 'I' && data[1] == 'D' && data[2] == '3') {
+        long tag = ((data[6] & 0x7f) << 21) | ((data[7] & 0x7f) << 14) |
+                   ((data[8] & 0x7f) << 7) | (data[9] & 0x7f);
+        return tag + 10 < size ? tag + 10 : size;
+    }
+    return 0;
+}
+
+/* decodes the whole file, feeding the decoder in 4k blocks like the
+   plugin does. Returns the decode time in seconds, -1 on failure */
+static double decode(const unsigned char *data, long size, PcmBuffer *pcm)
+{
+    static short frame[MPAUDEC_MAX_AUDIO_FRAME_SIZE];
+    MPAuDecContext ctx;
+    long pos = skip_id3(data, size);
+    double start;
+
+    if (mpaudec_init(&ctx) < 0)
+        return -1;
+
+    pcm->count = 0;
+    start = now_seconds();
+    while (pos < size) {
+        int block = size - pos < 4096 ? (int)(size - pos) : 4096;
+        int used = 0;
+        while (used < block) {
+            int out = 0;
+            int rv = mpaudec_decode_frame(&ctx, frame, &out, data + pos + used, block - used);
+            if (rv < 0) {
+                mpaudec_clear(&ctx);
+                return -1;
+            }
+            used += rv;
+            if (out > 0)
+                pcm_append(pcm, frame, out / sizeof(short));
+        }
+        pos += block;
+    }
+    start = now_seconds() - start;
+
+    pcm->channels = ctx.channels;
+    pcm->sample_rate = ctx.sample_rate;
+    mpaudec_clear(&ctx);
+    return start;
+}
+
+static const char *level_name(int level)
+{
+    switch (level) {
+    case MPAUDEC_SIMD_SSE2: return "sse2";
+    case MPAUDEC_SIMD_AVX2: return "avx2";
+    default:                return "scalar";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int repeats = 5;
+    int failures = 0;
+    int first = 1;
+    int best, i, r, level;
+
+    if (argc > 2 && !strcmp(argv[1], "-r")) {
+        repeats = atoi(argv[2]);
+        if (repeats < 1)
+            repeats = 1;
+        first = 3;
+    }
+    if (first >= argc) {
+        printf("usage: %s [-r repeats] file.mp3 ...\n", argv[0]);
+        return 1;
+    }
+
+    best = mpaudec_set_simd(MPAUDEC_SIMD_AVX2);
+    printf("cpu supports: %s, best of %d runs\n\n", level_name(best), repeats);
+    printf("%-28s %-7s %9s %10s %10s  %s\n", "file", "kernels", "audio s", "decode ms", "realtime", "output");
+
+    for (i = first; i < argc; i++) {
+        PcmBuffer reference, pcm;
+        long size;
+        unsigned char *data = load_file(argv[i], &size);
+        const char *name = strrchr(argv[i], '/');
+        name = name ? name + 1 : argv[i];
+
+        if (!data) {
+            printf("%-28s could not be read\n", name);
+            failures++;
+            continue;
+        }
+
+        memset(&reference, 0, sizeof(reference));
+        memset(&pcm, 0, sizeof(pcm));
+
+        for (level = MPAUDEC_SIMD_NONE; level <= best; level++) {
+            PcmBuffer *out = level == MPAUDEC_SIMD_NONE ? &reference : &pcm;
+            double fastest = -1, seconds, audio;
+            const char *result = "reference";
+
+            mpaudec_set_simd(level);
+            for (r = 0; r < repeats; r++) {
+                seconds = decode(data, size, out);
+                if (seconds < 0)
+                    break;
+                if (fastest < 0 || seconds < fastest)
+                    fastest = seconds;
+            }
+            if (fastest < 0 || !out->channels) {
+                printf("%-28s %-7s decode failed\n", name, level_name(level));
+                failures++;
+                break;
+            }
+
+            if (level != MPAUDEC_SIMD_NONE) {
+                if (out->count == reference.count &&
+                    !memcmp(out->data, reference.data, out->count * sizeof(short))) {
+                    result = "bit-exact";
+                } else {
+                    result = "MISMATCH";
+                    failures++;
+                }
+            }
+
+            audio = (double)out->count / out->channels / out->sample_rate;
+            printf("%-28s %-7s %9.2f %10.2f %9.1fx  %s\n", name, level_name(level),
+                   audio, fastest * 1000.0, fastest > 0 ? audio / fastest : 0.0, result);
+        }
+
+        free(reference.data);
+        free(pcm.data);
+        free(data);
+    }
+
+    return failures ? 1 : 0;
+}
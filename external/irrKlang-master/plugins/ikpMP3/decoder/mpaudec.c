@@ -23,6 +23,7 @@
 /*#define DEBUG*/
 #include "internal.h"
 #include "mpegaudio.h"
+#include "mpaudec_simd.h"
 
 #ifdef _MSC_VER
 #pragma warning(disable : 4244)
@@ -170,6 +171,16 @@ static uint32_t scale_factor_mult3[4] = {
 };
 
 static MPA_INT window[512];
+
+#if FRAC_BITS == MPADSP_FRAC_BITS
+/* kernels in use, filled by mpaudec_set_simd */
+static MPADSPContext mpa_dsp;
+static int mpa_simd_level = -1;
+#define MPA_DSP(name) mpa_dsp.name
+#else
+/* the SIMD kernels are written for the high precision format */
+#define MPA_DSP(name) name##_c
+#endif
     
 /* layer 1 unscaling */
 /* n = number of bits of the mantissa minus 1 */
@@ -315,6 +326,14 @@ int mpaudec_init(MPAuDecContext * mpctx)
         return -1;
     s = mpctx->priv_data;
 
+#if FRAC_BITS == MPADSP_FRAC_BITS
+    /* SSE2 has to emulate the signed 32x32->64 multiply and measures
+       about even with the scalar code, so it is only used on request */
+    if (mpa_simd_level < 0)
+        mpaudec_set_simd(mpadsp_cpu_level() >= MPAUDEC_SIMD_AVX2 ?
+                         MPAUDEC_SIMD_AVX2 : MPAUDEC_SIMD_NONE);
+#endif
+
     if (!init && !mpctx->parse_only) {
         /* scale factors table for layer 1/2 */
         for(i=0;i<64;i++) {
@@ -794,43 +813,19 @@ static int round_sample(int64_t sum)
 }
 
 
-/* 32 sub band synthesis filter. Input: 32 sub band samples, Output:
-   32 samples. */
-/* XXX: optimize by avoiding ring buffer usage */
-static void synth_filter(MPADecodeContext *s1,
-                         int ch, int16_t *samples, int incr, 
-                         int32_t sb_samples[SBLIMIT])
+/* windowing half of the synthesis filter, scalar reference of
+   MPADSPContext.synth_window */
+static void synth_window_c(const MPA_INT *synth_buf, const MPA_INT *window,
+                           int16_t *samples, int incr)
 {
-    int32_t tmp[32];
-    MPA_INT *synth_buf;
     const MPA_INT *w, *w2, *p;
-    int j, offset, v;
+    int j;
     int16_t *samples2;
 #if FRAC_BITS <= 15
     int32_t sum, sum2;
 #else
     int64_t sum, sum2;
 #endif
-    
-    dct32(tmp, sb_samples);
-    
-    offset = s1->synth_buf_offset[ch];
-    synth_buf = s1->synth_buf[ch] + offset;
-
-    for(j=0;j<32;j++) {
-        v = tmp[j];
-#if FRAC_BITS <= 15
-        /* NOTE: can cause a loss in precision if very high amplitude
-           sound */
-        if (v > 32767)
-            v = 32767;
-        else if (v < -32768)
-            v = -32768;
-#endif
-        synth_buf[j] = v;
-    }
-    /* copy to avoid wrap */
-    memcpy(synth_buf + 512, synth_buf, 32 * sizeof(MPA_INT));
 
     samples2 = samples + 31 * incr;
     w = window;
@@ -867,6 +862,40 @@ static void synth_filter(MPADecodeContext *s1,
     sum = 0;
     SUM8(sum, -=, w + 32, p);
     *samples = round_sample(sum);
+}
+
+/* 32 sub band synthesis filter. Input: 32 sub band samples, Output:
+   32 samples. */
+/* XXX: optimize by avoiding ring buffer usage */
+static void synth_filter(MPADecodeContext *s1,
+                         int ch, int16_t *samples, int incr, 
+                         int32_t sb_samples[SBLIMIT])
+{
+    int32_t tmp[32];
+    MPA_INT *synth_buf;
+    int j, offset, v;
+    
+    dct32(tmp, sb_samples);
+    
+    offset = s1->synth_buf_offset[ch];
+    synth_buf = s1->synth_buf[ch] + offset;
+
+    for(j=0;j<32;j++) {
+        v = tmp[j];
+#if FRAC_BITS <= 15
+        /* NOTE: can cause a loss in precision if very high amplitude
+           sound */
+        if (v > 32767)
+            v = 32767;
+        else if (v < -32768)
+            v = -32768;
+#endif
+        synth_buf[j] = v;
+    }
+    /* copy to avoid wrap */
+    memcpy(synth_buf + 512, synth_buf, 32 * sizeof(MPA_INT));
+
+    MPA_DSP(synth_window)(synth_buf, window, samples, incr);
 
     offset = (offset - 32) & 511;
     s1->synth_buf_offset[ch] = offset;
@@ -935,8 +964,8 @@ static void imdct12(int *out, int *in)
 #define C7 FIXR(0.34202014332566873304)
 #define C8 FIXR(0.17364817766693034885)
 
-/* 0.5 / cos(pi*(2*i+1)/36) */
-static const int icos36[9] = {
+/* 0.5 / cos(pi*(2*i+1)/36), also used by mpaudec_simd.c */
+const int mpa_icos36[9] = {
     FIXR(0.50190991877167369479),
     FIXR(0.51763809020504152469),
     FIXR(0.55168895948124587824),
@@ -948,7 +977,7 @@ static const int icos36[9] = {
     FIXR(5.73685662283492756461),
 };
 
-static const int icos72[18] = {
+const int mpa_icos72[18] = {
     /* 0.5 / cos(pi*(2*i+19)/72) */
     FIXR(0.74009361646113053152),
     FIXR(0.82133981585229078570),
@@ -1022,18 +1051,18 @@ static void imdct36(int *out, int *in)
 
         t2 = tmp[i + 1];
         t3 = tmp[i + 3];
-        s1 = MULL(t3 + t2, icos36[j]);
-        s3 = MULL(t3 - t2, icos36[8 - j]);
+        s1 = MULL(t3 + t2, mpa_icos36[j]);
+        s3 = MULL(t3 - t2, mpa_icos36[8 - j]);
         
-        t0 = MULL(s0 + s1, icos72[9 + 8 - j]);
-        t1 = MULL(s0 - s1, icos72[8 - j]);
+        t0 = MULL(s0 + s1, mpa_icos72[9 + 8 - j]);
+        t1 = MULL(s0 - s1, mpa_icos72[8 - j]);
         out[18 + 9 + j] = t0;
         out[18 + 8 - j] = t0;
         out[9 + j] = -t1;
         out[8 - j] = t1;
         
-        t0 = MULL(s2 + s3, icos72[9+j]);
-        t1 = MULL(s2 - s3, icos72[j]);
+        t0 = MULL(s2 + s3, mpa_icos72[9+j]);
+        t1 = MULL(s2 - s3, mpa_icos72[j]);
         out[18 + 9 + (8 - j)] = t0;
         out[18 + j] = t0;
         out[9 + (8 - j)] = -t1;
@@ -1042,15 +1071,43 @@ static void imdct36(int *out, int *in)
     }
 
     s0 = tmp[16];
-    s1 = MULL(tmp[17], icos36[4]);
-    t0 = MULL(s0 + s1, icos72[9 + 4]);
-    t1 = MULL(s0 - s1, icos72[4]);
+    s1 = MULL(tmp[17], mpa_icos36[4]);
+    t0 = MULL(s0 + s1, mpa_icos72[9 + 4]);
+    t1 = MULL(s0 - s1, mpa_icos72[4]);
     out[18 + 9 + 4] = t0;
     out[18 + 8 - 4] = t0;
     out[9 + 4] = -t1;
     out[8 - 4] = t1;
 }
 
+/* long block IMDCT of one sub band with window and overlap */
+static void imdct36_long(int32_t *sb_samples, int32_t *mdct_buf,
+                         int32_t *in, const int32_t *win)
+{
+    int32_t out[36];
+    int i;
+
+    imdct36(out, in);
+    for(i=0;i<18;i++) {
+        *sb_samples = MULL(out[i], win[i]) + mdct_buf[i];
+        mdct_buf[i] = MULL(out[i + 18], win[i + 18]);
+        sb_samples += SBLIMIT;
+    }
+}
+
+/* scalar reference of MPADSPContext.imdct36_x4 */
+static void imdct36_x4_c(int32_t *sb_samples, int32_t *mdct_buf,
+                         int32_t *in, const int32_t *win)
+{
+    int j;
+
+    for(j=0;j<4;j++) {
+        /* select frequency inversion */
+        imdct36_long(sb_samples + j, mdct_buf + 18 * j, in + 18 * j,
+                     win + ((4 * 36) & -(j & 1)));
+    }
+}
+
 /* fast header check for resync */
 static int check_header(uint32_t header)
 {
@@ -1698,12 +1755,50 @@ static void reorder_block(MPADecodeContext *s, GranuleDef *g)
 
 #define ISQRT2 FIXR(0.70710678118654752440)
 
+/* scalar references of the MPADSPContext stereo kernels */
+static void ms_stereo_c(int32_t *tab0, int32_t *tab1, int len)
+{
+    int i, tmp0, tmp1;
+
+    for(i=0;i<len;i++) {
+        tmp0 = tab0[i];
+        tmp1 = tab1[i];
+        tab0[i] = tmp0 + tmp1;
+        tab1[i] = tmp0 - tmp1;
+    }
+}
+
+static void ms_stereo_scaled_c(int32_t *tab0, int32_t *tab1, int len,
+                               int32_t scale)
+{
+    int j, tmp0, tmp1;
+
+    for(j=0;j<len;j++) {
+        tmp0 = tab0[j];
+        tmp1 = tab1[j];
+        tab0[j] = MULL(tmp0 + tmp1, scale);
+        tab1[j] = MULL(tmp0 - tmp1, scale);
+    }
+}
+
+static void i_stereo_c(int32_t *tab0, int32_t *tab1, int len,
+                       int32_t v1, int32_t v2)
+{
+    int j, tmp0;
+
+    for(j=0;j<len;j++) {
+        tmp0 = tab0[j];
+        tab0[j] = MULL(tmp0, v1);
+        tab1[j] = MULL(tmp0, v2);
+    }
+}
+
 static void compute_stereo(MPADecodeContext *s,
                            GranuleDef *g0, GranuleDef *g1)
 {
     int i, j, k, l;
     int32_t v1, v2;
-    int sf_max, tmp0, tmp1, sf, len, non_zero_found;
+    int sf_max, sf, len, non_zero_found;
     int32_t (*is_tab)[16];
     int32_t *tab0, *tab1;
     int non_zero_found_short[3];
@@ -1747,22 +1842,13 @@ static void compute_stereo(MPADecodeContext *s,
 
                     v1 = is_tab[0][sf];
                     v2 = is_tab[1][sf];
-                    for(j=0;j<len;j++) {
-                        tmp0 = tab0[j];
-                        tab0[j] = MULL(tmp0, v1);
-                        tab1[j] = MULL(tmp0, v2);
-                    }
+                    MPA_DSP(i_stereo)(tab0, tab1, len, v1, v2);
                 } else {
                 found1:
                     if (s->mode_ext & MODE_EXT_MS_STEREO) {
                         /* lower part of the spectrum : do ms stereo
                            if enabled */
-                        for(j=0;j<len;j++) {
-                            tmp0 = tab0[j];
-                            tmp1 = tab1[j];
-                            tab0[j] = MULL(tmp0 + tmp1, ISQRT2);
-                            tab1[j] = MULL(tmp0 - tmp1, ISQRT2);
-                        }
+                        MPA_DSP(ms_stereo_scaled)(tab0, tab1, len, ISQRT2);
                     }
                 }
             }
@@ -1791,22 +1877,13 @@ static void compute_stereo(MPADecodeContext *s,
                     goto found2;
                 v1 = is_tab[0][sf];
                 v2 = is_tab[1][sf];
-                for(j=0;j<len;j++) {
-                    tmp0 = tab0[j];
-                    tab0[j] = MULL(tmp0, v1);
-                    tab1[j] = MULL(tmp0, v2);
-                }
+                MPA_DSP(i_stereo)(tab0, tab1, len, v1, v2);
             } else {
             found2:
                 if (s->mode_ext & MODE_EXT_MS_STEREO) {
                     /* lower part of the spectrum : do ms stereo
                        if enabled */
-                    for(j=0;j<len;j++) {
-                        tmp0 = tab0[j];
-                        tmp1 = tab1[j];
-                        tab0[j] = MULL(tmp0 + tmp1, ISQRT2);
-                        tab1[j] = MULL(tmp0 - tmp1, ISQRT2);
-                    }
+                    MPA_DSP(ms_stereo_scaled)(tab0, tab1, len, ISQRT2);
                 }
             }
         }
@@ -1814,14 +1891,7 @@ static void compute_stereo(MPADecodeContext *s,
         /* ms stereo ONLY */
         /* NOTE: the 1/sqrt(2) normalization factor is included in the
            global gain */
-        tab0 = g0->sb_hybrid;
-        tab1 = g1->sb_hybrid;
-        for(i=0;i<576;i++) {
-            tmp0 = tab0[i];
-            tmp1 = tab1[i];
-            tab0[i] = tmp0 + tmp1;
-            tab1[i] = tmp0 - tmp1;
-        }
+        MPA_DSP(ms_stereo)(g0->sb_hybrid, g1->sb_hybrid, 576);
     }
 }
 
@@ -1893,24 +1963,27 @@ static void compute_imdct(MPADecodeContext *s,
 
     buf = mdct_buf;
     ptr = g->sb_hybrid;
-    for(j=0;j<mdct_long_end;j++) {
-        imdct36(out, ptr);
-        /* apply window & overlap with previous buffer */
-        out_ptr = sb_samples + j;
+    for(j=0;j<mdct_long_end;) {
         /* select window */
         if (g->switch_point && j < 2)
             win1 = mdct_win[0];
         else
             win1 = mdct_win[g->block_type];
+        /* apply window & overlap with previous buffer, four sub bands
+           at a time once past the switch point (j is even then) */
+        if (!(g->switch_point && j < 2) && j + 4 <= mdct_long_end) {
+            MPA_DSP(imdct36_x4)(sb_samples + j, buf, ptr, win1);
+            ptr += 4 * 18;
+            buf += 4 * 18;
+            j += 4;
+            continue;
+        }
         /* select frequency inversion */
         win = win1 + ((4 * 36) & -(j & 1));
-        for(i=0;i<18;i++) {
-            *out_ptr = MULL(out[i], win[i]) + buf[i];
-            buf[i] = MULL(out[i + 18], win[i + 18]);
-            out_ptr += SBLIMIT;
-        }
+        imdct36_long(sb_samples + j, buf, ptr, win);
         ptr += 18;
         buf += 18;
+        j++;
     }
     for(j=mdct_long_end;j<sblimit;j++) {
         for(i=0;i<6;i++) {
@@ -2475,3 +2548,39 @@ void mpaudec_clear(MPAuDecContext *mpctx)
     free(mpctx->priv_data);
     memset(mpctx, 0, sizeof(MPAuDecContext));
 }
+
+int mpaudec_set_simd(int level)
+{
+#if FRAC_BITS == MPADSP_FRAC_BITS
+    int cpu = mpadsp_cpu_level();
+    if (level > cpu)
+        level = cpu;
+
+    mpa_dsp.synth_window = synth_window_c;
+    mpa_dsp.imdct36_x4 = imdct36_x4_c;
+    mpa_dsp.ms_stereo = ms_stereo_c;
+    mpa_dsp.ms_stereo_scaled = ms_stereo_scaled_c;
+    mpa_dsp.i_stereo = i_stereo_c;
+#ifdef MPAUDEC_SIMD
+    if (level >= MPAUDEC_SIMD_AVX2)
+        mpadsp_init_avx2(&mpa_dsp);
+    else if (level >= MPAUDEC_SIMD_SSE2)
+        mpadsp_init_sse2(&mpa_dsp);
+#endif
+    if (level < MPAUDEC_SIMD_NONE)
+        level = MPAUDEC_SIMD_NONE;
+    mpa_simd_level = level;
+    return level;
+#else
+    return MPAUDEC_SIMD_NONE;
+#endif
+}
+
+int mpaudec_get_simd(void)
+{
+#if FRAC_BITS == MPADSP_FRAC_BITS
+    return mpa_simd_level;
+#else
+    return MPAUDEC_SIMD_NONE;
+#endif
+}
@@ -27,6 +27,17 @@ int mpaudec_decode_frame(MPAuDecContext * mpctx,
                          const unsigned char * buf, int buf_size);
 void mpaudec_clear(MPAuDecContext *mpctx);
 
+/* kernels for the synthesis filter, IMDCT and stereo processing */
+#define MPAUDEC_SIMD_NONE 0 /* scalar reference */
+#define MPAUDEC_SIMD_SSE2 1
+#define MPAUDEC_SIMD_AVX2 2
+
+/* selects the kernels of all decoders, lowered to what the CPU
+   supports. Without a call the first mpaudec_init picks AVX2 when
+   available and the scalar code otherwise. Returns the level in use. */
+int mpaudec_set_simd(int level);
+int mpaudec_get_simd(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,117 @@
+/*
+ * SSE2 and AVX2 kernels for the stand-alone mpaudec library: the
+ * synthesis window, the long block IMDCT and the stereo processing.
+ * The scalar code in mpaudec.c stays the reference, these produce the
+ * same output bit for bit.
+ */
+
+#include "mpaudec_simd.h"
+#include "mpegaudio.h"
+
+#ifdef MPAUDEC_SIMD
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#    include <intrin.h>
+#    define MPADSP_TARGET_SSE2
+#    define MPADSP_TARGET_AVX2
+#else
+#    include <cpuid.h>
+#    define MPADSP_TARGET_SSE2 __attribute__((target("sse2")))
+#    define MPADSP_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#define MPADSP_INLINE __inline
+
+/* 0.5 / cos terms of imdct36, shared with mpaudec.c */
+extern const int mpa_icos36[9];
+extern const int mpa_icos72[18];
+
+/* cos(pi*i/18), the same constants as imdct36 in mpaudec.c */
+#define MPADSP_FIXR(a) ((int)((a) * (1 << MPADSP_FRAC_BITS) + 0.5))
+#define C1 MPADSP_FIXR(0.98480775301220805936)
+#define C2 MPADSP_FIXR(0.93969262078590838405)
+#define C3 MPADSP_FIXR(0.86602540378443864676)
+#define C4 MPADSP_FIXR(0.76604444311897803520)
+#define C5 MPADSP_FIXR(0.64278760968653932632)
+#define C6 MPADSP_FIXR(0.5)
+#define C7 MPADSP_FIXR(0.34202014332566873304)
+#define C8 MPADSP_FIXR(0.17364817766693034885)
+
+#define MPADSP_FN(name) name##_sse2
+#define MPADSP_TARGET MPADSP_TARGET_SSE2
+#define MPADSP_AVX2 0
+#include "mpaudec_simd_impl.h"
+#undef MPADSP_FN
+#undef MPADSP_TARGET
+#undef MPADSP_AVX2
+
+#define MPADSP_FN(name) name##_avx2
+#define MPADSP_TARGET MPADSP_TARGET_AVX2
+#define MPADSP_AVX2 1
+#include "mpaudec_simd_impl.h"
+#undef MPADSP_FN
+#undef MPADSP_TARGET
+#undef MPADSP_AVX2
+
+static void cpuid(int leaf, int sub, unsigned int regs[4])
+{
+#ifdef _MSC_VER
+    int r[4];
+    __cpuidex(r, leaf, sub);
+    regs[0] = r[0];
+    regs[1] = r[1];
+    regs[2] = r[2];
+    regs[3] = r[3];
+#else
+    regs[0] = regs[1] = regs[2] = regs[3] = 0;
+    __cpuid_count(leaf, sub, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+/* the OS has to save the ymm registers too */
+static int os_saves_ymm(void)
+{
+#ifdef _MSC_VER
+    return (_xgetbv(0) & 6) == 6;
+#else
+    unsigned int lo, hi;
+    __asm__ volatile ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return (lo & 6) == 6;
+#endif
+}
+
+int mpadsp_cpu_level(void)
+{
+    unsigned int regs[4];
+    unsigned int max_leaf;
+    int level = MPAUDEC_SIMD_NONE;
+
+    cpuid(0, 0, regs);
+    max_leaf = regs[0];
+    if (max_leaf < 1)
+        return level;
+
+    cpuid(1, 0, regs);
+    if (regs[3] & (1 << 26))
+        level = MPAUDEC_SIMD_SSE2;
+
+    /* OSXSAVE and AVX, then AVX2 from leaf 7 */
+    if (level && max_leaf >= 7 &&
+        (regs[2] & (1 << 27)) && (regs[2] & (1 << 28)) && os_saves_ymm()) {
+        cpuid(7, 0, regs);
+        if (regs[1] & (1 << 5))
+            level = MPAUDEC_SIMD_AVX2;
+    }
+    return level;
+}
+
+#else
+
+int mpadsp_cpu_level(void)
+{
+    return MPAUDEC_SIMD_NONE;
+}
+
+#endif /* MPAUDEC_SIMD */
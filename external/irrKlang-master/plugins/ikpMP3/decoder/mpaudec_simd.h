@@ -0,0 +1,46 @@
+/* SIMD kernels for the stand-alone mpaudec library.  Each kernel
+   reproduces the scalar reference in mpaudec.c bit for bit: all
+   products are exact 32x32->64 bit multiplies summed in 64 bit, only
+   the order of the additions differs. */
+
+#ifndef MPAUDEC_SIMD_H
+#define MPAUDEC_SIMD_H
+
+#include "internal.h"
+
+#if !defined(MPAUDEC_NO_SIMD) && \
+    (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86))
+#    define MPAUDEC_SIMD
+#endif
+
+/* fixed point format the kernels are written for (USE_HIGHPRECISION) */
+#define MPADSP_FRAC_BITS 23
+#define MPADSP_OUT_SHIFT 24
+
+typedef struct MPADSPContext {
+    /* polyphase window of synth_filter: 32 output samples from the
+       ring buffer, written every incr samples */
+    void (*synth_window)(const int32_t *synth_buf, const int32_t *window,
+                         int16_t *samples, int incr);
+    /* long block IMDCT, window and overlap of four sub bands starting
+       at an even one. win is the window of the even sub bands, the odd
+       ones use the frequency inverted copy 4 * 36 entries further on */
+    void (*imdct36_x4)(int32_t *sb_samples, int32_t *mdct_buf,
+                       int32_t *in, const int32_t *win);
+    /* stereo processing of one band or the whole granule */
+    void (*ms_stereo)(int32_t *tab0, int32_t *tab1, int len);
+    void (*ms_stereo_scaled)(int32_t *tab0, int32_t *tab1, int len,
+                             int32_t scale);
+    void (*i_stereo)(int32_t *tab0, int32_t *tab1, int len,
+                     int32_t v1, int32_t v2);
+} MPADSPContext;
+
+/* highest MPAUDEC_SIMD_* level the CPU and OS support */
+int mpadsp_cpu_level(void);
+
+#ifdef MPAUDEC_SIMD
+void mpadsp_init_sse2(MPADSPContext *c);
+void mpadsp_init_avx2(MPADSPContext *c);
+#endif
+
+#endif /* MPAUDEC_SIMD_H */
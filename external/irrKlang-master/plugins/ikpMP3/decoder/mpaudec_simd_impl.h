@@ -0,0 +1,382 @@
+/* Kernel bodies shared by the SSE2 and AVX2 builds, included by
+   mpaudec_simd.c with MPADSP_FN, MPADSP_TARGET and MPADSP_AVX2 set.
+   Values are handled four at a time: 32 bit lanes in an __m128i and
+   their 64 bit products in a W64 (one __m256i with AVX2, an even and
+   an odd __m128i with SSE2). */
+
+#if MPADSP_AVX2
+
+typedef __m256i MPADSP_FN(w64);
+#define W64 MPADSP_FN(w64)
+
+/* signed 32x32->64 of four lanes */
+static MPADSP_INLINE MPADSP_TARGET W64 MPADSP_FN(mul4)(__m128i a, __m128i b)
+{
+    return _mm256_mul_epi32(_mm256_cvtepi32_epi64(a), _mm256_cvtepi32_epi64(b));
+}
+
+static MPADSP_INLINE MPADSP_TARGET W64 MPADSP_FN(add4)(W64 a, W64 b)
+{
+    return _mm256_add_epi64(a, b);
+}
+
+static MPADSP_INLINE MPADSP_TARGET W64 MPADSP_FN(sub4)(W64 a, W64 b)
+{
+    return _mm256_sub_epi64(a, b);
+}
+
+static MPADSP_INLINE MPADSP_TARGET W64 MPADSP_FN(zero4)(void)
+{
+    return _mm256_setzero_si256();
+}
+
+static MPADSP_INLINE MPADSP_TARGET W64 MPADSP_FN(set4)(int64_t v)
+{
+    return _mm256_set1_epi64x(v);
+}
+
+/* low 32 bits of (a >> shift), the same as the int conversion in the
+   scalar code. A logical shift is enough as the sign bits never reach
+   the low half for shift < 32 */
+static MPADSP_INLINE MPADSP_TARGET __m128i MPADSP_FN(shr4)(W64 a, int shift)
+{
+    a = _mm256_srl_epi64(a, _mm_cvtsi32_si128(shift));
+    a = _mm256_permutevar8x32_epi32(a, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6));
+    return _mm256_castsi256_si128(a);
+}
+
+#else
+
+typedef struct MPADSP_FN(w64) {
+    __m128i even; /* lanes 0 and 2 */
+    __m128i odd;  /* lanes 1 and 3 */
+} MPADSP_FN(w64);
+#define W64 MPADSP_FN(w64)
+
+/* SSE2 only multiplies unsigned, the signed product is
+   a * b - ((a < 0 ? b : 0) + (b < 0 ? a : 0)) << 32 */
+static MPADSP_INLINE MPADSP_TARGET W64 MPADSP_FN(mul4)(__m128i a, __m128i b)
+{
+    W64 r;
+    __m128i fix = _mm_add_epi32(_mm_and_si128(_mm_srai_epi32(a, 31), b),
+                                _mm_and_si128(_mm_srai_epi32(b, 31), a));
+    r.even = _mm_sub_epi64(_mm_mul_epu32(a, b), _mm_slli_epi64(fix, 32));
+    r.odd = _mm_sub_epi64(_mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32)),
+                          _mm_and_si128(fix, _mm_set_epi32(-1, 0, -1, 0)));
+    return r;
+}
+
+static MPADSP_INLINE MPADSP_TARGET W64 MPADSP_FN(add4)(W64 a, W64 b)
+{
+    a.even = _mm_add_epi64(a.even, b.even);
+    a.odd = _mm_add_epi64(a.odd, b.odd);
+    return a;
+}
+
+static MPADSP_INLINE MPADSP_TARGET W64 MPADSP_FN(sub4)(W64 a, W64 b)
+{
+    a.even = _mm_sub_epi64(a.even, b.even);
+    a.odd = _mm_sub_epi64(a.odd, b.odd);
+    return a;
+}
+
+static MPADSP_INLINE MPADSP_TARGET W64 MPADSP_FN(zero4)(void)
+{
+    W64 r;
+    r.even = _mm_setzero_si128();
+    r.odd = r.even;
+    return r;
+}
+
+static MPADSP_INLINE MPADSP_TARGET W64 MPADSP_FN(set4)(int64_t v)
+{
+    W64 r;
+    r.even = _mm_set_epi32((int)(v >> 32), (int)v, (int)(v >> 32), (int)v);
+    r.odd = r.even;
+    return r;
+}
+
+static MPADSP_INLINE MPADSP_TARGET __m128i MPADSP_FN(shr4)(W64 a, int shift)
+{
+    __m128i count = _mm_cvtsi32_si128(shift);
+    __m128i even = _mm_srl_epi64(a.even, count);
+    __m128i odd = _mm_srl_epi64(a.odd, count);
+    return _mm_or_si128(_mm_and_si128(even, _mm_set_epi32(0, -1, 0, -1)),
+                        _mm_slli_epi64(odd, 32));
+}
+
+#endif
+
+#define MUL4  MPADSP_FN(mul4)
+#define ADD4  MPADSP_FN(add4)
+#define SUB4  MPADSP_FN(sub4)
+#define ZERO4 MPADSP_FN(zero4)
+#define SET4  MPADSP_FN(set4)
+#define SHR4  MPADSP_FN(shr4)
+
+#define LOAD4(p)     _mm_loadu_si128((const __m128i *)(p))
+#define STORE4(p, v) _mm_storeu_si128((__m128i *)(p), v)
+#define REV4(v)      _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3))
+#define SPLAT4(c)    _mm_set1_epi32(c)
+
+/* MUL64, MULL and FRAC_RND of mpaudec.c on four lanes */
+#define MUL64_4(a, b) MUL4(a, b)
+#define MULL_4(a, b)  SHR4(MUL4(a, b), MPADSP_FRAC_BITS)
+#define FRAC_RND_4(w) SHR4(ADD4(w, SET4((int64_t)1 << (MPADSP_FRAC_BITS - 1))), MPADSP_FRAC_BITS)
+
+/* round_sample: the packs saturate to 16 bit like the scalar clamp */
+static MPADSP_INLINE MPADSP_TARGET void MPADSP_FN(round4)(int16_t *out, W64 sum)
+{
+    __m128i v = SHR4(ADD4(sum, SET4((int64_t)1 << (MPADSP_OUT_SHIFT - 1))), MPADSP_OUT_SHIFT);
+    _mm_storel_epi64((__m128i *)out, _mm_packs_epi32(v, v));
+}
+
+/* the windowing half of synth_filter. Sample j < 16 and sample 32 - j
+   are sums over the same ring buffer entries, which run contiguously
+   (or reversed) with j, so four neighbouring samples form a vector */
+static MPADSP_TARGET void MPADSP_FN(synth_window)(const int32_t *synth_buf,
+                                                  const int32_t *window,
+                                                  int16_t *samples, int incr)
+{
+    int16_t out[32];
+    int16_t tmp[4];
+    int64_t sum;
+    int j, k;
+
+    /* samples 0..15 */
+    for(j=0;j<16;j+=4) {
+        W64 acc = ZERO4();
+        for(k=0;k<8;k++) {
+            const int32_t *w = window + j + k * 64;
+            const int32_t *p = synth_buf + k * 64;
+            acc = ADD4(acc, MUL4(LOAD4(w), LOAD4(p + 16 + j)));
+            acc = SUB4(acc, MUL4(LOAD4(w + 32), REV4(LOAD4(p + 45 - j))));
+        }
+        MPADSP_FN(round4)(out + j, acc);
+    }
+
+    /* samples 31..16, the last lane of the last group is sample 16
+       which has a sum of its own below */
+    for(j=1;j<17;j+=4) {
+        W64 acc = ZERO4();
+        for(k=0;k<8;k++) {
+            const int32_t *w = window + k * 64;
+            const int32_t *p = synth_buf + k * 64;
+            acc = SUB4(acc, MUL4(REV4(LOAD4(w + 29 - j)), LOAD4(p + 16 + j)));
+            acc = SUB4(acc, MUL4(REV4(LOAD4(w + 61 - j)), REV4(LOAD4(p + 45 - j))));
+        }
+        MPADSP_FN(round4)(tmp, acc);
+        for(k=0;k<4;k++)
+            out[32 - j - k] = tmp[k];
+    }
+
+    sum = 0;
+    for(k=0;k<8;k++)
+        sum -= (int64_t)window[48 + k * 64] * synth_buf[32 + k * 64];
+    sum = (sum + ((int64_t)1 << (MPADSP_OUT_SHIFT - 1))) >> MPADSP_OUT_SHIFT;
+    out[16] = (int16_t)(sum < -32768 ? -32768 : (sum > 32767 ? 32767 : sum));
+
+    for(j=0;j<32;j++) {
+        *samples = out[j];
+        samples += incr;
+    }
+}
+
+/* imdct36 of mpaudec.c with one sub band per lane, followed by the
+   window and overlap of compute_imdct */
+static MPADSP_TARGET void MPADSP_FN(imdct36_x4)(int32_t *sb_samples,
+                                                int32_t *mdct_buf,
+                                                int32_t *in,
+                                                const int32_t *win)
+{
+    __m128i x[18], tmp[18], out[36];
+    __m128i t0, t1, t2, t3, s0, s1, s2, s3;
+    W64 in3_3, in6_6;
+    int32_t buf[4];
+    int i, j;
+
+    /* transpose: lane n holds sub band n */
+    for(i=0;i<18;i++)
+        x[i] = _mm_set_epi32(in[54 + i], in[36 + i], in[18 + i], in[i]);
+
+    for(i=17;i>=1;i--)
+        x[i] = _mm_add_epi32(x[i], x[i-1]);
+    for(i=17;i>=3;i-=2)
+        x[i] = _mm_add_epi32(x[i], x[i-2]);
+
+    for(j=0;j<2;j++) {
+        __m128i *tmp1 = tmp + j;
+        const __m128i *in1 = x + j;
+
+        in3_3 = MUL64_4(in1[2*3], SPLAT4(C3));
+        in6_6 = MUL64_4(in1[2*6], SPLAT4(C6));
+
+        tmp1[0] = FRAC_RND_4(ADD4(ADD4(ADD4(MUL64_4(in1[2*1], SPLAT4(C1)), in3_3),
+                                       MUL64_4(in1[2*5], SPLAT4(C5))),
+                                  MUL64_4(in1[2*7], SPLAT4(C7))));
+        tmp1[2] = _mm_add_epi32(in1[2*0],
+                                FRAC_RND_4(ADD4(ADD4(ADD4(MUL64_4(in1[2*2], SPLAT4(C2)),
+                                                          MUL64_4(in1[2*4], SPLAT4(C4))),
+                                                     in6_6),
+                                                MUL64_4(in1[2*8], SPLAT4(C8)))));
+        tmp1[4] = FRAC_RND_4(MUL64_4(_mm_sub_epi32(_mm_sub_epi32(in1[2*1], in1[2*5]), in1[2*7]),
+                                     SPLAT4(C3)));
+        tmp1[6] = _mm_add_epi32(_mm_sub_epi32(
+                      FRAC_RND_4(MUL64_4(_mm_sub_epi32(_mm_sub_epi32(in1[2*2], in1[2*4]), in1[2*8]),
+                                         SPLAT4(C6))),
+                      in1[2*6]), in1[2*0]);
+        tmp1[8] = FRAC_RND_4(ADD4(SUB4(SUB4(MUL64_4(in1[2*1], SPLAT4(C5)), in3_3),
+                                       MUL64_4(in1[2*5], SPLAT4(C7))),
+                                  MUL64_4(in1[2*7], SPLAT4(C1))));
+        tmp1[10] = _mm_add_epi32(in1[2*0],
+                                 FRAC_RND_4(ADD4(ADD4(SUB4(MUL64_4(in1[2*2], SPLAT4(-C8)),
+                                                           MUL64_4(in1[2*4], SPLAT4(C2))),
+                                                      in6_6),
+                                                 MUL64_4(in1[2*8], SPLAT4(C4)))));
+        tmp1[12] = FRAC_RND_4(SUB4(ADD4(SUB4(MUL64_4(in1[2*1], SPLAT4(C7)), in3_3),
+                                        MUL64_4(in1[2*5], SPLAT4(C1))),
+                                   MUL64_4(in1[2*7], SPLAT4(C5))));
+        tmp1[14] = _mm_add_epi32(in1[2*0],
+                                 FRAC_RND_4(SUB4(ADD4(ADD4(MUL64_4(in1[2*2], SPLAT4(-C4)),
+                                                           MUL64_4(in1[2*4], SPLAT4(C8))),
+                                                      in6_6),
+                                                 MUL64_4(in1[2*8], SPLAT4(C2)))));
+        tmp1[16] = _mm_add_epi32(_mm_sub_epi32(_mm_add_epi32(_mm_sub_epi32(in1[2*0], in1[2*2]),
+                                                             in1[2*4]),
+                                               in1[2*6]),
+                                 in1[2*8]);
+    }
+
+    i = 0;
+    for(j=0;j<4;j++) {
+        t0 = tmp[i];
+        t1 = tmp[i + 2];
+        s0 = _mm_add_epi32(t1, t0);
+        s2 = _mm_sub_epi32(t1, t0);
+
+        t2 = tmp[i + 1];
+        t3 = tmp[i + 3];
+        s1 = MULL_4(_mm_add_epi32(t3, t2), SPLAT4(mpa_icos36[j]));
+        s3 = MULL_4(_mm_sub_epi32(t3, t2), SPLAT4(mpa_icos36[8 - j]));
+
+        t0 = MULL_4(_mm_add_epi32(s0, s1), SPLAT4(mpa_icos72[9 + 8 - j]));
+        t1 = MULL_4(_mm_sub_epi32(s0, s1), SPLAT4(mpa_icos72[8 - j]));
+        out[18 + 9 + j] = t0;
+        out[18 + 8 - j] = t0;
+        out[9 + j] = _mm_sub_epi32(_mm_setzero_si128(), t1);
+        out[8 - j] = t1;
+
+        t0 = MULL_4(_mm_add_epi32(s2, s3), SPLAT4(mpa_icos72[9 + j]));
+        t1 = MULL_4(_mm_sub_epi32(s2, s3), SPLAT4(mpa_icos72[j]));
+        out[18 + 9 + (8 - j)] = t0;
+        out[18 + j] = t0;
+        out[9 + (8 - j)] = _mm_sub_epi32(_mm_setzero_si128(), t1);
+        out[j] = t1;
+        i += 4;
+    }
+
+    s0 = tmp[16];
+    s1 = MULL_4(tmp[17], SPLAT4(mpa_icos36[4]));
+    t0 = MULL_4(_mm_add_epi32(s0, s1), SPLAT4(mpa_icos72[9 + 4]));
+    t1 = MULL_4(_mm_sub_epi32(s0, s1), SPLAT4(mpa_icos72[4]));
+    out[18 + 9 + 4] = t0;
+    out[18 + 8 - 4] = t0;
+    out[9 + 4] = _mm_sub_epi32(_mm_setzero_si128(), t1);
+    out[8 - 4] = t1;
+
+    /* window & overlap. The four sub bands of a row of sb_samples are
+       contiguous, the overlap buffer is one 18 entry block per band */
+    for(i=0;i<18;i++) {
+        const int32_t *win_inv = win + 4 * 36;
+        __m128i w0 = _mm_set_epi32(win_inv[i], win[i], win_inv[i], win[i]);
+        __m128i w1 = _mm_set_epi32(win_inv[i + 18], win[i + 18], win_inv[i + 18], win[i + 18]);
+        __m128i prev = _mm_set_epi32(mdct_buf[54 + i], mdct_buf[36 + i],
+                                     mdct_buf[18 + i], mdct_buf[i]);
+
+        STORE4(sb_samples + i * SBLIMIT, _mm_add_epi32(MULL_4(out[i], w0), prev));
+
+        STORE4(buf, MULL_4(out[i + 18], w1));
+        mdct_buf[i] = buf[0];
+        mdct_buf[18 + i] = buf[1];
+        mdct_buf[36 + i] = buf[2];
+        mdct_buf[54 + i] = buf[3];
+    }
+}
+
+static MPADSP_TARGET void MPADSP_FN(ms_stereo)(int32_t *tab0, int32_t *tab1, int len)
+{
+    int i;
+    for(i=0;i+4<=len;i+=4) {
+        __m128i a = LOAD4(tab0 + i);
+        __m128i b = LOAD4(tab1 + i);
+        STORE4(tab0 + i, _mm_add_epi32(a, b));
+        STORE4(tab1 + i, _mm_sub_epi32(a, b));
+    }
+    for(;i<len;i++) {
+        int32_t tmp0 = tab0[i];
+        int32_t tmp1 = tab1[i];
+        tab0[i] = tmp0 + tmp1;
+        tab1[i] = tmp0 - tmp1;
+    }
+}
+
+static MPADSP_TARGET void MPADSP_FN(ms_stereo_scaled)(int32_t *tab0, int32_t *tab1,
+                                                      int len, int32_t scale)
+{
+    __m128i s = SPLAT4(scale);
+    int i;
+    for(i=0;i+4<=len;i+=4) {
+        __m128i a = LOAD4(tab0 + i);
+        __m128i b = LOAD4(tab1 + i);
+        STORE4(tab0 + i, MULL_4(_mm_add_epi32(a, b), s));
+        STORE4(tab1 + i, MULL_4(_mm_sub_epi32(a, b), s));
+    }
+    for(;i<len;i++) {
+        int32_t tmp0 = tab0[i];
+        int32_t tmp1 = tab1[i];
+        tab0[i] = (int32_t)(((int64_t)(tmp0 + tmp1) * scale) >> MPADSP_FRAC_BITS);
+        tab1[i] = (int32_t)(((int64_t)(tmp0 - tmp1) * scale) >> MPADSP_FRAC_BITS);
+    }
+}
+
+static MPADSP_TARGET void MPADSP_FN(i_stereo)(int32_t *tab0, int32_t *tab1, int len,
+                                              int32_t v1, int32_t v2)
+{
+    __m128i s1 = SPLAT4(v1);
+    __m128i s2 = SPLAT4(v2);
+    int i;
+    for(i=0;i+4<=len;i+=4) {
+        __m128i a = LOAD4(tab0 + i);
+        STORE4(tab0 + i, MULL_4(a, s1));
+        STORE4(tab1 + i, MULL_4(a, s2));
+    }
+    for(;i<len;i++) {
+        int32_t tmp0 = tab0[i];
+        tab0[i] = (int32_t)(((int64_t)tmp0 * v1) >> MPADSP_FRAC_BITS);
+        tab1[i] = (int32_t)(((int64_t)tmp0 * v2) >> MPADSP_FRAC_BITS);
+    }
+}
+
+void MPADSP_FN(mpadsp_init)(MPADSPContext *c)
+{
+    c->synth_window = MPADSP_FN(synth_window);
+    c->imdct36_x4 = MPADSP_FN(imdct36_x4);
+    c->ms_stereo = MPADSP_FN(ms_stereo);
+    c->ms_stereo_scaled = MPADSP_FN(ms_stereo_scaled);
+    c->i_stereo = MPADSP_FN(i_stereo);
+}
+
+#undef W64
+#undef MUL4
+#undef ADD4
+#undef SUB4
+#undef ZERO4
+#undef SET4
+#undef SHR4
+#undef LOAD4
+#undef STORE4
+#undef REV4
+#undef SPLAT4
+#undef MUL64_4
+#undef MULL_4
+#undef FRAC_RND_4
@@ -0,0 +1,27 @@
+// Copyright (C) 2002-2007 Nikolaus Gebhardt
+// This file is part of the ikpMP3 plugin for irrKlang.
+// See license.txt for license details of this plugin.
+
+#ifndef __I_IRRKLANG_MAPPED_FILE_READER_H_INCLUDED__
+#define __I_IRRKLANG_MAPPED_FILE_READER_H_INCLUDED__
+
+#include <ik_IFileReader.h>
+
+namespace irrklang
+{
+
+	//! File reader whose whole contents are addressable in memory, for example a memory mapped file.
+	/** Return readers implementing this from an IFileFactory and the MP3 decoder reads the
+	frames straight from the data instead of copying them through read(). The data has to
+	stay valid and unchanged as long as the reader is alive. */
+	class IMappedFileReader : public IFileReader
+	{
+	public:
+
+		//! returns the start of the file's contents, getSize() bytes long
+		virtual const ik_u8* getData() = 0;
+	};
+
+} // end namespace irrklang
+
+#endif
@@ -0,0 +1,39 @@
+#version 450 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in uint aInstance;
+
+struct Instance
+{
+    mat4 model;
+    mat3 normalMatrix;  //inverse transpose, filled in on the CPU
+    vec4 color;
+    uvec4 info;     //x = group, y = material
+};
+
+layout (std430, binding = 0) readonly buffer Instances { Instance instances[]; };
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+flat out vec3 OverrideColor;
+flat out uint MaterialIndex;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    Instance inst = instances[aInstance];
+
+    vec4 worldPos = inst.model * vec4(aPos, 1.0);
+    FragPos       = worldPos.xyz;
+    Normal        = inst.normalMatrix * aNormal;
+    TexCoords     = aTexCoords;
+    OverrideColor = inst.color.rgb;
+    MaterialIndex = inst.info.y;
+
+    gl_Position = projection * view * worldPos;
+}
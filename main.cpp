@@ -3,6 +3,7 @@
 #include <iostream>
 #include <cstdlib>
 #include <ctime>
+#include <string>
 
 #include <glad.h>
 #include <GLFW/glfw3.h>
@@ -12,7 +13,10 @@
 
 #include "shader_m.h"
 #include "World.h"
+#include "Simulation.h"
+#include "FramePacing.h"
 #include "Physics.h"
+#include "AssetPack.h"
 
 #include <irrKlang.h>
 using namespace irrklang;
@@ -52,6 +56,15 @@ void mouse_callback(GLFWwindow*, double xpos, double ypos)
     cameraFront = glm::normalize(dir);
 }
 
+//E presses stamped when GLFW delivers them, handed to the simulation after the input sample
+std::vector<double> interactPresses;
+
+void key_callback(GLFWwindow*, int key, int, int action, int)
+{
+    if (key == GLFW_KEY_E && action == GLFW_PRESS)
+        interactPresses.push_back(SimClock());
+}
+
 void framebuffer_size_callback(GLFWwindow* window, int w, int h)
 {
     if (h == 0) h = 1;
@@ -65,10 +78,24 @@ void framebuffer_size_callback(GLFWwindow* window, int w, int h)
     }
 }
 
-int main()
+int main(int argc, char** argv)
 {
     World world{};
 
+    //--gpu-balls [count] moves the ball pit to compute shaders
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--gpu-balls")
+        {
+            world.gpuBallPhysics = true;
+            if (i + 1 < argc && std::atoi(argv[i + 1]) > 0)
+                world.gpuBallCount = std::atoi(argv[++i]);
+        }
+    }
+
+    //built by tools/packassets, without it everything loads from loose files
+    MountAssetPack("media.pak");
+
     world.soundEngine = createIrrKlangDevice();
     if (!world.soundEngine)
     {
@@ -76,7 +103,13 @@ int main()
         return -1;
     }
 
-    std::srand((unsigned int)std::time(0));
+    //sound assets are served from memory mappings instead of stdio;
+    //the engine keeps its own reference to the factory
+    world.assetFiles = new MappedFileFactory();
+    world.soundEngine->addFileFactory(world.assetFiles);
+    world.assetFiles->drop();
+
+    world.rng.seed((unsigned int)std::time(0));
 
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
@@ -87,9 +120,22 @@ int main()
     const int initialHeight = 600;
 
     GLFWwindow* window = glfwCreateWindow(initialWidth, initialHeight, "WORLD", nullptr, nullptr);
+    if (!window)
+    {
+        //Mesa llvmpipe tops out at 4.5, the shaders only need that
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+        window = glfwCreateWindow(initialWidth, initialHeight, "WORLD", nullptr, nullptr);
+    }
+    if (!window)
+    {
+        std::cerr << "Failed to create an OpenGL 4.5 window\n";
+        glfwTerminate();
+        return -1;
+    }
     glfwMakeContextCurrent(window);
 
     glfwSetCursorPosCallback(window, mouse_callback);
+    glfwSetKeyCallback(window, key_callback);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
@@ -101,9 +147,6 @@ int main()
     gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
     glEnable(GL_DEPTH_TEST);
 
-    Shader shader("model_loading.vert", "model_loading.frag");
-    Shader depthShader("shadow_depth.vert", "shadow_depth.frag");
-
     InitWorld(world);
 
     //shadow init
@@ -134,6 +177,7 @@ int main()
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
     glm::vec3 lightDir = glm::normalize(glm::vec3(0, -1, 0));
+    world.lightDir = lightDir;
 
     glm::mat4 lightProj =
         glm::ortho(-60.f, 60.f, -60.f, 60.f, 0.1f, 100.f);
@@ -145,123 +189,59 @@ int main()
 
     glm::mat4 lightSpace = lightProj * lightView;
 
-    float last = 0;
-    bool  prevEPressed = false;
+    //the simulation steps World on its own thread from here on, this thread
+    //samples input, renders the newest snapshot and presents
+    Simulation sim;
+    StartSimulation(sim, world);
+
+    FramePacer pacer;
+    bool  prevRPressed = false;
+    bool  prevLPressed = false;
 
     while (!glfwWindowShouldClose(window))
     {
-        float now = (float)glfwGetTime();
-        float dt = now - last;
-        last = now;
+        //INPUT, sampled late: after the limiter's wait, right before the view is built
+        SimInput input;
+        input.time = WaitForFrame(pacer);
 
-        //cockroach timers
-        for (auto& r : world.cockroaches)
-            r.time += dt;
+        if (glfwGetKey(window, 'W') == GLFW_PRESS) input.keys |= SIM_KEY_FORWARD;
+        if (glfwGetKey(window, 'S') == GLFW_PRESS) input.keys |= SIM_KEY_BACK;
+        if (glfwGetKey(window, 'A') == GLFW_PRESS) input.keys |= SIM_KEY_LEFT;
+        if (glfwGetKey(window, 'D') == GLFW_PRESS) input.keys |= SIM_KEY_RIGHT;
+        if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) input.keys |= SIM_KEY_JUMP;
+        input.front = cameraFront;
 
-        //INPUT
-        float speed = 6.0f;
+        SubmitSimInput(sim, input);
 
-        glm::vec3 fwd = glm::normalize(glm::vec3(cameraFront.x, 0, cameraFront.z));
-        glm::vec3 right = glm::normalize(glm::cross(fwd, cameraUp));
-
-        if (glfwGetKey(window, 'W') == GLFW_PRESS) world.player.pos += fwd * speed * dt;
-        if (glfwGetKey(window, 'S') == GLFW_PRESS) world.player.pos -= fwd * speed * dt;
-        if (glfwGetKey(window, 'A') == GLFW_PRESS) world.player.pos -= right * speed * dt;
-        if (glfwGetKey(window, 'D') == GLFW_PRESS) world.player.pos += right * speed * dt;
-
-        if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS && world.player.grounded)
+        //E interaction, handled on the simulation thread at the press time
+        for (double t : interactPresses)
         {
-            world.player.vel.y = 6;
-            world.player.grounded = false;
+            SimEvent ev;
+            ev.type = SIM_EVENT_INTERACT;
+            ev.time = t;
+            SubmitSimEvent(sim, ev);
         }
+        interactPresses.clear();
 
-        //E interaction
-        int  eState = glfwGetKey(window, GLFW_KEY_E);
-        bool ePressedNow = (eState == GLFW_PRESS);
-
-        if (ePressedNow && !prevEPressed)
+        //R cycles the internal render scale 100% -> 75% -> 50%
+        bool rPressedNow = (glfwGetKey(window, 'R') == GLFW_PRESS);
+        if (rPressedNow && !prevRPressed)
         {
-            //cockroach interaction
-            float bestDist2 = 3.0f * 3.0f;
-            int   bestIdx = -1;
-
-            for (int i = 0; i < (int)world.cockroaches.size(); ++i)
-            {
-                const auto& r = world.cockroaches[i];
-                float d2 = glm::length(world.player.pos - r.pos);
-                if (d2 < bestDist2)
-                {
-                    bestDist2 = d2;
-                    bestIdx = i;
-                }
-            }
-
-            if (bestIdx >= 0)
-            {
-                auto& r = world.cockroaches[bestIdx];
-                r.dancing = !r.dancing;
-
-                //check if all roaches are dancing
-                bool allDancing = !world.cockroaches.empty();
-                for (const auto& c : world.cockroaches)
-                {
-                    if (!c.dancing)
-                    {
-                        allDancing = false;
-                        break;
-                    }
-                }
-
-                if (allDancing)
-                {
-                    if (!world.starRoachesAwarded)
-                    {
-                        world.starRoachesAwarded = true;
-                        world.starCount++;
-                        std::cout << "All roaches dancing! +1 STAR (total: " << world.starCount << ")\n";
-                    }
-                    else
-                    {
-                        std::cout << "All roaches dancing (star already awarded)\n";
-                    }
-                }
-            }
-
-            //golden ball interaction
-            if (world.goldenBallIndex >= 0 &&
-                world.goldenBallIndex < (int)world.balls.size())
-            {
-                Sphere& golden = world.balls[world.goldenBallIndex];
-                float dist = glm::length(world.player.pos - golden.pos);
-
-                if (dist < 2.0f)
-                {
-                    golden.radius = 0.0f; //disappear
-                    world.goldenBallIndex = -1;
-
-                    //award star
-                    if (!world.starGoldenBallAwarded)
-                    {
-                        world.starGoldenBallAwarded = true;
-                        world.starCount++;
-                        std::cout << "Found the golden ball! +1 STAR (total: " << world.starCount << ")\n";
-                    }
-                    else
-                    {
-                        std::cout << "Found the golden ball (star already awarded)\n";
-                    }
-                }
-            }
-
-            //QTE interaction
-            HandleQTEInput(world);
-            HandleSkullModeInput(world);
+            float& scale = world.post.renderScale;
+            scale = (scale > 0.9f) ? 0.75f : (scale > 0.6f) ? 0.5f : 1.0f;
+            std::cout << "Render scale: " << (int)(scale * 100.0f) << "%\n";
         }
-        prevEPressed = ePressedNow;
+        prevRPressed = rPressedNow;
 
-        //update and camera
-        UpdateWorld(world, dt);
-        cameraPos = world.player.pos + glm::vec3(0, 1, 0);
+        //L cycles the frame limiter off -> 30 -> 60 -> 120
+        bool lPressedNow = (glfwGetKey(window, 'L') == GLFW_PRESS);
+        if (lPressedNow && !prevLPressed)
+            CycleFrameLimit(pacer);
+        prevLPressed = lPressedNow;
+
+        //camera from the newest step, look direction from this frame's mouse
+        const RenderSnapshot& snap = AcquireSnapshot(sim);
+        cameraPos = snap.eye;
 
         //use current window size for aspect
         float aspect = (world.screenHeight != 0)
@@ -273,21 +253,24 @@ int main()
         glm::mat4 view =
             glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
 
-        shader.use();
-        shader.setVec3("lightDir", lightDir);
-
-        RenderWorld(world, shader, depthShader,
+        RenderWorld(world, snap,
             lightSpace, view, proj,
             depthTex, depthFBO, SHW, SHH);
 
         glfwSwapBuffers(window);
-        glfwPollEvents();
+        EndFrame(pacer, snap);
     }
 
-    if (world.cucarachaSound)
-        world.cucarachaSound->drop(); 
+    StopSimulation(sim);
+    PrintFramePacing(pacer);
+    PrintGpuBallStats(world.gpuBalls);
+
+    SetContactSink(nullptr, 0.0f);
+    StopImpactAudio(world.impactAudio);
+    ShutdownSfx(world.sfx);
     if (world.soundEngine)
         world.soundEngine->drop();
+    UnmountAssetPacks();
 
     return 0;
 }
\ No newline at end of file
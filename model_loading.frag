@@ -1,70 +1,57 @@
-﻿#version 460 core
+﻿#version 450 core
 
 out vec4 FragColor;
 
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
+flat in vec3 OverrideColor;   //per draw uniform or per instance
 
-uniform sampler2D texture_diffuse1;
 uniform sampler2D shadowMap;
 uniform sampler2D groundTex;
 
 uniform vec3  lightDir;
-uniform vec3  overrideColor;
 uniform mat4  lightSpaceMatrix;
 uniform int   useTexture;     
 
+#if !defined(BASE_COLOR) && !defined(BASE_GROUND)
+flat in uint MaterialIndex;
 
-uniform bool  qteVisible;
-uniform float qteInnerRadius;
-uniform float qteOuterRadius;
-uniform vec3  qteInnerColor;
-uniform vec3  qteOuterColor;
-uniform float qteAspect;   // NEW
-uniform vec2 qteScreenSize;
+//MaterialRegistry: x = array, y = layer, x < 0 is untextured
+layout (std430, binding = 5) readonly buffer Materials { ivec4 materials[]; };
 
-uniform int   isUI;         
+//size bucketed arrays, MATERIAL_MAX_ARRAYS of them, units set once at load
+uniform sampler2DArray materialArrays[8];
 
-
-float StarMask(vec2 p)
+vec3 MaterialColor(uint index, vec3 untextured)
 {
-    // scale
-    p *= 1.1;
-
-    const float PI = 3.14159265;
-    float an = atan(p.y, p.x);
-    float r  = length(p);
-
-    //rotate
-    an += PI * 0.5;
-
-    // 5 points = 2*pi/5 sector
-    float k = 5.0;
-    float sector = 2.0 * PI / k;
-
-    //bring angle into [0, sector)
-    an = mod(an, sector);
-
-    float m = abs(an - sector * 0.5) / (sector * 0.5);
-
-    //inner vs outer radius
-    float R  = 1.0;   // outer radius
-    float Ri = 0.45;  // inner radius (star "valleys")
+    //gradients before the non uniform branch, the array changes per fragment
+    vec2 dx = dFdx(TexCoords);
+    vec2 dy = dFdy(TexCoords);
 
-    //star radius at this angle
-    float starR = mix(R, Ri, m);
+    ivec4 m = materials[index];
+    vec3 uvw = vec3(TexCoords, float(m.y));
 
-    //signed distance >0 outside <0 inside
-    float d = r - starR;
-
-    // hard edge star 1 inside 0 outside
-    float mask = step(d, 0.0);
+    //sampler arrays only take constant indices here
+    vec3 texColor;
+    switch (m.x)
+    {
+    case 0: texColor = textureGrad(materialArrays[0], uvw, dx, dy).rgb; break;
+    case 1: texColor = textureGrad(materialArrays[1], uvw, dx, dy).rgb; break;
+    case 2: texColor = textureGrad(materialArrays[2], uvw, dx, dy).rgb; break;
+    case 3: texColor = textureGrad(materialArrays[3], uvw, dx, dy).rgb; break;
+    case 4: texColor = textureGrad(materialArrays[4], uvw, dx, dy).rgb; break;
+    case 5: texColor = textureGrad(materialArrays[5], uvw, dx, dy).rgb; break;
+    case 6: texColor = textureGrad(materialArrays[6], uvw, dx, dy).rgb; break;
+    case 7: texColor = textureGrad(materialArrays[7], uvw, dx, dy).rgb; break;
+    default: return untextured;
+    }
 
-    //small feather to avoid aliasing
-    float feather = 0.01;
-    return smoothstep(feather, -feather, d) * mask;
+    if (texColor == vec3(0.0))
+        return vec3(1.0);
+    return texColor;
 }
+#endif
 
 
 //shadow calculation
@@ -103,9 +90,19 @@ void main()
 {
     vec3 baseColor;
 
-    if (overrideColor.x >= 0.0)
+    //base colour source is picked at compile time per draw type,
+    //without a BASE_* define every source is resolved at runtime
+#if defined(BASE_COLOR)
+    baseColor = OverrideColor;
+#elif defined(BASE_GROUND)
+    baseColor = texture(groundTex, TexCoords).rgb;
+#elif defined(BASE_DIFFUSE) || defined(BASE_INSTANCE)
+    //material 0 keeps the per draw/instance colour
+    baseColor = MaterialColor(MaterialIndex, OverrideColor);
+#else
+    if (OverrideColor.x >= 0.0)
     {
-        baseColor = overrideColor;
+        baseColor = OverrideColor;
     }
     else if (useTexture == 1)
     {
@@ -113,12 +110,9 @@ void main()
     }
     else
     {
-        vec3 texColor = texture(texture_diffuse1, TexCoords).rgb;
-        if (texColor == vec3(0.0))
-            baseColor = vec3(1.0);
-        else
-            baseColor = texColor;
+        baseColor = MaterialColor(MaterialIndex, OverrideColor);
     }
+#endif
 
     vec3 N = normalize(Normal);
     vec3 L = normalize(-lightDir);
@@ -130,44 +124,5 @@ void main()
     float lit = NdotL * (1.0 - shadow);
     vec3 color = ambient + baseColor * lit;
 
-    if (qteVisible)
-    {
-        //centered circle overlay
-        vec2 ndc = (gl_FragCoord.xy / qteScreenSize) * 2.0 - 1.0; 
-        ndc.x *= qteAspect;                                      //keep circle round
-
-        float r = length(ndc);
-
-        if (r <= qteInnerRadius)
-        {
-            color = mix(color, qteInnerColor, 0.8);
-        }
-        else if (r <= qteOuterRadius)
-        {
-            float t = smoothstep(qteInnerRadius, qteOuterRadius, r);
-            t = 1.0 - t;
-            color = mix(color, qteOuterColor, t * 0.8);
-        }
-    }
-
-    //UI star shaping
-    if (isUI == 1)
-    {
-        vec2 uv = TexCoords;
-        if (uv == vec2(0.0))
-        {
-            uv = vec2(0.5);
-        }
-
-        vec2 p = uv * 2.0 - 1.0;
-
-        float m = StarMask(p);
-        if (m <= 0.01)
-            discard;
-
-        vec3 gold = vec3(1.2, 1.0, 0.3);
-        color = mix(color, gold, m);
-    }
-
     FragColor = vec4(color, 1.0);
 }
\ No newline at end of file
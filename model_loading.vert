@@ -1,4 +1,4 @@
-#version 460 core
+#version 450 core
 
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
@@ -7,26 +7,23 @@ layout (location = 2) in vec2 aTexCoords;
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
+flat out vec3 OverrideColor;
+flat out uint MaterialIndex;
 
 uniform mat4 model;
+uniform mat3 normalMatrix;  //inverse transpose of model, set per draw on the CPU
 uniform mat4 view;
 uniform mat4 projection;
-uniform mat4 uiProjection;  
-uniform int  isUI;        
+uniform vec3 overrideColor;
+uniform int  material;      //MaterialRegistry index, 0 is untextured
 
 void main()
 {
     vec4 worldPos = model * vec4(aPos, 1.0);
     FragPos   = worldPos.xyz;
-    Normal    = mat3(transpose(inverse(model))) * aNormal;
+    Normal    = normalMatrix * aNormal;
     TexCoords = aTexCoords;
-
-if (isUI == 1)
-{
-    gl_Position = uiProjection * worldPos;
-}
-else
-{
+    OverrideColor = overrideColor;
+    MaterialIndex = uint(material);
     gl_Position = projection * view * worldPos;
-}
 }
\ No newline at end of file
@@ -0,0 +1,70 @@
+#version 450 core
+
+out vec4 FragColor;
+
+in vec2 Local;
+in vec4 Color;
+flat in vec4 Params;   //shape, inner radius, outer radius
+
+float StarMask(vec2 p)
+{
+    // scale
+    p *= 1.1;
+
+    const float PI = 3.14159265;
+    float an = atan(p.y, p.x);
+    float r  = length(p);
+
+    //rotate
+    an += PI * 0.5;
+
+    // 5 points = 2*pi/5 sector
+    float k = 5.0;
+    float sector = 2.0 * PI / k;
+
+    //bring angle into [0, sector)
+    an = mod(an, sector);
+
+    float m = abs(an - sector * 0.5) / (sector * 0.5);
+
+    //inner vs outer radius
+    float R  = 1.0;   // outer radius
+    float Ri = 0.45;  // inner radius (star "valleys")
+
+    //star radius at this angle
+    float starR = mix(R, Ri, m);
+
+    //signed distance >0 outside <0 inside
+    float d = r - starR;
+
+    // hard edge star 1 inside 0 outside
+    float mask = step(d, 0.0);
+
+    //small feather to avoid aliasing
+    float feather = 0.01;
+    return smoothstep(feather, -feather, d) * mask;
+}
+
+void main()
+{
+    float alpha;
+
+    if (Params.x < 0.5)
+    {
+        alpha = StarMask(Local);
+        if (alpha <= 0.01)
+            discard;
+    }
+    else
+    {
+        float r = length(Local);
+        if (r <= Params.y || r > Params.z)
+            discard;
+
+        alpha = 1.0;
+        if (Params.x > 1.5)
+            alpha = 1.0 - smoothstep(Params.y, Params.z, r);
+    }
+
+    FragColor = vec4(Color.rgb, Color.a * alpha);
+}
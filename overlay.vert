@@ -0,0 +1,20 @@
+#version 450 core
+
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec2 aLocal;
+layout (location = 2) in vec4 aColor;
+layout (location = 3) in vec4 aParams;
+
+out vec2 Local;
+out vec4 Color;
+flat out vec4 Params;
+
+uniform mat4 uiProjection;
+
+void main()
+{
+    Local  = aLocal;
+    Color  = aColor;
+    Params = aParams;
+    gl_Position = uiProjection * vec4(aPos, 0.0, 1.0);
+}
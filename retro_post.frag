@@ -1,12 +1,73 @@
-#version 460 core
+#version 450 core
 
 out vec4 FragColor;
 
 in vec2 TexCoords;
 
-uniform sampler2D sceneTex;
+uniform sampler2D sceneTex;     //HDR scene at the internal resolution
+uniform vec2  texelSize;        //1 / internal resolution
+uniform float exposure;
+uniform float whitePoint;
 uniform float colorSteps;
 uniform float wobbleAmount;
+uniform bool  fxaaEnabled;
+
+//extended Reinhard on luminance, keeps hue and maps whitePoint to 1
+vec3 Tonemap(vec3 hdr)
+{
+    hdr *= exposure;
+    float l = dot(hdr, vec3(0.2126, 0.7152, 0.0722));
+    if (l <= 0.0) return vec3(0.0);
+    float lm = l * (1.0 + l / (whitePoint * whitePoint)) / (1.0 + l);
+    return clamp(hdr * (lm / l), 0.0, 1.0);
+}
+
+vec3 Fetch(vec2 uv)
+{
+    return Tonemap(texture(sceneTex, uv).rgb);
+}
+
+float Luma(vec3 c)
+{
+    return dot(c, vec3(0.299, 0.587, 0.114));
+}
+
+//FXAA 3.11 style edge blend, run on the tonemapped values so edges match what is shown
+vec3 Fxaa(vec2 uv)
+{
+    vec3 rgbM  = Fetch(uv);
+    vec3 rgbNW = Fetch(uv + vec2(-1.0, -1.0) * texelSize);
+    vec3 rgbNE = Fetch(uv + vec2( 1.0, -1.0) * texelSize);
+    vec3 rgbSW = Fetch(uv + vec2(-1.0,  1.0) * texelSize);
+    vec3 rgbSE = Fetch(uv + vec2( 1.0,  1.0) * texelSize);
+
+    float lM  = Luma(rgbM);
+    float lNW = Luma(rgbNW);
+    float lNE = Luma(rgbNE);
+    float lSW = Luma(rgbSW);
+    float lSE = Luma(rgbSE);
+
+    float lMin = min(lM, min(min(lNW, lNE), min(lSW, lSE)));
+    float lMax = max(lM, max(max(lNW, lNE), max(lSW, lSE)));
+
+    //flat area, nothing to smooth
+    if (lMax - lMin < max(0.0312, lMax * 0.125))
+        return rgbM;
+
+    vec2 dir;
+    dir.x = -((lNW + lNE) - (lSW + lSE));
+    dir.y =  ((lNW + lSW) - (lNE + lSE));
+
+    float reduce = max((lNW + lNE + lSW + lSE) * 0.25 * 0.125, 1.0 / 128.0);
+    float rcpMin = 1.0 / (min(abs(dir.x), abs(dir.y)) + reduce);
+    dir = clamp(dir * rcpMin, vec2(-8.0), vec2(8.0)) * texelSize;
+
+    vec3 rgbA = 0.5 * (Fetch(uv + dir * (1.0 / 3.0 - 0.5)) + Fetch(uv + dir * (2.0 / 3.0 - 0.5)));
+    vec3 rgbB = rgbA * 0.5 + 0.25 * (Fetch(uv - dir * 0.5) + Fetch(uv + dir * 0.5));
+
+    float lB = Luma(rgbB);
+    return (lB < lMin || lB > lMax) ? rgbA : rgbB;
+}
 
 void main()
 {
@@ -19,10 +80,11 @@ void main()
         uv += vec2(wx, wy) * 0.001;
     }
 
-    vec3 col = texture(sceneTex, uv).rgb;
+    vec3 col = fxaaEnabled ? Fxaa(uv) : Fetch(uv);
 
+    //retro quantize last so the bands stay hard
     float steps = max(colorSteps, 1.0);
     col = floor(col * steps) / steps;
 
     FragColor = vec4(col, 1.0);
-}
\ No newline at end of file
+}
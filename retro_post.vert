@@ -1,12 +1,11 @@
-#version 460 core
-
-layout (location = 0) in vec2 aPos;
-layout (location = 1) in vec2 aUV;
+#version 450 core
 
+//fullscreen triangle from gl_VertexID, no vertex buffer needed
 out vec2 TexCoords;
 
 void main()
 {
-    TexCoords = aUV;
-    gl_Position = vec4(aPos, 0.0, 1.0);
-}
\ No newline at end of file
+    vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    TexCoords = p;
+    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,59 @@
+#version 450 core
+
+layout (location = 0) in vec2 aGrid;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+flat out vec3 OverrideColor;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+uniform sampler2D heightMap;
+uniform float terrainSize;
+uniform float heightRes;
+uniform float gridDim;
+uniform vec3  eyePos;
+
+uniform vec2  nodeOrigin;
+uniform float nodeSize;
+uniform vec2  morphRange;   //start, end
+
+float SampleHeight(vec2 xz)
+{
+    //texel centres line up with the CPU samples
+    float cells = heightRes - 1.0;
+    vec2 uv = ((xz / terrainSize + 0.5) * cells + 0.5) / heightRes;
+    return textureLod(heightMap, uv, 0.0).r;
+}
+
+void main()
+{
+    vec2 g = aGrid;
+    vec2 xz = nodeOrigin + g * nodeSize;
+    float h = SampleHeight(xz);
+
+    //morph odd vertices onto the coarser grid as the next LOD approaches
+    float dist = distance(eyePos, vec3(xz.x, h, xz.y));
+    float k = clamp((dist - morphRange.x) / (morphRange.y - morphRange.x), 0.0, 1.0);
+    vec2 frac = fract(g * gridDim * 0.5) * 2.0 / gridDim;
+    g -= frac * k;
+
+    xz = nodeOrigin + g * nodeSize;
+    h = SampleHeight(xz);
+
+    float e = terrainSize / (heightRes - 1.0);
+    float hL = SampleHeight(xz - vec2(e, 0.0));
+    float hR = SampleHeight(xz + vec2(e, 0.0));
+    float hD = SampleHeight(xz - vec2(0.0, e));
+    float hU = SampleHeight(xz + vec2(0.0, e));
+
+    vec3 worldPos = vec3(xz.x, h, xz.y);
+    FragPos   = worldPos;
+    Normal    = normalize(vec3(hL - hR, 2.0 * e, hD - hU));
+    TexCoords = xz * 0.5;   //same tiling as the old ground plane
+    OverrideColor = vec3(-1.0);
+
+    gl_Position = projection * view * vec4(worldPos, 1.0);
+}
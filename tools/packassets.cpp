@@ -0,0 +1,206 @@
+//builds the asset pack the game mounts at startup (see PackFormat.h)
+//
+//  packassets [--no-lz4] <output.pak> <dir or file>...
+//
+//run it from the game's working directory so the stored paths match the ones
+//the loaders ask for, e.g. "packassets media.pak media"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../PackFormat.h"
+#include "../Lz4.h"
+
+namespace fs = std::filesystem;
+
+struct PackInput
+{
+    std::string path;   //as found on disk
+    std::string key;    //normalized
+    uint64_t    hash;
+    std::vector<unsigned char> data;
+    uint32_t    size;
+    uint32_t    flags;
+};
+
+//already compressed formats are stored as is, LZ4 only costs load time there
+static bool WorthCompressing(const std::string& key)
+{
+    static const char* stored[] = { ".png", ".jpg", ".jpeg", ".mp3", ".ogg", ".ktx2", ".dds" };
+    for (const char* ext : stored)
+    {
+        size_t n = std::strlen(ext);
+        if (key.size() >= n && key.compare(key.size() - n, n, ext) == 0)
+            return false;
+    }
+    return true;
+}
+
+static bool ReadFile(const std::string& path, std::vector<unsigned char>& out)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) return false;
+
+    out.resize((size_t)file.tellg());
+    file.seekg(0);
+    return (bool)file.read((char*)out.data(), out.size());
+}
+
+static void Collect(const std::string& root, std::vector<std::string>& paths)
+{
+    if (fs::is_regular_file(root))
+    {
+        paths.push_back(root);
+        return;
+    }
+
+    for (const auto& entry : fs::recursive_directory_iterator(root))
+    {
+        if (entry.is_regular_file())
+            paths.push_back(entry.path().generic_string());
+    }
+}
+
+static void Pad(std::ofstream& out, uint64_t& pos, uint64_t align)
+{
+    static const char zeros[PACK_ALIGN] = {};
+    uint64_t pad = (align - pos % align) % align;
+    out.write(zeros, (std::streamsize)pad);
+    pos += pad;
+}
+
+int main(int argc, char** argv)
+{
+    bool lz4 = true;
+    int arg = 1;
+    if (arg < argc && std::strcmp(argv[arg], "--no-lz4") == 0)
+    {
+        lz4 = false;
+        ++arg;
+    }
+    if (argc - arg < 2)
+    {
+        std::cerr << "usage: packassets [--no-lz4] <output.pak> <dir or file>...\n";
+        return 1;
+    }
+    const char* output = argv[arg++];
+
+    std::vector<std::string> paths;
+    for (; arg < argc; ++arg)
+        Collect(argv[arg], paths);
+
+    std::vector<PackInput> inputs;
+    inputs.reserve(paths.size());
+    size_t rawBytes = 0, storedBytes = 0;
+
+    for (const std::string& path : paths)
+    {
+        PackInput in;
+        in.path = path;
+        in.key = NormalizeAssetPath(path.c_str());
+        in.hash = HashAssetPath(in.key);
+        in.flags = 0;
+        if (!ReadFile(path, in.data))
+        {
+            std::cerr << "can't read " << path << "\n";
+            return 1;
+        }
+        if (in.data.size() > 0x7FFFFFFF)
+        {
+            std::cerr << path << " is too large for a pack entry\n";
+            return 1;
+        }
+        in.size = (uint32_t)in.data.size();
+
+        //keep the LZ4 block only when it saves at least an eighth
+        if (lz4 && in.size > 0 && WorthCompressing(in.key))
+        {
+            std::vector<unsigned char> packed(Lz4CompressBound((int)in.size));
+            int n = Lz4Compress(in.data.data(), (int)in.size, packed.data(), (int)packed.size());
+            if (n > 0 && (uint32_t)n < in.size - in.size / 8)
+            {
+                packed.resize(n);
+                in.data.swap(packed);
+                in.flags |= PACK_ENTRY_LZ4;
+            }
+        }
+
+        rawBytes += in.size;
+        storedBytes += in.data.size();
+        inputs.push_back(std::move(in));
+    }
+
+    std::sort(inputs.begin(), inputs.end(), [](const PackInput& a, const PackInput& b)
+    {
+        return a.hash != b.hash ? a.hash < b.hash : a.key < b.key;
+    });
+
+    for (size_t i = 1; i < inputs.size(); ++i)
+    {
+        if (inputs[i].key == inputs[i - 1].key)
+        {
+            std::cerr << inputs[i - 1].path << " and " << inputs[i].path << " map to the same asset\n";
+            return 1;
+        }
+    }
+
+    std::ofstream out(output, std::ios::binary);
+    if (!out)
+    {
+        std::cerr << "can't write " << output << "\n";
+        return 1;
+    }
+
+    PackHeader header = {};
+    header.magic = PACK_MAGIC;
+    header.version = PACK_VERSION;
+    header.entryCount = (uint32_t)inputs.size();
+    out.write((const char*)&header, sizeof(header));
+    uint64_t pos = sizeof(header);
+
+    std::vector<PackEntry> toc(inputs.size());
+    std::string names;
+    for (size_t i = 0; i < inputs.size(); ++i)
+    {
+        Pad(out, pos, PACK_ALIGN);
+
+        PackEntry& e = toc[i];
+        e.hash = inputs[i].hash;
+        e.offset = pos;
+        e.size = inputs[i].size;
+        e.packedSize = (uint32_t)inputs[i].data.size();
+        e.flags = inputs[i].flags;
+        e.nameOffset = (uint32_t)names.size();
+
+        names += inputs[i].key;
+        names += '\0';
+
+        out.write((const char*)inputs[i].data.data(), (std::streamsize)inputs[i].data.size());
+        pos += inputs[i].data.size();
+    }
+
+    Pad(out, pos, alignof(PackEntry));
+    header.tocOffset = pos;
+    out.write((const char*)toc.data(), (std::streamsize)(toc.size() * sizeof(PackEntry)));
+    pos += toc.size() * sizeof(PackEntry);
+
+    header.namesOffset = pos;
+    out.write(names.data(), (std::streamsize)names.size());
+
+    out.seekp(0);
+    out.write((const char*)&header, sizeof(header));
+    if (!out)
+    {
+        std::cerr << "failed writing " << output << "\n";
+        return 1;
+    }
+
+    std::cout << output << ": " << inputs.size() << " assets, "
+              << rawBytes << " bytes -> " << storedBytes << " stored\n";
+    return 0;
+}
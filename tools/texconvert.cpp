@@ -0,0 +1,553 @@
+//converts source images to block compressed .dds files with a full mip chain
+//(see DdsFormat.h), written next to the source so LoadTextureFile finds them
+//
+//  texconvert [--bc7] <image or dir>...
+//
+//opaque images become BC1 (8:1 against RGBA8), images with alpha BC3 (4:1);
+//--bc7 writes BC7 instead, which is core GL and better looking but 4:1
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../DdsFormat.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../external/stb/stb_image.h"
+
+namespace fs = std::filesystem;
+
+struct Image
+{
+    int w = 0, h = 0;
+    std::vector<unsigned char> rgba;
+};
+
+enum BlockFormat
+{
+    FORMAT_BC1,
+    FORMAT_BC3,
+    FORMAT_BC7
+};
+
+//same reduction as glGenerateMipmap: 2x2 box, odd edges clamp
+static Image Downsample(const Image& src)
+{
+    Image dst;
+    dst.w = std::max(1, src.w / 2);
+    dst.h = std::max(1, src.h / 2);
+    dst.rgba.resize((size_t)dst.w * dst.h * 4);
+
+    for (int y = 0; y < dst.h; ++y)
+    {
+        int y0 = std::min(y * 2, src.h - 1), y1 = std::min(y * 2 + 1, src.h - 1);
+        for (int x = 0; x < dst.w; ++x)
+        {
+            int x0 = std::min(x * 2, src.w - 1), x1 = std::min(x * 2 + 1, src.w - 1);
+            for (int c = 0; c < 4; ++c)
+            {
+                int sum = src.rgba[((size_t)y0 * src.w + x0) * 4 + c] + src.rgba[((size_t)y0 * src.w + x1) * 4 + c] +
+                          src.rgba[((size_t)y1 * src.w + x0) * 4 + c] + src.rgba[((size_t)y1 * src.w + x1) * 4 + c];
+                dst.rgba[((size_t)y * dst.w + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+    return dst;
+}
+
+//4x4 block at (bx, by) in floats, edge pixels repeat past the border
+static void FetchBlock(const Image& img, int bx, int by, float px[16][4])
+{
+    for (int i = 0; i < 16; ++i)
+    {
+        int x = std::min(bx * 4 + (i & 3), img.w - 1);
+        int y = std::min(by * 4 + (i >> 2), img.h - 1);
+        for (int c = 0; c < 4; ++c)
+            px[i][c] = img.rgba[((size_t)y * img.w + x) * 4 + c];
+    }
+}
+
+//endpoints on the principal axis of the block, at the extreme projections
+static void PrincipalEndpoints(const float px[16][4], int channels, float a[4], float b[4])
+{
+    float mean[4] = {};
+    for (int i = 0; i < 16; ++i)
+        for (int c = 0; c < channels; ++c)
+            mean[c] += px[i][c] / 16.0f;
+
+    float cov[4][4] = {};
+    for (int i = 0; i < 16; ++i)
+        for (int r = 0; r < channels; ++r)
+            for (int c = 0; c < channels; ++c)
+                cov[r][c] += (px[i][r] - mean[r]) * (px[i][c] - mean[c]);
+
+    float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    for (int iter = 0; iter < 8; ++iter)
+    {
+        float next[4] = {};
+        float len = 0.0f;
+        for (int r = 0; r < channels; ++r)
+        {
+            for (int c = 0; c < channels; ++c)
+                next[r] += cov[r][c] * axis[c];
+            len = std::max(len, std::fabs(next[r]));
+        }
+        if (len < 1e-6f) break;
+        for (int c = 0; c < channels; ++c)
+            axis[c] = next[c] / len;
+    }
+
+    float lo = 1e30f, hi = -1e30f;
+    for (int i = 0; i < 16; ++i)
+    {
+        float t = 0.0f;
+        for (int c = 0; c < channels; ++c)
+            t += (px[i][c] - mean[c]) * axis[c];
+        lo = std::min(lo, t);
+        hi = std::max(hi, t);
+    }
+
+    float len2 = 0.0f;
+    for (int c = 0; c < channels; ++c)
+        len2 += axis[c] * axis[c];
+    if (len2 < 1e-12f) len2 = 1.0f;
+
+    for (int c = 0; c < channels; ++c)
+    {
+        a[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * lo / len2));
+        b[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * hi / len2));
+    }
+}
+
+//least squares endpoints for fixed assignments, t[i] is the weight of b
+static bool RefineEndpoints(const float px[16][4], int channels, const float t[16], float a[4], float b[4])
+{
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[4] = {}, bx[4] = {};
+    for (int i = 0; i < 16; ++i)
+    {
+        float wa = 1.0f - t[i], wb = t[i];
+        aa += wa * wa;
+        ab += wa * wb;
+        bb += wb * wb;
+        for (int c = 0; c < channels; ++c)
+        {
+            ax[c] += wa * px[i][c];
+            bx[c] += wb * px[i][c];
+        }
+    }
+
+    float det = aa * bb - ab * ab;
+    if (std::fabs(det) < 1e-6f) return false;
+
+    for (int c = 0; c < channels; ++c)
+    {
+        a[c] = std::min(255.0f, std::max(0.0f, (ax[c] * bb - bx[c] * ab) / det));
+        b[c] = std::min(255.0f, std::max(0.0f, (bx[c] * aa - ax[c] * ab) / det));
+    }
+    return true;
+}
+
+static float Distance(const float* p, const float* q, int channels)
+{
+    float d = 0.0f;
+    for (int c = 0; c < channels; ++c)
+        d += (p[c] - q[c]) * (p[c] - q[c]);
+    return d;
+}
+
+//--- BC1 ------------------------------------------------------------------
+
+static uint16_t Pack565(const float c[3])
+{
+    int r = (int)std::lround(c[0] * 31.0f / 255.0f);
+    int g = (int)std::lround(c[1] * 63.0f / 255.0f);
+    int b = (int)std::lround(c[2] * 31.0f / 255.0f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void Unpack565(uint16_t v, float c[3])
+{
+    int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+    c[0] = (float)((r << 3) | (r >> 2));
+    c[1] = (float)((g << 2) | (g >> 4));
+    c[2] = (float)((b << 3) | (b >> 2));
+}
+
+//opaque four colour mode; palette order by weight of c1 is 0, 2, 3, 1
+static void EncodeBc1(const float px[16][4], unsigned char out[8])
+{
+    static const int code[4] = { 0, 2, 3, 1 };
+    static const float weight[4] = { 0.0f, 1.0f / 3.0f, 2.0f / 3.0f, 1.0f };
+
+    float a[4], b[4];
+    PrincipalEndpoints(px, 3, a, b);
+
+    float bestErr = 1e30f;
+    uint16_t best0 = 0, best1 = 0;
+    uint32_t bestIdx = 0;
+
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        uint16_t c0 = Pack565(a), c1 = Pack565(b);
+        float e0[3], e1[3], pal[4][3];
+        Unpack565(c0, e0);
+        Unpack565(c1, e1);
+        for (int k = 0; k < 4; ++k)
+            for (int c = 0; c < 3; ++c)
+                pal[k][c] = e0[c] + (e1[c] - e0[c]) * weight[k];
+
+        float err = 0.0f, t[16];
+        int level[16];
+        for (int i = 0; i < 16; ++i)
+        {
+            level[i] = 0;
+            float d = Distance(px[i], pal[0], 3);
+            for (int k = 1; k < 4; ++k)
+            {
+                float dk = Distance(px[i], pal[k], 3);
+                if (dk < d)
+                {
+                    d = dk;
+                    level[i] = k;
+                }
+            }
+            err += d;
+            t[i] = weight[level[i]];
+        }
+
+        if (err < bestErr)
+        {
+            bestErr = err;
+            best0 = c0;
+            best1 = c1;
+            bestIdx = 0;
+            for (int i = 0; i < 16; ++i)
+                bestIdx |= (uint32_t)code[level[i]] << (i * 2);
+        }
+
+        if (!RefineEndpoints(px, 3, t, a, b)) break;
+    }
+
+    //c0 > c1 selects the four colour mode, equal endpoints need only index 0
+    if (best0 < best1)
+    {
+        std::swap(best0, best1);
+        bestIdx ^= 0x55555555;
+    }
+    else if (best0 == best1)
+        bestIdx = 0;
+
+    out[0] = (unsigned char)(best0 & 255);
+    out[1] = (unsigned char)(best0 >> 8);
+    out[2] = (unsigned char)(best1 & 255);
+    out[3] = (unsigned char)(best1 >> 8);
+    for (int i = 0; i < 4; ++i)
+        out[4 + i] = (unsigned char)(bestIdx >> (i * 8));
+}
+
+//--- BC3 ------------------------------------------------------------------
+
+//eight level alpha between the block's min and max
+static void EncodeBc3Alpha(const float px[16][4], unsigned char out[8])
+{
+    int a0 = 0, a1 = 255;
+    for (int i = 0; i < 16; ++i)
+    {
+        a0 = std::max(a0, (int)px[i][3]);
+        a1 = std::min(a1, (int)px[i][3]);
+    }
+
+    float pal[8];
+    pal[0] = (float)a0;
+    pal[1] = (float)a1;
+    for (int k = 2; k < 8; ++k)
+        pal[k] = (float)(((8 - k) * a0 + (k - 1) * a1) / 7);
+
+    uint64_t bits = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        int bestK = 0;
+        float d = std::fabs(px[i][3] - pal[0]);
+        for (int k = 1; k < 8 && a0 != a1; ++k)
+        {
+            float dk = std::fabs(px[i][3] - pal[k]);
+            if (dk < d)
+            {
+                d = dk;
+                bestK = k;
+            }
+        }
+        bits |= (uint64_t)bestK << (i * 3);
+    }
+
+    out[0] = (unsigned char)a0;
+    out[1] = (unsigned char)a1;
+    for (int i = 0; i < 6; ++i)
+        out[2 + i] = (unsigned char)(bits >> (i * 8));
+}
+
+static void EncodeBc3(const float px[16][4], unsigned char out[16])
+{
+    EncodeBc3Alpha(px, out);
+    EncodeBc1(px, out + 8);
+}
+
+//--- BC7 ------------------------------------------------------------------
+
+//mode 6 only: one subset, RGBA 7 bit endpoints with a p-bit each, 4 bit indices
+static const int bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static void QuantizeBc7(const float e[4], int q[4], int& p)
+{
+    float bestErr = 1e30f;
+    for (int pbit = 0; pbit < 2; ++pbit)
+    {
+        int cand[4];
+        float err = 0.0f;
+        for (int c = 0; c < 4; ++c)
+        {
+            cand[c] = std::min(127, std::max(0, (int)std::lround((e[c] - pbit) / 2.0f)));
+            float r = (float)((cand[c] << 1) | pbit);
+            err += (r - e[c]) * (r - e[c]);
+        }
+        if (err < bestErr)
+        {
+            bestErr = err;
+            p = pbit;
+            std::memcpy(q, cand, sizeof(cand));
+        }
+    }
+}
+
+struct BitWriter
+{
+    unsigned char* out;
+    int pos = 0;
+
+    void Put(uint32_t value, int bits)
+    {
+        for (int i = 0; i < bits; ++i, ++pos)
+        {
+            if (value & (1u << i))
+                out[pos >> 3] |= (unsigned char)(1 << (pos & 7));
+        }
+    }
+};
+
+static void EncodeBc7(const float px[16][4], unsigned char out[16])
+{
+    float a[4], b[4];
+    PrincipalEndpoints(px, 4, a, b);
+
+    float bestErr = 1e30f;
+    int bestQ[2][4] = {}, bestP[2] = {}, bestIdx[16] = {};
+
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        int q[2][4], p[2];
+        QuantizeBc7(a, q[0], p[0]);
+        QuantizeBc7(b, q[1], p[1]);
+
+        int e[2][4];
+        for (int c = 0; c < 4; ++c)
+        {
+            e[0][c] = (q[0][c] << 1) | p[0];
+            e[1][c] = (q[1][c] << 1) | p[1];
+        }
+
+        float pal[16][4];
+        for (int k = 0; k < 16; ++k)
+            for (int c = 0; c < 4; ++c)
+                pal[k][c] = (float)(((64 - bc7Weights[k]) * e[0][c] + bc7Weights[k] * e[1][c] + 32) >> 6);
+
+        float err = 0.0f, t[16];
+        int idx[16];
+        for (int i = 0; i < 16; ++i)
+        {
+            idx[i] = 0;
+            float d = Distance(px[i], pal[0], 4);
+            for (int k = 1; k < 16; ++k)
+            {
+                float dk = Distance(px[i], pal[k], 4);
+                if (dk < d)
+                {
+                    d = dk;
+                    idx[i] = k;
+                }
+            }
+            err += d;
+            t[i] = bc7Weights[idx[i]] / 64.0f;
+        }
+
+        if (err < bestErr)
+        {
+            bestErr = err;
+            std::memcpy(bestQ, q, sizeof(q));
+            std::memcpy(bestP, p, sizeof(p));
+            std::memcpy(bestIdx, idx, sizeof(idx));
+        }
+
+        if (!RefineEndpoints(px, 4, t, a, b)) break;
+    }
+
+    //the anchor index is stored without its top bit, so it has to be below 8
+    if (bestIdx[0] >= 8)
+    {
+        for (int c = 0; c < 4; ++c)
+            std::swap(bestQ[0][c], bestQ[1][c]);
+        std::swap(bestP[0], bestP[1]);
+        for (int i = 0; i < 16; ++i)
+            bestIdx[i] = 15 - bestIdx[i];
+    }
+
+    std::memset(out, 0, 16);
+    BitWriter bits{ out };
+    bits.Put(1 << 6, 7);
+    for (int c = 0; c < 4; ++c)
+    {
+        bits.Put(bestQ[0][c], 7);
+        bits.Put(bestQ[1][c], 7);
+    }
+    bits.Put(bestP[0], 1);
+    bits.Put(bestP[1], 1);
+    bits.Put(bestIdx[0], 3);
+    for (int i = 1; i < 16; ++i)
+        bits.Put(bestIdx[i], 4);
+}
+
+//--------------------------------------------------------------------------
+
+static void EncodeLevel(const Image& img, BlockFormat format, std::vector<unsigned char>& out)
+{
+    int bw = (img.w + 3) / 4, bh = (img.h + 3) / 4;
+    size_t blockBytes = format == FORMAT_BC1 ? 8 : 16;
+    size_t base = out.size();
+    out.resize(base + (size_t)bw * bh * blockBytes);
+
+    for (int by = 0; by < bh; ++by)
+    {
+        for (int bx = 0; bx < bw; ++bx)
+        {
+            float px[16][4];
+            FetchBlock(img, bx, by, px);
+
+            unsigned char* block = &out[base + ((size_t)by * bw + bx) * blockBytes];
+            if (format == FORMAT_BC1)
+                EncodeBc1(px, block);
+            else if (format == FORMAT_BC3)
+                EncodeBc3(px, block);
+            else
+                EncodeBc7(px, block);
+        }
+    }
+}
+
+static bool Convert(const std::string& path, bool bc7)
+{
+    Image img;
+    int channels;
+    unsigned char* data = stbi_load(path.c_str(), &img.w, &img.h, &channels, 4);
+    if (!data)
+    {
+        std::cerr << "can't load " << path << "\n";
+        return false;
+    }
+    img.rgba.assign(data, data + (size_t)img.w * img.h * 4);
+    stbi_image_free(data);
+
+    bool alpha = false;
+    for (size_t i = 3; i < img.rgba.size() && !alpha; i += 4)
+        alpha = img.rgba[i] != 255;
+
+    BlockFormat format = bc7 ? FORMAT_BC7 : alpha ? FORMAT_BC3 : FORMAT_BC1;
+
+    std::vector<unsigned char> payload;
+    uint32_t levels = 0;
+    size_t topSize = 0;
+    for (Image level = img;; level = Downsample(level))
+    {
+        EncodeLevel(level, format, payload);
+        if (levels++ == 0) topSize = payload.size();
+        if (level.w == 1 && level.h == 1) break;
+    }
+
+    DdsHeader header = {};
+    header.size = sizeof(DdsHeader);
+    header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+    header.width = img.w;
+    header.height = img.h;
+    header.pitchOrLinearSize = (uint32_t)topSize;
+    header.mipMapCount = levels;
+    header.format.size = sizeof(DdsPixelFormat);
+    header.format.flags = DDPF_FOURCC;
+    header.format.fourCC = format == FORMAT_BC1 ? DDS_FOURCC_DXT1 : format == FORMAT_BC3 ? DDS_FOURCC_DXT5 : DDS_FOURCC_DX10;
+    header.caps = DDSCAPS_TEXTURE | DDSCAPS_MIPMAP | DDSCAPS_COMPLEX;
+
+    DdsHeaderDx10 dx10 = {};
+    dx10.dxgiFormat = DXGI_FORMAT_BC7_UNORM;
+    dx10.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+    dx10.arraySize = 1;
+
+    std::string outPath = fs::path(path).replace_extension(".dds").string();
+    std::ofstream out(outPath, std::ios::binary);
+    out.write((const char*)&DDS_MAGIC, 4);
+    out.write((const char*)&header, sizeof(header));
+    if (format == FORMAT_BC7)
+        out.write((const char*)&dx10, sizeof(dx10));
+    out.write((const char*)payload.data(), (std::streamsize)payload.size());
+    if (!out)
+    {
+        std::cerr << "failed writing " << outPath << "\n";
+        return false;
+    }
+
+    static const char* names[] = { "BC1", "BC3", "BC7" };
+    std::cout << outPath << ": " << img.w << "x" << img.h << " " << names[format] << ", "
+              << levels << " mips, " << payload.size() << " bytes\n";
+    return true;
+}
+
+static bool IsImage(const fs::path& path)
+{
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".tga" || ext == ".bmp";
+}
+
+int main(int argc, char** argv)
+{
+    bool bc7 = false;
+    int arg = 1;
+    if (arg < argc && std::strcmp(argv[arg], "--bc7") == 0)
+    {
+        bc7 = true;
+        ++arg;
+    }
+    if (arg >= argc)
+    {
+        std::cerr << "usage: texconvert [--bc7] <image or dir>...\n";
+        return 1;
+    }
+
+    bool ok = true;
+    for (; arg < argc; ++arg)
+    {
+        if (fs::is_directory(argv[arg]))
+        {
+            for (const auto& entry : fs::recursive_directory_iterator(argv[arg]))
+            {
+                if (entry.is_regular_file() && IsImage(entry.path()))
+                    ok &= Convert(entry.path().generic_string(), bc7);
+            }
+        }
+        else
+            ok &= Convert(argv[arg], bc7);
+    }
+    return ok ? 0 : 1;
+}